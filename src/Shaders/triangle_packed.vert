@@ -0,0 +1,39 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject
+{
+    mat4 view;
+    mat4 projection;
+} ubo;
+
+// NOTE: The model matrix also carries the AABB dequantization of the positions
+layout( push_constant ) uniform constants {
+        mat4 model;
+} pushConstants;
+
+layout(location = 0) in vec4 inPosition; // unorm16 inside the model AABB, w is the normal bytes
+layout(location = 1) in vec2 inNormal;   // octahedral snorm8
+layout(location = 2) in vec2 inTexCoord; // half float
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+
+vec3 OctahedralDecode(vec2 e)
+{
+    vec3 n = vec3(e, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-n.z, 0.0);
+    n.x += n.x >= 0.0 ? -t : t;
+    n.y += n.y >= 0.0 ? -t : t;
+    return normalize(n);
+}
+
+void main()
+{
+    gl_Position = ubo.projection * ubo.view * pushConstants.model * vec4(inPosition.xyz, 1.0);
+    fragColor = vec3(1.0);
+    fragTexCoord = inTexCoord;
+    
+    // NOTE: Object space, the model matrix has the non uniform dequantization scale in it
+    fragNormal = OctahedralDecode(inNormal);
+}
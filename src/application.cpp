@@ -20,7 +20,17 @@
 #include <glm/gtx/quaternion.hpp>
 
 #include "imgui_setup.cpp"
+#include "resource_archive.cpp"
+#include "asset_registry.cpp"
+#include "texture_compression.cpp"
+#include "texture_cache.cpp"
+#include "device_memory.cpp"
 #include "vulkan_backend.cpp"
+#include "mesh_cache.cpp"
+#include "obj_parser.cpp"
+#include "mesh_optimizer.cpp"
+#include "asset_cooker.cpp"
+#include "async_file.cpp"
 
 /*
 TODO: Things that I can do
@@ -38,7 +48,6 @@ TODO: Things that I can do
   - hierarchical model
 - Ambient occulsion
 - Draw shader arts
-       - Impliment custom hash map without using std::hash and std::unordered_map
    - Impliment custom arena allocator for vulkan object allocations
 - Dynamic uniforms
 - Separate images and sampler descriptors
@@ -61,101 +70,391 @@ internal glm::vec3 HexToRGB(uint32 val)
     return glm::vec3(r / 255.0f, g / 255.0f, b / 255.0f);    
 }
 
-internal uint32 VertexHash(const Vertex & vertex)
+// NOTE: Re-runs deduplication over the expanded vertex stream with the old node based map and the
+//       flat table, both pre-sized, so the two can be compared on real meshes
+internal void BenchmarkVertexDedup(const char * objFileName, Model & model)
 {
-    uint32 h1 = (uint32)std::hash<glm::vec3>()(vertex.m_pos);
-    uint32 h2 = (uint32)std::hash<glm::vec3>()(vertex.m_color);
-    uint32 h3 = (uint32)std::hash<glm::vec2>()(vertex.m_texCoord);
+    std::vector<Vertex> stream;
+    stream.reserve(model.m_indices.size());
+    for (uint32 index : model.m_indices)
+    {
+        stream.push_back(model.m_vertices[index]);
+    }
+    
+    auto start = std::chrono::high_resolution_clock::now();
+    
+    std::unordered_map<Vertex, uint32> map = {};
+    map.reserve(model.m_vertices.size());
+    for (const Vertex & vertex : stream)
+    {
+        if (map.count(vertex) == 0)
+        {
+            uint32 index = (uint32)map.size();
+            map[vertex] = index;
+        }
+    }
+    
+    auto middle = std::chrono::high_resolution_clock::now();
     
-    return ((h1 ^ (h2 << 1)) >> 1) ^ (h3 << 1);
+    HashTable<Vertex, uint32> table = {};
+    table.Init((uint32)model.m_vertices.size());
+    for (const Vertex & vertex : stream)
+    {
+        table.FindOrAdd(vertex, table.count);
+    }
+    
+    auto end = std::chrono::high_resolution_clock::now();
+    
+    real64 mapMs = std::chrono::duration<real64, std::milli>(middle - start).count();
+    real64 tableMs = std::chrono::duration<real64, std::milli>(end - middle).count();
+    SM_TRACE("%s: dedup of %zu vertices, unordered_map %.3f ms (%zu unique), HashTable %.3f ms (%u unique)",
+             objFileName, stream.size(), mapMs, map.size(), tableMs, table.count);
 }
 
-template<> struct std::hash<Vertex>
+// NOTE: Meshes are normally cooked by the asset cooker ahead of time, otherwise the first launch cooks them.
+//       cacheFile is the already read cooked mesh, or empty if there is none
+internal Model LoadModel(const char * objFileName, WorkQueue * workQueue, ResourceFile cacheFile)
 {
-    size_t operator()(Vertex const& vertex) const
+    Model model = {};
+    if (LoadMeshCache(objFileName, cacheFile, !TRUST_COOKED_ASSETS, &model))
     {
-        return VertexHash(vertex);
+        SM_TRACE("loaded cached mesh for %s", objFileName);
     }
-};
+    else
+    {
+        SM_TRACE("%s was not cooked ahead of time, cooking it now", objFileName);
+        CookModel(objFileName, workQueue, &model);
+        SM_ASSERT(!model.m_indices.empty(), "failed to import %s", objFileName);
+        
+        if (BENCHMARK_VERTEX_DEDUP && model.m_vertexFormat == VERTEX_FORMAT_FLOAT)
+        {
+            BenchmarkVertexDedup(objFileName, model);
+        }
+    }
+
+    return model;
+}
 
-internal Model LoadModel(const char * objFileName)
+internal bool MapTextureData(const char * textureFileName, ResourceFile cacheFile, TextureData * texture)
 {
-    tinyobj::attrib_t attrib;
-    std::vector<tinyobj::shape_t> shapes;
-    std::vector<tinyobj::material_t> materials;
-    std::string warn;
-    std::string err;
+    TextureCacheView view;
+    if (!MapTextureCache(textureFileName, cacheFile, COMPRESS_TEXTURES, !TRUST_COOKED_ASSETS, &view))
+    {
+        return false;
+    }
     
-    bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objFileName);
-    if (!warn.empty())
+    *texture = {};
+    texture->m_pixels    = view.m_pixels;
+    texture->m_width     = view.m_header->m_width;
+    texture->m_height    = view.m_header->m_height;
+    texture->m_mipLevels = view.m_header->m_mipLevels;
+    texture->m_channels  = view.m_header->m_channels;
+    texture->m_encoding  = (TextureEncoding)view.m_header->m_encoding;
+    texture->m_file      = view.m_file;
+    return true;
+}
+
+// NOTE: Textures are normally cooked by the asset cooker ahead of time, otherwise the first launch cooks them.
+//       cacheFile is the already read cooked texture, or empty if there is none
+internal TextureData LoadTextureData(const char * textureFileName, ResourceFile cacheFile)
+{
+    TextureData texture = {};
+    if (MapTextureData(textureFileName, cacheFile, &texture))
     {
-        SM_WARN("%s", warn.c_str());
+        return texture;
     }
-    if (!err.empty())
+    
+    TextureData decoded;
+    bool decodedOk = DecodeTextureImage(textureFileName, &decoded);
+    SM_ASSERT(decodedOk, "failed to load texture image %s!", textureFileName);
+    
+    SM_TRACE("%s was not cooked ahead of time, cooking it now", textureFileName);
+    char cachePath[300];
+    GetTextureCachePath(textureFileName, cachePath, ArrayCount(cachePath));
+    if (WriteTextureCache(textureFileName, decoded.m_pixels, decoded.m_width, decoded.m_height, decoded.m_channels, COMPRESS_TEXTURES) &&
+        MapTextureData(textureFileName, OpenResource(cachePath, FILE_ACCESS_SEQUENTIAL), &texture))
     {
-        SM_ERROR("%s", err.c_str());
+        stbi_image_free(decoded.m_pixels);
+        return texture;
     }
     
-    SM_ASSERT(ret, "failed to load object file, err: %s", err.c_str());
+    // NOTE: Could not cook, upload the base level and let the GPU blit the rest
+    return decoded;
+}
+
+internal void FreeTextureData(TextureData * texture)
+{
+    if (texture->m_file.m_data)
+    {
+        CloseResource(&texture->m_file);
+    }
+    else
+    {
+        stbi_image_free(texture->m_pixels);
+    }
+    *texture = {};
+}
+
+// NOTE: Only the first transform referencing a model path pays for the load. The cooked mesh is read asynchronously,
+//       parsing it happens on a worker once it is in
+internal ModelHandle AcquireModel(Application * app, const char * objFileName)
+{
+    RenderData & renderData = app->m_renderData;
+    AssetAcquireResult result = AcquireAsset(&renderData.m_assets.m_models, objFileName);
     
-    std::unordered_map<Vertex, uint32> uniqueVertices = {};
-    Model model = {};
+    if (renderData.m_models.size() <= result.m_handle)
+    {
+        renderData.m_models.resize(result.m_handle + 1);
+    }
+    
+    if (result.m_needsLoad)
+    {
+        AssetStreamer * streamer = &app->m_streamer;
+        WorkQueue * workQueue = &app->m_workQueue;
+        AssetKey key = MakeAssetKey(objFileName);
+        ModelHandle handle = result.m_handle;
+        
+        char cachePath[300];
+        GetMeshCachePath(objFileName, cachePath, ArrayCount(cachePath));
+        
+        SubmitFileRead(&app->m_fileReads, cachePath, [streamer, workQueue, key, handle](ResourceFile cacheFile)
+                       {
+                           AddWork(workQueue, &streamer->m_pending, [streamer, workQueue, key, handle, cacheFile]
+                                   {
+                                       auto start = std::chrono::high_resolution_clock::now();
+                                       StreamedModel streamed = {};
+                                       streamed.m_handle = handle;
+                                       streamed.m_model  = LoadModel(key.m_path, workQueue, cacheFile);
+                                       auto end = std::chrono::high_resolution_clock::now();
+                                       SM_TRACE("streamed model %s in %.2f ms", key.m_path, std::chrono::duration<real64, std::milli>(end - start).count());
+                                       
+                                       std::lock_guard<std::mutex> lock(streamer->m_mutex);
+                                       streamer->m_finishedModels.push_back(std::move(streamed));
+                                   });
+                       });
+    }
+    else
+    {
+        SM_TRACE("sharing model %s", objFileName);
+    }
+    
+    return result.m_handle;
+}
+
+// NOTE: The cooked texture is read asynchronously, anything left to decode runs on a worker once it is in
+internal void QueueTextureLoad(Application * app, TextureHandle handle)
+{
+    AssetStreamer * streamer = &app->m_streamer;
+    WorkQueue * workQueue = &app->m_workQueue;
+    AssetKey key = app->m_renderData.m_assets.m_textures.m_entries[handle].m_key;
+    
+    char cachePath[300];
+    GetTextureCachePath(key.m_path, cachePath, ArrayCount(cachePath));
+    
+    SubmitFileRead(&app->m_fileReads, cachePath, [streamer, workQueue, key, handle](ResourceFile cacheFile)
+                   {
+                       AddWork(workQueue, &streamer->m_pending, [streamer, key, handle, cacheFile]
+                               {
+                                   auto start = std::chrono::high_resolution_clock::now();
+                                   StreamedTexture streamed = {};
+                                   streamed.m_handle   = handle;
+                                   streamed.m_texture  = LoadTextureData(key.m_path, cacheFile);
+                                   auto end = std::chrono::high_resolution_clock::now();
+                                   streamed.m_decodeMs = std::chrono::duration<real64, std::milli>(end - start).count();
+                                   
+                                   std::lock_guard<std::mutex> lock(streamer->m_mutex);
+                                   streamer->m_finishedTextures.push_back(streamed);
+                               });
+                   });
+}
+
+internal TextureHandle AcquireTexture(Application * app, const char * textureFileName)
+{
+    AssetAcquireResult result = AcquireAsset(&app->m_renderData.m_assets.m_textures, textureFileName);
+    
+    if (result.m_needsLoad)
+    {
+        QueueTextureLoad(app, result.m_handle);
+    }
+    
+    return result.m_handle;
+}
+
+// NOTE: The model context keeps its material textures for as long as it lives, like the model itself
+internal void AcquireMaterialTextures(Application * app, ModelHandle handle)
+{
+    Model & model = app->m_renderData.m_models[handle];
+    ModelContext & modelContext = app->m_renderContext.m_modelContexts[handle];
+    
+    for (uint32 i = 0; i < model.m_materials.size(); i++)
+    {
+        if (model.m_materials[i].m_diffusePath[0])
+        {
+            modelContext.m_drawRanges[i].m_texture = AcquireTexture(app, model.m_materials[i].m_diffusePath);
+        }
+    }
+}
+
+// NOTE: Textures that are drawn but lost their image to the residency manager stream back in, as do textures missing
+//       mips their size on screen asks for, once the budget has room for at least one more level
+internal void RestoreDrawnTextures(Application * app)
+{
+    VulkanContext & context = app->m_renderContext;
+    AssetTable & textures = app->m_renderData.m_assets.m_textures;
     
-    // Loop over shapes
-    for (size_t s = 0; s < shapes.size(); s++)
+    for (uint32 i = 0; i < app->m_renderData.m_transforms.count; i++)
     {
-        // Loop over faces(polygon)
-        size_t index_offset = 0;
-        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
+        Transform & transform = app->m_renderData.m_transforms[i];
+        ModelContext & model = IsAssetResident(&app->m_renderData.m_assets.m_models, transform.m_model) ? context.m_modelContexts[transform.m_model] : context.m_placeholderModel;
+        
+        for (const ModelDrawRange & range : model.m_drawRanges)
         {
-            size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+            TextureHandle handle = GetDrawRangeTexture(range, transform);
+            if (handle == INVALID_ASSET_HANDLE)
+            {
+                continue;
+            }
             
-            // Loop over vertices in the face.
-            for (size_t v = 0; v < fv; v++)
+            AssetState state = GetAssetState(&textures, handle);
+            
+            if (state == ASSET_STATE_UNLOADED)
+            {
+                MarkAssetLoading(&textures, handle);
+                QueueTextureLoad(app, handle);
+            }
+            else if (state == ASSET_STATE_RESIDENT && CanRestoreTextureMip(context, handle))
             {
-                Vertex vertex = {};
-                
-                // access to vertex
-                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
-                
-                vertex.m_pos.x = attrib.vertices[3*size_t(idx.vertex_index)+0];
-                vertex.m_pos.y = attrib.vertices[3*size_t(idx.vertex_index)+1];
-                vertex.m_pos.z = attrib.vertices[3*size_t(idx.vertex_index)+2];
-                
-                // Check if `normal_index` is zero or positive. negative = no normal data
-                if (idx.normal_index >= 0) {
-                    tinyobj::real_t nx = attrib.normals[3*size_t(idx.normal_index)+0];
-                    tinyobj::real_t ny = attrib.normals[3*size_t(idx.normal_index)+1];
-                    tinyobj::real_t nz = attrib.normals[3*size_t(idx.normal_index)+2];
-                }
-                
-                // Check if `texcoord_index` is zero or positive. negative = no texcoord data
-                if (idx.texcoord_index >= 0) {
-                    vertex.m_texCoord.x = attrib.texcoords[2*size_t(idx.texcoord_index)+0];
-                    vertex.m_texCoord.y = 1.0f - attrib.texcoords[2*size_t(idx.texcoord_index)+1];
-                    //vertex.m_texCoord.y = attrib.texcoords[2*size_t(idx.texcoord_index)+1];
-                }
-                
-                vertex.m_color = { 1.0f, 1.0f, 1.0f };
-                
-                if (uniqueVertices.count(vertex) == 0)
-                {
-                    uniqueVertices[vertex] = (uint32)model.m_vertices.size();
-                    model.m_vertices.push_back(vertex);
-                }
-                
-                model.m_indices.push_back(uniqueVertices[vertex]);
+                context.m_textureContexts[handle].m_restorePending = true;
+                QueueTextureLoad(app, handle);
             }
+        }
+    }
+}
+
+// NOTE: Pops the decoded texture for the next handle in registration order, if its worker is done with it.
+//       Reloads of handles the order already passed go out as soon as they are done. Expects the streamer lock to be held
+internal bool PopNextStreamedTexture(AssetStreamer & streamer, AssetTable & textures, StreamedTexture * texture)
+{
+    for (uint32 i = 0; i < streamer.m_finishedTextures.size(); i++)
+    {
+        if (streamer.m_finishedTextures[i].m_handle < streamer.m_nextTextureUpload)
+        {
+            *texture = streamer.m_finishedTextures[i];
+            streamer.m_finishedTextures[i] = streamer.m_finishedTextures.back();
+            streamer.m_finishedTextures.pop_back();
+            return true;
+        }
+    }
+    
+    while (streamer.m_nextTextureUpload < textures.m_entries.size() &&
+           textures.m_entries[streamer.m_nextTextureUpload].m_state != ASSET_STATE_LOADING)
+    {
+        streamer.m_nextTextureUpload++;
+    }
+    
+    for (uint32 i = 0; i < streamer.m_finishedTextures.size(); i++)
+    {
+        if (streamer.m_finishedTextures[i].m_handle == streamer.m_nextTextureUpload)
+        {
+            *texture = streamer.m_finishedTextures[i];
+            streamer.m_finishedTextures[i] = streamer.m_finishedTextures.back();
+            streamer.m_finishedTextures.pop_back();
+            return true;
+        }
+    }
+    
+    return false;
+}
+
+// NOTE: Runs on the main thread between frames. Transforms keep drawing the placeholder until this lands their assets
+internal void UploadStreamedAssets(Application * app)
+{
+    AssetStreamer & streamer = app->m_streamer;
+    RenderData & renderData = app->m_renderData;
+    
+    // NOTE: Hands the reads queued since last frame to the kernel and starts the jobs of the ones that are in
+    PollFileReads(&app->m_fileReads);
+    
+    UpdateTextureStreaming(app->m_renderContext, &renderData);
+    EnforceTextureBudget(app->m_renderContext, &renderData.m_assets.m_textures);
+    RestoreDrawnTextures(app);
+    
+    for (uint32 upload = 0; upload < STREAMING_UPLOADS_PER_FRAME; upload++)
+    {
+        StreamedModel model = {};
+        StreamedTexture texture = {};
+        bool haveModel = false;
+        bool haveTexture = false;
+        {
+            std::lock_guard<std::mutex> lock(streamer.m_mutex);
+            if (!streamer.m_finishedModels.empty())
+            {
+                model = std::move(streamer.m_finishedModels.front());
+                streamer.m_finishedModels.pop_front();
+                haveModel = true;
+            }
+            else
+            {
+                haveTexture = PopNextStreamedTexture(streamer, renderData.m_assets.m_textures, &texture);
+            }
+        }
+        
+        if (haveModel)
+        {
+            renderData.m_models[model.m_handle] = std::move(model.m_model);
+            UploadModel(app->m_renderContext, model.m_handle, renderData.m_models[model.m_handle]);
+            MarkAssetResident(&renderData.m_assets.m_models, model.m_handle);
+            AcquireMaterialTextures(app, model.m_handle);
+        }
+        else if (haveTexture)
+        {
+            auto start = std::chrono::high_resolution_clock::now();
+            UploadTexture(app->m_renderContext, &renderData.m_assets.m_textures, texture.m_handle, texture.m_texture);
+            MarkAssetResident(&renderData.m_assets.m_textures, texture.m_handle);
+            auto end = std::chrono::high_resolution_clock::now();
             
-            index_offset += fv;
-            // per-face material
-            // shapes[s].mesh.material_ids[f];
+            TextureContext & textureContext = app->m_renderContext.m_textureContexts[texture.m_handle];
+            SM_TRACE("texture %s (%ux%u, %u channels, encoding %u, first mip %u, %.2f MB): decode %.2f ms, upload %.2f ms",
+                     GetAssetPath(&renderData.m_assets.m_textures, texture.m_handle),
+                     texture.m_texture.m_width, texture.m_texture.m_height, texture.m_texture.m_channels,
+                     (uint32)texture.m_texture.m_encoding, textureContext.m_firstMip,
+                     textureContext.m_texelBytes / (1024.0 * 1024.0), texture.m_decodeMs,
+                     std::chrono::duration<real64, std::milli>(end - start).count());
+            FreeTextureData(&texture.m_texture);
+        }
+        else
+        {
+            break;
         }
     }
+}
+
+// NOTE: Lets in flight loads finish so nothing writes into the streamer after shutdown, then drops what never got uploaded
+internal void ShutdownAssetStreaming(Application * app)
+{
+    AssetStreamer & streamer = app->m_streamer;
+    ShutdownAsyncFileQueue(&app->m_fileReads);
+    WaitForWork(&app->m_workQueue, &streamer.m_pending);
     
-    size_t vertexSize = model.m_vertices.size();
+    for (StreamedTexture & texture : streamer.m_finishedTextures)
+    {
+        FreeTextureData(&texture.m_texture);
+    }
+    streamer.m_finishedTextures.clear();
+    streamer.m_finishedModels.clear();
+}
+
+internal void ReleaseTransformAssets(Application * app, Transform & tr)
+{
+    RenderData & renderData = app->m_renderData;
+    if (ReleaseAsset(&renderData.m_assets.m_models, tr.m_model))
+    {
+        renderData.m_models[tr.m_model] = {};
+    }
+    ReleaseAsset(&renderData.m_assets.m_textures, tr.m_texture);
     
-    return model;
+    tr.m_model   = INVALID_ASSET_HANDLE;
+    tr.m_texture = INVALID_ASSET_HANDLE;
 }
 
 // TODO: temp code
@@ -202,7 +501,8 @@ internal void InitRenderData(Application * app)
         
         tr.m_numCopies = 2;
     GeneratePositions(tr.m_meshPositions, tr.m_numCopies);
-    tr.m_model = LoadModel(tr.m_modelID);
+    tr.m_model = AcquireModel(app, tr.m_modelID);
+    tr.m_texture = AcquireTexture(app, tr.m_textureID);
         app->m_renderData.m_transforms.Add(tr);
     }
     
@@ -213,7 +513,8 @@ internal void InitRenderData(Application * app)
         
         tr.m_numCopies = 1;
         GeneratePositions(tr.m_meshPositions, tr.m_numCopies);
-        tr.m_model = LoadModel(tr.m_modelID);
+        tr.m_model = AcquireModel(app, tr.m_modelID);
+        tr.m_texture = AcquireTexture(app, tr.m_textureID);
         app->m_renderData.m_transforms.Add(tr);
     }
      
@@ -224,7 +525,8 @@ internal void InitRenderData(Application * app)
         
         tr.m_numCopies = 1;
         GeneratePositions(tr.m_meshPositions, tr.m_numCopies);
-        tr.m_model = LoadModel(MODEL_PATH3);
+        tr.m_model = AcquireModel(app, tr.m_modelID);
+        tr.m_texture = AcquireTexture(app, tr.m_textureID);
         app->m_renderData.m_transforms.Add(tr);
     }
     
@@ -500,6 +802,18 @@ internal void Init(Application * app)
 {
     InitWindow(app);
     InitInput(app);
+    
+    // NOTE: Leave one core for the main thread, it helps out while waiting on jobs anyway
+    uint32 threadCount = std::thread::hardware_concurrency();
+    InitWorkQueue(&app->m_workQueue, threadCount > 1 ? threadCount - 1 : 1);
+    InitAsyncFileQueue(&app->m_fileReads, &app->m_workQueue);
+    
+    // NOTE: Optional, without an archive every resource is read from its loose file
+    if (FileExists(RESOURCE_ARCHIVE_PATH))
+    {
+        MountResourceArchive(RESOURCE_ARCHIVE_PATH);
+    }
+    
     InitRenderData(app);
     InitVulkan(app);
     InitImGui(app);
@@ -508,7 +822,14 @@ internal void Init(Application * app)
 internal void CleanUp(Application * app)
 {
     CleanUpImgui();
+    ShutdownAssetStreaming(app);
     CleanUpVulkan(app->m_renderContext);
+    for (uint32 i = 0; i < app->m_renderData.m_transforms.count; i++)
+    {
+        ReleaseTransformAssets(app, app->m_renderData.m_transforms[i]);
+    }
+    ShutdownWorkQueue(&app->m_workQueue);
+    UnmountResourceArchive();
     glfwDestroyWindow(app->m_window);
     glfwTerminate();
 }
@@ -547,6 +868,7 @@ internal void MainLoop(Application * app)
         }
         
         // Rendering
+        UploadStreamedAssets(app);
         DrawFrame(app, &app->m_renderData);
         
         app->m_running = app->m_running && !glfwWindowShouldClose(app->m_window);
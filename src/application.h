@@ -11,6 +11,15 @@
 #include "vulkan_backend.h"
 #include "engine_lib.h"
 #include "render_interface.h"
+#include "resource_archive.h"
+#include "asset_registry.h"
+#include "mesh_cache.h"
+#include "texture_compression.h"
+#include "texture_cache.h"
+#include "obj_parser.h"
+#include "mesh_optimizer.h"
+#include "asset_cooker.h"
+#include "async_file.h"
 #include "input.h"
 
 #include <chrono>
@@ -24,10 +33,44 @@
 constexpr int32 WIDTH = 1920;
 constexpr int32 HEIGHT = 1080;
 
+// NOTE: Times the flat vertex dedup table against std::unordered_map when a model is imported. Needs the float
+//       vertices, so only with PACK_MESH_VERTICES off
+constexpr bool BENCHMARK_VERTEX_DEDUP = false;
+
+// NOTE: Uploads do not block on the GPU, but each streamed asset is still copied into the staging ring and its
+//       copies and mip blits recorded on the main thread. Capping how many land in one frame bounds that CPU time and keeps
+//       a burst from filling the ring, which would stall on the batches in flight
+constexpr uint32 STREAMING_UPLOADS_PER_FRAME = 2;
+
 //====================================================
 //      NOTE: Application Structs
 //====================================================
 
+struct StreamedModel
+{
+    ModelHandle m_handle;
+    Model       m_model;
+};
+
+struct StreamedTexture
+{
+    TextureHandle m_handle;
+    TextureData   m_texture;
+    real64        m_decodeMs;
+};
+
+// NOTE: Workers parse and decode into the finished lists, the main loop uploads from them
+struct AssetStreamer
+{
+    std::mutex                   m_mutex;
+    std::deque<StreamedModel>    m_finishedModels;
+    std::vector<StreamedTexture> m_finishedTextures; // NOTE: In whatever order the workers finish
+    WorkCounter                  m_pending;
+    
+    // NOTE: Main thread only, textures are uploaded in registration order
+    TextureHandle m_nextTextureUpload = 0;
+};
+
 struct Application
 {
     int32 m_joystick = -1;
@@ -44,6 +87,9 @@ struct Application
     RenderData    m_renderData;
     VulkanContext m_renderContext;
     Input         m_input;
+    WorkQueue     m_workQueue;
+    AssetStreamer m_streamer;
+    AsyncFileQueue m_fileReads;
 };
 
 //====================================================
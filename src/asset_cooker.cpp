@@ -0,0 +1,426 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "asset_cooker.h"
+
+//====================================================
+//      NOTE: Asset Cooking Functions
+//====================================================
+
+// NOTE: Imports, optimizes, packs and writes the cooked mesh. model is filled even if the cache could not be written,
+//       unless a large source does not stream, then it is left empty
+internal bool CookModel(const char * objFileName, WorkQueue * workQueue, Model * model)
+{
+    // NOTE: The parallel and tinyobj paths hold the whole file and all of its tokens at once, large scans only stream.
+    //       Falling back to them is exactly the unbounded import the cap is there to prevent
+    if (GetResourceSize(objFileName) >= (int64)OBJ_STREAMING_THRESHOLD)
+    {
+        ObjImportResult result = ImportObjModelStreaming(objFileName, OBJ_STREAMING_MEMORY_CAP, model);
+        if (result == OBJ_IMPORT_OVER_BUDGET)
+        {
+            SM_ERROR("failed to cook %s within %zu MB", objFileName, (size_t)(OBJ_STREAMING_MEMORY_CAP / MB(1)));
+            return false;
+        }
+        if (result == OBJ_IMPORT_UNSUPPORTED)
+        {
+            SM_ERROR("failed to cook %s, it could not be opened or has faces the streaming import does not handle", objFileName);
+            return false;
+        }
+    }
+    else if (!ImportObjModelParallel(objFileName, workQueue, model))
+    {
+        SM_TRACE("falling back to tinyobj for %s", objFileName);
+        *model = ImportObjModel(objFileName);
+    }
+
+    MeshOptimizeStats stats = OptimizeModel(model, OPTIMIZE_MESH_OVERDRAW);
+    SM_TRACE("%s: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", objFileName,
+             stats.m_before.m_acmr, stats.m_after.m_acmr, stats.m_before.m_atvr, stats.m_after.m_atvr);
+
+    if (PACK_MESH_VERTICES)
+    {
+        size_t floatBytes = model->m_vertices.size() * sizeof(Vertex);
+        if (PackModelVertices(model))
+        {
+            SM_TRACE("%s: packed vertices %zu -> %zu bytes", objFileName,
+                     floatBytes, model->m_packedVertices.size() * sizeof(PackedVertex));
+        }
+    }
+
+    return WriteMeshCache(objFileName, *model);
+}
+
+// NOTE: Decodes the base level with stb, keeping grey images at one byte per texel instead of expanding them to
+//       RGBA. Free m_pixels with stbi_image_free
+internal bool DecodeTextureImage(const char * textureFileName, TextureData * texture)
+{
+    *texture = {};
+
+    ResourceFile file = OpenResource(textureFileName, FILE_ACCESS_SEQUENTIAL);
+    if (!file.m_data)
+    {
+        return false;
+    }
+
+    int32 x, y, channelsInFile;
+    if (stbi_info_from_memory((stbi_uc *)file.m_data, (int32)file.m_size, &x, &y, &channelsInFile))
+    {
+        uint32 channels = GetTextureChannelCount(channelsInFile);
+        texture->m_pixels    = stbi_load_from_memory((stbi_uc *)file.m_data, (int32)file.m_size, &x, &y, &channelsInFile, (int32)channels);
+        texture->m_width     = (uint32)x;
+        texture->m_height    = (uint32)y;
+        texture->m_mipLevels = 1;
+        texture->m_channels  = channels;
+    }
+
+    CloseResource(&file);
+    return texture->m_pixels != nullptr;
+}
+
+internal bool CookTexture(const char * textureFileName)
+{
+    TextureData texture;
+    if (!DecodeTextureImage(textureFileName, &texture))
+    {
+        SM_WARN("failed to decode texture image %s", textureFileName);
+        return false;
+    }
+
+    bool cooked = WriteTextureCache(textureFileName, texture.m_pixels, texture.m_width, texture.m_height,
+                                    texture.m_channels, COMPRESS_TEXTURES);
+    stbi_image_free(texture.m_pixels);
+    return cooked;
+}
+
+// NOTE: triangle_packed.vert -> bytecode/triangle_packed_vert.spv, the names Shaders/build.bat produces
+internal void GetShaderBytecodePath(const char * shaderFileName, char * bytecodePath, uint32 bytecodePathSize)
+{
+    std::filesystem::path source(shaderFileName);
+    std::string stage = source.extension().string().substr(1);
+    std::filesystem::path bytecode = source.parent_path() / SHADER_BYTECODE_DIRECTORY / (source.stem().string() + "_" + stage + ".spv");
+
+    snprintf(bytecodePath, bytecodePathSize, "%s", bytecode.generic_string().c_str());
+}
+
+// NOTE: Runs glslc from the Vulkan SDK, or whichever one is on the PATH when VULKAN_SDK is not set
+internal bool CookShader(const char * shaderFileName)
+{
+    char bytecodePath[300];
+    GetShaderBytecodePath(shaderFileName, bytecodePath, ArrayCount(bytecodePath));
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(bytecodePath).parent_path(), error);
+
+    char compiler[300];
+    const char * sdkPath = getenv("VULKAN_SDK");
+    snprintf(compiler, ArrayCount(compiler), sdkPath ? "%s/bin/glslc" : "glslc", sdkPath);
+
+    char command[1024];
+#ifdef _WIN32
+    // NOTE: cmd strips the outer pair of quotes, keep the quoted compiler path intact
+    snprintf(command, ArrayCount(command), "\"\"%s\" \"%s\" -o \"%s\"\"", compiler, shaderFileName, bytecodePath);
+#else
+    snprintf(command, ArrayCount(command), "\"%s\" \"%s\" -o \"%s\"", compiler, shaderFileName, bytecodePath);
+#endif
+
+    int32 result = system(command);
+    if (result != 0)
+    {
+        SM_WARN("glslc failed on %s (%d)", shaderFileName, result);
+    }
+    return result == 0;
+}
+
+//====================================================
+//      NOTE: Asset Cooker Functions
+//====================================================
+
+internal bool HasExtension(const char * path, const char * extension)
+{
+    size_t pathLength = strlen(path);
+    size_t extensionLength = strlen(extension);
+    if (pathLength < extensionLength)
+    {
+        return false;
+    }
+
+    const char * suffix = path + pathLength - extensionLength;
+    for (size_t i = 0; i < extensionLength; i++)
+    {
+        if (tolower((uint8)suffix[i]) != extension[i])
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+internal CookKind GetCookKind(const char * path)
+{
+    for (uint32 i = 0; i < ArrayCount(COOK_MODEL_EXTENSIONS); i++)
+    {
+        if (HasExtension(path, COOK_MODEL_EXTENSIONS[i])) return COOK_KIND_MODEL;
+    }
+    for (uint32 i = 0; i < ArrayCount(COOK_TEXTURE_EXTENSIONS); i++)
+    {
+        if (HasExtension(path, COOK_TEXTURE_EXTENSIONS[i])) return COOK_KIND_TEXTURE;
+    }
+    for (uint32 i = 0; i < ArrayCount(COOK_SHADER_EXTENSIONS); i++)
+    {
+        if (HasExtension(path, COOK_SHADER_EXTENSIONS[i])) return COOK_KIND_SHADER;
+    }
+    return COOK_KIND_NONE;
+}
+
+// NOTE: Everything besides the source bytes that changes what a cook writes
+internal uint64 GetCookVersion(CookKind kind)
+{
+    switch (kind)
+    {
+        case COOK_KIND_MODEL:   return ((uint64)MESH_CACHE_VERSION << 2) | (PACK_MESH_VERTICES ? 2 : 0) | (OPTIMIZE_MESH_OVERDRAW ? 1 : 0);
+        case COOK_KIND_TEXTURE: return ((uint64)TEXTURE_CACHE_VERSION << 1) | (COMPRESS_TEXTURES ? 1 : 0);
+        default:                return 0;
+    }
+}
+
+// NOTE: The materials of a cooked model come out of the .mtl files its mtllib lines name, so their bytes go into
+//       its hash too. A library that does not open hashes as empty, it cooks again once it shows up
+internal uint64 HashObjMaterialLibraries(const char * objFileName, const MappedFile & source, uint64 hash)
+{
+    std::string baseDirectory = GetObjBaseDirectory(objFileName);
+
+    const char * end = source.memory + source.size;
+    for (const char * line = source.memory; line < end;)
+    {
+        const char * lineEnd = (const char *)memchr(line, '\n', (size_t)(end - line));
+        if (!lineEnd) lineEnd = end;
+
+        const char * token = line;
+        while (token < lineEnd && IS_SPACE((*token))) token++;
+        line = lineEnd + 1;
+
+        if (lineEnd - token < 7 || strncmp(token, "mtllib", 6) != 0 || !IS_SPACE((token[6])))
+        {
+            continue;
+        }
+
+        const char * nameEnd = lineEnd;
+        while (nameEnd > token && (nameEnd[-1] == '\r' || IS_SPACE((nameEnd[-1])))) nameEnd--;
+
+        std::vector<std::string> filenames;
+        tinyobj::SplitString(std::string(token + 7, nameEnd), ' ', '\\', filenames);
+        for (const std::string & filename : filenames)
+        {
+            std::string path = baseDirectory + filename;
+            ResourceFile file = OpenResource(path.c_str(), FILE_ACCESS_SEQUENTIAL);
+            uint64 fileHash = 0;
+            if (file.m_data)
+            {
+                fileHash = HashBytes64(file.m_data, file.m_size);
+                CloseResource(&file);
+            }
+
+            hash = HashMix64(hash ^ HashBytes64(path.data(), path.size()) ^ fileHash);
+        }
+    }
+
+    return hash;
+}
+
+internal void GetCookOutputPath(const CookJob & job, char * outputPath, uint32 outputPathSize)
+{
+    switch (job.m_kind)
+    {
+        case COOK_KIND_MODEL:   GetMeshCachePath(job.m_key.m_path, outputPath, outputPathSize); break;
+        case COOK_KIND_TEXTURE: GetTextureCachePath(job.m_key.m_path, outputPath, outputPathSize); break;
+        case COOK_KIND_SHADER:  GetShaderBytecodePath(job.m_key.m_path, outputPath, outputPathSize); break;
+        default: SM_ASSERT(false, "%s is not a cookable asset!", job.m_key.m_path);
+    }
+}
+
+internal void LoadCookManifest(const char * manifestPath, CookManifest * manifest)
+{
+    manifest->m_entries.clear();
+
+    MappedFile file = MapFile((char *)manifestPath, FILE_ACCESS_SEQUENTIAL);
+    if (file.memory && file.size >= sizeof(CookManifestHeader))
+    {
+        CookManifestHeader * header = (CookManifestHeader *)file.memory;
+        bool valid = header->m_magic == COOK_MANIFEST_MAGIC &&
+            header->m_version == COOK_MANIFEST_VERSION &&
+            file.size == sizeof(CookManifestHeader) + header->m_entryCount * sizeof(CookManifestEntry);
+
+        if (valid)
+        {
+            CookManifestEntry * entries = (CookManifestEntry *)(file.memory + sizeof(CookManifestHeader));
+            manifest->m_entries.assign(entries, entries + header->m_entryCount);
+        }
+    }
+    UnmapFile(&file);
+
+    manifest->m_lookup.Init((uint32)manifest->m_entries.size());
+    for (uint32 i = 0; i < manifest->m_entries.size(); i++)
+    {
+        manifest->m_lookup.FindOrAdd(manifest->m_entries[i].m_key, i);
+    }
+}
+
+// NOTE: Failed jobs are left out so they are retried next time, deleted sources simply drop out
+internal bool WriteCookManifest(const char * manifestPath, const std::vector<CookJob> & jobs)
+{
+    std::vector<CookManifestEntry> entries;
+    for (const CookJob & job : jobs)
+    {
+        if (job.m_status != COOK_STATUS_FAILED)
+        {
+            CookManifestEntry entry = {};
+            entry.m_key  = job.m_key;
+            entry.m_hash = job.m_hash;
+            entries.push_back(entry);
+        }
+    }
+
+    auto file = fopen(manifestPath, "wb");
+    if (!file)
+    {
+        SM_WARN("Failed to write cook manifest: %s", manifestPath);
+        return false;
+    }
+
+    CookManifestHeader header = {};
+    header.m_version    = COOK_MANIFEST_VERSION;
+    header.m_entryCount = (uint32)entries.size();
+
+    // NOTE: The magic is written last so a half written manifest never validates
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries.data(), sizeof(CookManifestEntry), entries.size(), file);
+
+    header.m_magic = COOK_MANIFEST_MAGIC;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    fclose(file);
+    return true;
+}
+
+// NOTE: Runs on a worker. The manifest is only read while jobs are in flight
+internal void RunCookJob(CookJob * job, CookManifest * manifest, WorkQueue * workQueue)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+    const char * path = job->m_key.m_path;
+
+    MappedFile source = MapFile((char *)path, FILE_ACCESS_SEQUENTIAL);
+    if (!source.memory)
+    {
+        SM_WARN("failed to read %s", path);
+        job->m_status = COOK_STATUS_FAILED;
+        return;
+    }
+    job->m_hash = HashMix64(HashBytes64(source.memory, source.size) ^ GetCookVersion(job->m_kind));
+    if (job->m_kind == COOK_KIND_MODEL)
+    {
+        job->m_hash = HashObjMaterialLibraries(path, source, job->m_hash);
+    }
+    UnmapFile(&source);
+
+    char outputPath[300];
+    GetCookOutputPath(*job, outputPath, ArrayCount(outputPath));
+
+    uint32 * index = manifest->m_lookup.Find(job->m_key);
+    if (index && manifest->m_entries[*index].m_hash == job->m_hash && FileExists(outputPath))
+    {
+        job->m_status = COOK_STATUS_UP_TO_DATE;
+        return;
+    }
+
+    bool cooked = false;
+    switch (job->m_kind)
+    {
+        case COOK_KIND_MODEL:
+        {
+            Model model = {};
+            cooked = CookModel(path, workQueue, &model);
+        } break;
+        case COOK_KIND_TEXTURE: cooked = CookTexture(path); break;
+        case COOK_KIND_SHADER:  cooked = CookShader(path); break;
+        default: break;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    job->m_status = cooked ? COOK_STATUS_COOKED : COOK_STATUS_FAILED;
+    job->m_ms = std::chrono::duration<real64, std::milli>(end - start).count();
+
+    if (cooked)
+    {
+        SM_TRACE("cooked %s -> %s in %.2f ms", path, outputPath, job->m_ms);
+    }
+}
+
+// NOTE: Hashes every source under COOK_SOURCE_ROOTS on the work queue and recooks the ones whose hash changed
+//       since the last run or whose output is missing. Returns false if anything failed to cook
+internal bool RunAssetCooker(WorkQueue * workQueue)
+{
+    auto start = std::chrono::high_resolution_clock::now();
+
+    std::vector<std::string> paths;
+    for (uint32 i = 0; i < ArrayCount(COOK_SOURCE_ROOTS); i++)
+    {
+        CollectResourcePaths(COOK_SOURCE_ROOTS[i], paths);
+    }
+
+    std::vector<CookJob> jobs;
+    for (const std::string & path : paths)
+    {
+        CookKind kind = GetCookKind(path.c_str());
+        if (kind == COOK_KIND_NONE)
+        {
+            continue;
+        }
+
+        if (path.size() >= ASSET_PATH_LENGTH)
+        {
+            SM_WARN("skipping %s, the path is too long", path.c_str());
+            continue;
+        }
+
+        CookJob job = {};
+        job.m_key  = MakeAssetKey(path.c_str());
+        job.m_kind = kind;
+        jobs.push_back(job);
+    }
+
+    CookManifest manifest;
+    LoadCookManifest(COOK_MANIFEST_PATH, &manifest);
+
+    WorkCounter counter;
+    for (CookJob & job : jobs)
+    {
+        CookJob * cookJob = &job;
+        CookManifest * cookManifest = &manifest;
+        AddWork(workQueue, &counter, [cookJob, cookManifest, workQueue]()
+                {
+                    RunCookJob(cookJob, cookManifest, workQueue);
+                });
+    }
+    WaitForWork(workQueue, &counter);
+
+    WriteCookManifest(COOK_MANIFEST_PATH, jobs);
+
+    uint32 counts[3] = {};
+    for (const CookJob & job : jobs)
+    {
+        counts[job.m_status]++;
+    }
+
+    auto end = std::chrono::high_resolution_clock::now();
+    SM_TRACE("cooked %u, up to date %u, failed %u of %zu assets in %.2f ms",
+             counts[COOK_STATUS_COOKED], counts[COOK_STATUS_UP_TO_DATE], counts[COOK_STATUS_FAILED], jobs.size(),
+             std::chrono::duration<real64, std::milli>(end - start).count());
+
+    return counts[COOK_STATUS_FAILED] == 0;
+}
@@ -0,0 +1,108 @@
+/* date = October 18th 2026 7:20 pm */
+
+#ifndef ASSET_COOKER_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+#include "asset_registry.h"
+#include "resource_archive.h"
+#include "mesh_cache.h"
+#include "texture_cache.h"
+#include "obj_parser.h"
+#include "mesh_optimizer.h"
+
+#include <chrono>
+#include <string>
+
+//====================================================
+//      NOTE: Asset Cooker Constexpr
+//====================================================
+
+// NOTE: Sort Tipsify clusters front to back after the vertex cache pass, costs a little ACMR
+constexpr bool OPTIMIZE_MESH_OVERDRAW = true;
+
+// NOTE: Cook models as 12 byte PackedVertex instead of the 32 byte float Vertex, the runtime uploads whichever
+//       the cooked mesh holds
+constexpr bool PACK_MESH_VERTICES = true;
+
+// NOTE: Cook textures as BC1/BC7 instead of raw texels. Devices without BC support decode them back on upload
+constexpr bool COMPRESS_TEXTURES = true;
+
+// NOTE: The runtime takes cooked files as they are instead of checking them against their source, so a launch
+//       never touches the sources. Building runs the cooker first; turn this off to pick up edits without it
+constexpr bool TRUST_COOKED_ASSETS = true;
+
+constexpr char * COOK_MANIFEST_PATH    = "resources/cook_manifest.bin";
+constexpr uint32 COOK_MANIFEST_MAGIC   = 0x4B4F4F43; // 'COOK'
+constexpr uint32 COOK_MANIFEST_VERSION = 1;
+
+// NOTE: Walked recursively, every source below them with a known extension is cooked
+constexpr char * COOK_SOURCE_ROOTS[] =
+{
+    "resources",
+    "src/Shaders",
+};
+
+constexpr char * COOK_MODEL_EXTENSIONS[]   = { ".obj" };
+constexpr char * COOK_TEXTURE_EXTENSIONS[] = { ".png", ".jpg", ".jpeg", ".tga", ".bmp" };
+constexpr char * COOK_SHADER_EXTENSIONS[]  = { ".vert", ".frag" };
+
+// NOTE: Next to the shader sources, the same place Shaders/build.bat writes to
+constexpr char * SHADER_BYTECODE_DIRECTORY = "bytecode";
+
+//====================================================
+//      NOTE: Asset Cooker Structs
+//====================================================
+
+enum CookKind
+{
+    COOK_KIND_NONE,
+    COOK_KIND_MODEL,
+    COOK_KIND_TEXTURE,
+    COOK_KIND_SHADER,
+};
+
+enum CookStatus
+{
+    COOK_STATUS_UP_TO_DATE,
+    COOK_STATUS_COOKED,
+    COOK_STATUS_FAILED,
+};
+
+/*
+  NOTE: File layout
+  [CookManifestHeader][CookManifestEntry * m_entryCount]
+  One entry per source that cooked, keyed by its path. The hash covers the source bytes and the versions of
+  everything that shapes the output, so bumping a cache version or a cook setting recooks the affected sources.
+ */
+struct CookManifestHeader
+{
+    uint32 m_magic;
+    uint32 m_version;
+    uint32 m_entryCount;
+    uint32 m_reserved;
+};
+
+struct CookManifestEntry
+{
+    AssetKey m_key;
+    uint64   m_hash;
+};
+
+struct CookManifest
+{
+    std::vector<CookManifestEntry> m_entries;
+    HashTable<AssetKey, uint32>    m_lookup;
+};
+
+struct CookJob
+{
+    AssetKey   m_key;
+    CookKind   m_kind;
+    CookStatus m_status;
+    uint64     m_hash;
+    real64     m_ms;
+};
+
+#define ASSET_COOKER_H
+#endif //ASSET_COOKER_H
@@ -0,0 +1,98 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "asset_registry.h"
+
+//====================================================
+//      NOTE: Asset Registry Functions
+//====================================================
+
+internal AssetKey MakeAssetKey(const char * path)
+{
+    SM_ASSERT(strlen(path) < ASSET_PATH_LENGTH, "asset path %s is too long!", path);
+
+    AssetKey key = {};
+    strncpy(key.m_path, path, ASSET_PATH_LENGTH - 1);
+    return key;
+}
+
+// NOTE: Adds a reference to the asset at path, registering it on first use
+internal AssetAcquireResult AcquireAsset(AssetTable * table, const char * path)
+{
+    AssetKey key = MakeAssetKey(path);
+
+    AssetHandle handle = table->m_lookup.FindOrAdd(key, (AssetHandle)table->m_entries.size());
+    if (handle == table->m_entries.size())
+    {
+        AssetEntry entry = {};
+        entry.m_key = key;
+        table->m_entries.push_back(entry);
+    }
+
+    AssetEntry & entry = table->m_entries[handle];
+    entry.m_refCount++;
+
+    AssetAcquireResult result = {};
+    result.m_handle    = handle;
+    result.m_needsLoad = entry.m_state == ASSET_STATE_UNLOADED;
+
+    if (result.m_needsLoad)
+    {
+        entry.m_state = ASSET_STATE_LOADING;
+    }
+    return result;
+}
+
+// NOTE: Returns true when this was the last reference and the CPU side asset data can be freed
+internal bool ReleaseAsset(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+
+    AssetEntry & entry = table->m_entries[handle];
+    SM_ASSERT(entry.m_refCount > 0, "asset %s released more often than acquired!", entry.m_key.m_path);
+
+    entry.m_refCount--;
+    return entry.m_refCount == 0;
+}
+
+internal const char * GetAssetPath(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+    return table->m_entries[handle].m_key.m_path;
+}
+
+internal bool IsAssetResident(AssetTable * table, AssetHandle handle)
+{
+    return handle < table->m_entries.size() && table->m_entries[handle].m_state == ASSET_STATE_RESIDENT;
+}
+
+internal void MarkAssetResident(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+    table->m_entries[handle].m_state = ASSET_STATE_RESIDENT;
+}
+
+// NOTE: The texture residency manager evicted the GPU copy, the next acquire loads it again
+internal void MarkAssetUnloaded(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+    table->m_entries[handle].m_state = ASSET_STATE_UNLOADED;
+}
+
+// NOTE: For reloads the caller queues itself, e.g. an evicted asset that is still referenced
+internal void MarkAssetLoading(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+    table->m_entries[handle].m_state = ASSET_STATE_LOADING;
+}
+
+internal AssetState GetAssetState(AssetTable * table, AssetHandle handle)
+{
+    SM_ASSERT(handle < table->m_entries.size(), "invalid asset handle %u!", handle);
+    return table->m_entries[handle].m_state;
+}
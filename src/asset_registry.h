@@ -0,0 +1,66 @@
+/* date = October 18th 2026 2:05 pm */
+
+#ifndef ASSET_REGISTRY_H
+
+#include "engine_lib.h"
+
+//====================================================
+//      NOTE: Asset Registry Constexpr
+//====================================================
+
+constexpr uint32 ASSET_PATH_LENGTH    = 260;
+constexpr uint32 INVALID_ASSET_HANDLE = 0xFFFFFFFF;
+
+//====================================================
+//      NOTE: Asset Registry Structs
+//====================================================
+
+// NOTE: Only touched on the main thread, workers hand their results back through the AssetStreamer
+enum AssetState : uint32
+{
+    ASSET_STATE_UNLOADED,
+    ASSET_STATE_LOADING,  // NOTE: Queued or being parsed / decoded on a worker, draws use the placeholder
+    ASSET_STATE_RESIDENT, // NOTE: Uploaded to the GPU
+};
+
+// NOTE: Index into the per asset arrays, e.g. RenderData::m_models and VulkanContext::m_modelContexts
+typedef uint32 AssetHandle;
+typedef AssetHandle ModelHandle;
+typedef AssetHandle TextureHandle;
+
+// NOTE: Zero padded, so two keys of the same path compare equal bitwise
+struct AssetKey
+{
+    char m_path[ASSET_PATH_LENGTH];
+};
+
+struct AssetEntry
+{
+    AssetKey   m_key;
+    uint32     m_refCount;
+    AssetState m_state;
+};
+
+// NOTE: Handles are never reused for a different path. An entry whose last reference is released keeps its
+//       slot and its GPU copy until the texture residency manager evicts it, the next acquire of the same path
+//       gets the same handle back
+struct AssetTable
+{
+    std::vector<AssetEntry>         m_entries;
+    HashTable<AssetKey, AssetHandle> m_lookup;
+};
+
+struct AssetAcquireResult
+{
+    AssetHandle m_handle;
+    bool        m_needsLoad; // NOTE: Nothing loaded or in flight yet, the caller owns loading the asset data
+};
+
+struct AssetRegistry
+{
+    AssetTable m_models;
+    AssetTable m_textures;
+};
+
+#define ASSET_REGISTRY_H
+#endif //ASSET_REGISTRY_H
@@ -0,0 +1,360 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "async_file.h"
+
+//====================================================
+//      NOTE: io_uring
+//====================================================
+
+#ifdef __linux__
+
+// NOTE: No liburing, the three syscalls and the ring layout are all that is needed for plain reads
+internal bool InitIoUring(IoUring * ring, uint32 entries)
+{
+    *ring = {};
+
+    io_uring_params params = {};
+    int32 fd = (int32)syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    ring->m_fd         = fd;
+    ring->m_entries    = params.sq_entries;
+    ring->m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32);
+    ring->m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+    // NOTE: Newer kernels put both rings in one mapping
+    bool singleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMapping)
+    {
+        ring->m_sqRingSize = ring->m_cqRingSize = std::max(ring->m_sqRingSize, ring->m_cqRingSize);
+    }
+
+    ring->m_sqRing = mmap(nullptr, ring->m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQ_RING);
+    if (ring->m_sqRing == MAP_FAILED)
+    {
+        close(fd);
+        *ring = {};
+        return false;
+    }
+
+    ring->m_cqRing = ring->m_sqRing;
+    if (!singleMapping)
+    {
+        ring->m_cqRing = mmap(nullptr, ring->m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_CQ_RING);
+        if (ring->m_cqRing == MAP_FAILED)
+        {
+            munmap(ring->m_sqRing, ring->m_sqRingSize);
+            close(fd);
+            *ring = {};
+            return false;
+        }
+    }
+
+    void * sqes = mmap(nullptr, params.sq_entries * sizeof(io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, IORING_OFF_SQES);
+    if (sqes == MAP_FAILED)
+    {
+        if (!singleMapping)
+        {
+            munmap(ring->m_cqRing, ring->m_cqRingSize);
+        }
+        munmap(ring->m_sqRing, ring->m_sqRingSize);
+        close(fd);
+        *ring = {};
+        return false;
+    }
+
+    uint8 * sq = (uint8 *)ring->m_sqRing;
+    ring->m_sqHead  = (uint32 *)(sq + params.sq_off.head);
+    ring->m_sqTail  = (uint32 *)(sq + params.sq_off.tail);
+    ring->m_sqMask  = (uint32 *)(sq + params.sq_off.ring_mask);
+    ring->m_sqArray = (uint32 *)(sq + params.sq_off.array);
+    ring->m_sqes    = (io_uring_sqe *)sqes;
+
+    uint8 * cq = (uint8 *)ring->m_cqRing;
+    ring->m_cqHead = (uint32 *)(cq + params.cq_off.head);
+    ring->m_cqTail = (uint32 *)(cq + params.cq_off.tail);
+    ring->m_cqMask = (uint32 *)(cq + params.cq_off.ring_mask);
+    ring->m_cqes   = (io_uring_cqe *)(cq + params.cq_off.cqes);
+
+    return true;
+}
+
+internal void ShutdownIoUring(IoUring * ring)
+{
+    if (ring->m_fd < 0)
+    {
+        return;
+    }
+
+    munmap(ring->m_sqes, ring->m_entries * sizeof(io_uring_sqe));
+    if (ring->m_cqRing != ring->m_sqRing)
+    {
+        munmap(ring->m_cqRing, ring->m_cqRingSize);
+    }
+    munmap(ring->m_sqRing, ring->m_sqRingSize);
+    close(ring->m_fd);
+    *ring = {};
+}
+
+// NOTE: Readv instead of read, it is there since the first io_uring kernels. The caller makes sure the SQ has room
+internal void PushIoUringRead(IoUring * ring, AsyncFileRead * read)
+{
+    read->m_iovec.iov_base = read->m_file.m_data + read->m_offset;
+    read->m_iovec.iov_len  = read->m_file.m_size - read->m_offset;
+
+    // NOTE: Only this thread writes the tail, the kernel publishes head
+    uint32 tail = *ring->m_sqTail;
+    uint32 index = tail & *ring->m_sqMask;
+
+    io_uring_sqe * sqe = &ring->m_sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = IORING_OP_READV;
+    sqe->fd        = read->m_fd;
+    sqe->addr      = (uint64)&read->m_iovec;
+    sqe->len       = 1;
+    sqe->off       = read->m_offset;
+    sqe->user_data = (uint64)read;
+
+    ring->m_sqArray[index] = index;
+    __atomic_store_n(ring->m_sqTail, tail + 1, __ATOMIC_RELEASE);
+}
+
+internal int32 EnterIoUring(IoUring * ring, uint32 submitCount, uint32 waitCount)
+{
+    uint32 flags = waitCount ? IORING_ENTER_GETEVENTS : 0;
+    return (int32)syscall(__NR_io_uring_enter, ring->m_fd, submitCount, waitCount, flags, nullptr, 0);
+}
+
+internal void FinishFileRead(AsyncFileRead * read)
+{
+    if (read->m_fd >= 0)
+    {
+        close(read->m_fd);
+        read->m_fd = -1;
+    }
+}
+
+// NOTE: Moves the backlog onto the ring, hands the batch to the kernel and reaps whatever completed. Short reads go
+//       back to the front of the backlog for the rest of the file
+internal void PumpIoUring(AsyncFileQueue * queue, bool wait)
+{
+    IoUring * ring = &queue->m_ring;
+
+    uint32 submitCount = 0;
+    while (!queue->m_backlog.empty() && queue->m_inFlight < ring->m_entries)
+    {
+        PushIoUringRead(ring, queue->m_backlog.front());
+        queue->m_backlog.pop_front();
+        queue->m_inFlight++;
+        submitCount++;
+    }
+
+    if (submitCount || (wait && queue->m_inFlight))
+    {
+        int32 result = EnterIoUring(ring, submitCount, wait && queue->m_inFlight ? 1 : 0);
+        if (result < 0 && errno != EINTR)
+        {
+            SM_ERROR("io_uring_enter failed: %s", strerror(errno));
+        }
+    }
+
+    uint32 head = *ring->m_cqHead;
+    uint32 tail = __atomic_load_n(ring->m_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; head++)
+    {
+        io_uring_cqe * cqe = &ring->m_cqes[head & *ring->m_cqMask];
+        AsyncFileRead * read = (AsyncFileRead *)cqe->user_data;
+        int32 result = cqe->res;
+        queue->m_inFlight--;
+
+        if (result < 0)
+        {
+            SM_WARN("failed to read %s: %s", read->m_path.c_str(), strerror(-result));
+            FinishFileRead(read);
+            CloseResource(&read->m_file);
+            queue->m_completed.push_back(read);
+            continue;
+        }
+
+        read->m_offset += (size_t)result;
+        if (result > 0 && read->m_offset < read->m_file.m_size)
+        {
+            queue->m_backlog.push_front(read);
+            continue;
+        }
+
+        // NOTE: Zero means the file got shorter since it was opened, keep what is there
+        read->m_file.m_size = read->m_offset;
+        FinishFileRead(read);
+        queue->m_completed.push_back(read);
+    }
+    __atomic_store_n(ring->m_cqHead, head, __ATOMIC_RELEASE);
+}
+
+// NOTE: Opens the file and sizes its buffer right away, the read itself waits for the next pump
+internal void QueueIoUringRead(AsyncFileQueue * queue, AsyncFileRead * read)
+{
+    read->m_fd = open(read->m_path.c_str(), O_RDONLY);
+
+    struct stat fileStat = {};
+    if (read->m_fd < 0 || fstat(read->m_fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        FinishFileRead(read);
+        queue->m_completed.push_back(read);
+        return;
+    }
+
+    read->m_file.m_data  = (char *)malloc((size_t)fileStat.st_size);
+    read->m_file.m_size  = (size_t)fileStat.st_size;
+    read->m_file.m_owned = true;
+    queue->m_backlog.push_back(read);
+}
+
+#endif
+
+//====================================================
+//      NOTE: Async File Functions
+//====================================================
+
+// NOTE: Blocking read into an owned buffer, what the work queue fallback runs per file
+internal ResourceFile ReadWholeFile(const char * path)
+{
+    ResourceFile result = {};
+
+    auto file = fopen(path, "rb");
+    if (!file)
+    {
+        return result;
+    }
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    if (size > 0)
+    {
+        result.m_data  = (char *)malloc((size_t)size);
+        result.m_size  = fread(result.m_data, 1, (size_t)size, file);
+        result.m_owned = true;
+    }
+
+    fclose(file);
+    return result;
+}
+
+internal void InitAsyncFileQueue(AsyncFileQueue * queue, WorkQueue * workQueue)
+{
+    queue->m_workQueue  = workQueue;
+    queue->m_useIoUring = false;
+
+#ifdef __linux__
+    if (USE_IO_URING)
+    {
+        queue->m_useIoUring = InitIoUring(&queue->m_ring, ASYNC_FILE_QUEUE_DEPTH);
+        if (!queue->m_useIoUring)
+        {
+            SM_WARN("io_uring is not available (%s), reading files on the work queue", strerror(errno));
+        }
+    }
+#endif
+
+    SM_TRACE("async file reads use %s", queue->m_useIoUring ? "io_uring" : "the work queue");
+}
+
+// NOTE: Archived resources are already mapped, they complete without any I/O of their own
+internal void SubmitFileRead(AsyncFileQueue * queue, const char * path, AsyncFileCallback onComplete)
+{
+    AsyncFileRead * read = new AsyncFileRead();
+    read->m_path       = path;
+    read->m_onComplete = std::move(onComplete);
+
+    if (FindResourceEntry(path))
+    {
+        read->m_file = OpenResource(path, FILE_ACCESS_SEQUENTIAL);
+
+        std::lock_guard<std::mutex> lock(queue->m_mutex);
+        queue->m_completed.push_back(read);
+        return;
+    }
+
+#ifdef __linux__
+    if (queue->m_useIoUring)
+    {
+        std::lock_guard<std::mutex> lock(queue->m_mutex);
+        QueueIoUringRead(queue, read);
+        return;
+    }
+#endif
+
+    AddWork(queue->m_workQueue, &queue->m_pending, [queue, read]
+            {
+                read->m_file = ReadWholeFile(read->m_path.c_str());
+
+                std::lock_guard<std::mutex> lock(queue->m_mutex);
+                queue->m_completed.push_back(read);
+            });
+}
+
+internal bool HasFileReadsInFlight(AsyncFileQueue * queue)
+{
+    std::lock_guard<std::mutex> lock(queue->m_mutex);
+    bool inFlight = queue->m_pending.pending > 0 || !queue->m_completed.empty();
+#ifdef __linux__
+    inFlight = inFlight || queue->m_inFlight > 0 || !queue->m_backlog.empty();
+#endif
+    return inFlight;
+}
+
+// NOTE: Runs the callbacks of every finished read on the calling thread. wait blocks until at least one read of
+//       the ring is done, the fallback's workers are waited on by WaitForFileReads
+internal void PollFileReads(AsyncFileQueue * queue, bool wait = false)
+{
+    std::vector<AsyncFileRead *> completed;
+    {
+        std::lock_guard<std::mutex> lock(queue->m_mutex);
+#ifdef __linux__
+        if (queue->m_useIoUring)
+        {
+            PumpIoUring(queue, wait && queue->m_completed.empty());
+        }
+#endif
+        completed.swap(queue->m_completed);
+    }
+
+    for (AsyncFileRead * read : completed)
+    {
+        read->m_onComplete(read->m_file);
+        delete read;
+    }
+}
+
+internal void WaitForFileReads(AsyncFileQueue * queue)
+{
+    while (HasFileReadsInFlight(queue))
+    {
+        if (!queue->m_useIoUring)
+        {
+            WaitForWork(queue->m_workQueue, &queue->m_pending);
+        }
+        PollFileReads(queue, true);
+    }
+}
+
+internal void ShutdownAsyncFileQueue(AsyncFileQueue * queue)
+{
+    WaitForFileReads(queue);
+
+#ifdef __linux__
+    ShutdownIoUring(&queue->m_ring);
+#endif
+    queue->m_useIoUring = false;
+}
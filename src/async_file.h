@@ -0,0 +1,97 @@
+/* date = October 18th 2026 9:40 pm */
+
+#ifndef ASYNC_FILE_H
+
+#include "engine_lib.h"
+#include "resource_archive.h"
+
+#include <cerrno>
+#include <string>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+
+//====================================================
+//      NOTE: Async File Constexpr
+//====================================================
+
+// NOTE: Loose files are read through io_uring on Linux. Off, on other platforms, or where the kernel refuses to
+//       set up a ring, every read is a blocking job on the work queue instead
+constexpr bool USE_IO_URING = true;
+
+// NOTE: Reads in flight on the ring at once, later ones wait in the backlog until a slot frees up
+constexpr uint32 ASYNC_FILE_QUEUE_DEPTH = 64;
+
+//====================================================
+//      NOTE: Async File Structs
+//====================================================
+
+// NOTE: Gets the whole file, m_data is nullptr if it could not be read. The callback owns the file and closes it
+typedef std::function<void(ResourceFile file)> AsyncFileCallback;
+
+struct AsyncFileRead
+{
+    std::string       m_path;
+    AsyncFileCallback m_onComplete;
+    ResourceFile      m_file;
+
+    // NOTE: io_uring only, reads are resubmitted from m_offset until the whole file is in
+    int32  m_fd = -1;
+    size_t m_offset;
+#ifdef __linux__
+    struct iovec m_iovec;
+#endif
+};
+
+#ifdef __linux__
+// NOTE: The shared rings set up by io_uring_setup, the kernel consumes the SQ and produces the CQ
+struct IoUring
+{
+    int32 m_fd = -1;
+    uint32 m_entries;
+
+    void * m_sqRing;
+    size_t m_sqRingSize;
+    void * m_cqRing;
+    size_t m_cqRingSize;
+
+    uint32 * m_sqHead;
+    uint32 * m_sqTail;
+    uint32 * m_sqMask;
+    uint32 * m_sqArray;
+    io_uring_sqe * m_sqes;
+
+    uint32 * m_cqHead;
+    uint32 * m_cqTail;
+    uint32 * m_cqMask;
+    io_uring_cqe * m_cqes;
+};
+#endif
+
+/*
+  NOTE: Reads are submitted from and completed on one thread, the loader's. Submitting only queues the read,
+  PollFileReads pushes the queued ones to the kernel in one batch and runs the callbacks of the ones that are done,
+  so a level's worth of reads overlaps with decoding and uploading whatever finished first.
+ */
+struct AsyncFileQueue
+{
+    WorkQueue * m_workQueue;
+    bool        m_useIoUring;
+
+#ifdef __linux__
+    IoUring                     m_ring;
+    uint32                      m_inFlight;
+    std::deque<AsyncFileRead *> m_backlog;
+#endif
+
+    // NOTE: Filled by the workers of the fallback and by reads that needed no I/O
+    std::mutex                   m_mutex;
+    std::vector<AsyncFileRead *> m_completed;
+    WorkCounter                  m_pending;
+};
+
+#define ASYNC_FILE_H
+#endif //ASYNC_FILE_H
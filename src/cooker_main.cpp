@@ -0,0 +1,61 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "asset_cooker.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION
+#include "tiny_obj_loader.h"
+
+#include "asset_registry.cpp"
+#include "resource_archive.cpp"
+#include "texture_compression.cpp"
+#include "texture_cache.cpp"
+#include "mesh_cache.cpp"
+#include "obj_parser.cpp"
+#include "mesh_optimizer.cpp"
+#include "asset_cooker.cpp"
+
+// NOTE: Runs from the repository root like the app, so source and cooked paths match the ones it loads
+int main(int argc, char ** argv)
+{
+    // NOTE: Leave one core for the main thread, it helps out while waiting on jobs anyway
+    uint32 threadCount = std::thread::hardware_concurrency();
+    WorkQueue workQueue;
+    InitWorkQueue(&workQueue, threadCount > 1 ? threadCount - 1 : 1);
+    
+    // NOTE: --pack also writes RESOURCE_ARCHIVE_PATH once everything is cooked. Failed cooks only warn, the
+    //       runtime cooks whatever is missing on first load, unless --strict makes them fail the build
+    bool pack = false;
+    bool strict = false;
+    for (int32 i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--pack") == 0) pack = true;
+        else if (strcmp(argv[i], "--strict") == 0) strict = true;
+        else SM_WARN("unknown argument %s", argv[i]);
+    }
+    
+    bool cooked = RunAssetCooker(&workQueue);
+    
+    ShutdownWorkQueue(&workQueue);
+    
+    if (!cooked)
+    {
+        SM_WARN("some assets failed to cook, models and textures are cooked again when the app loads them");
+    }
+    
+    bool packed = true;
+    if (pack)
+    {
+        packed = PackResourceArchive(RESOURCE_ARCHIVE_PATH);
+    }
+    
+    return (cooked || !strict) && packed ? 0 : -1;
+}
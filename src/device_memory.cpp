@@ -0,0 +1,533 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "device_memory.h"
+
+//====================================================
+//      NOTE: TLSF
+//====================================================
+
+internal uint32 FindHighestBit(uint64 value)
+{
+    uint32 bit = 0;
+    while (value >>= 1)
+    {
+        bit++;
+    }
+    return bit;
+}
+
+internal uint32 FindLowestBit(uint32 value)
+{
+    SM_ASSERT(value, "no bit set!");
+
+    uint32 bit = 0;
+    while (!(value & 1))
+    {
+        value >>= 1;
+        bit++;
+    }
+    return bit;
+}
+
+internal void MapTlsfSize(VkDeviceSize size, uint32 * firstLevel, uint32 * secondLevel)
+{
+    if (size < TLSF_SMALL_SIZE)
+    {
+        *firstLevel  = 0;
+        *secondLevel = (uint32)(size / (TLSF_SMALL_SIZE / TLSF_SL_COUNT));
+        return;
+    }
+
+    uint32 bit = FindHighestBit(size);
+    *firstLevel  = bit - TLSF_FL_SHIFT + 1;
+    *secondLevel = (uint32)(size >> (bit - TLSF_SL_LOG2)) - TLSF_SL_COUNT;
+}
+
+// NOTE: Rounds size up to the next class boundary, so every chunk in the class it maps to is large enough
+internal void MapTlsfSearch(VkDeviceSize size, uint32 * firstLevel, uint32 * secondLevel)
+{
+    if (size < TLSF_SMALL_SIZE)
+    {
+        size += TLSF_SMALL_SIZE / TLSF_SL_COUNT - 1;
+    }
+    else
+    {
+        size += ((VkDeviceSize)1 << (FindHighestBit(size) - TLSF_SL_LOG2)) - 1;
+    }
+    MapTlsfSize(size, firstLevel, secondLevel);
+}
+
+internal void InsertFreeChunk(DeviceMemoryBlock * block, uint32 index)
+{
+    DeviceMemoryChunk & chunk = block->m_chunks[index];
+
+    uint32 firstLevel, secondLevel;
+    MapTlsfSize(chunk.m_size, &firstLevel, &secondLevel);
+
+    uint32 head = block->m_freeHeads[firstLevel][secondLevel];
+    chunk.m_free     = true;
+    chunk.m_prevFree = DEVICE_MEMORY_NONE;
+    chunk.m_nextFree = head;
+    if (head != DEVICE_MEMORY_NONE)
+    {
+        block->m_chunks[head].m_prevFree = index;
+    }
+
+    block->m_freeHeads[firstLevel][secondLevel] = index;
+    block->m_firstLevelMap |= 1u << firstLevel;
+    block->m_secondLevelMaps[firstLevel] |= 1u << secondLevel;
+}
+
+internal void RemoveFreeChunk(DeviceMemoryBlock * block, uint32 index)
+{
+    DeviceMemoryChunk & chunk = block->m_chunks[index];
+
+    uint32 firstLevel, secondLevel;
+    MapTlsfSize(chunk.m_size, &firstLevel, &secondLevel);
+
+    if (chunk.m_prevFree != DEVICE_MEMORY_NONE)
+    {
+        block->m_chunks[chunk.m_prevFree].m_nextFree = chunk.m_nextFree;
+    }
+    else
+    {
+        block->m_freeHeads[firstLevel][secondLevel] = chunk.m_nextFree;
+    }
+    if (chunk.m_nextFree != DEVICE_MEMORY_NONE)
+    {
+        block->m_chunks[chunk.m_nextFree].m_prevFree = chunk.m_prevFree;
+    }
+
+    if (block->m_freeHeads[firstLevel][secondLevel] == DEVICE_MEMORY_NONE)
+    {
+        block->m_secondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+        if (!block->m_secondLevelMaps[firstLevel])
+        {
+            block->m_firstLevelMap &= ~(1u << firstLevel);
+        }
+    }
+
+    chunk.m_free = false;
+}
+
+// NOTE: Head of the first non-empty free list at or above the class, DEVICE_MEMORY_NONE if there is none
+internal uint32 FindFreeChunk(DeviceMemoryBlock * block, uint32 firstLevel, uint32 secondLevel)
+{
+    uint32 secondLevelMap = block->m_secondLevelMaps[firstLevel] & (~0u << secondLevel);
+    if (!secondLevelMap)
+    {
+        uint32 firstLevelMap = firstLevel + 1 < TLSF_FL_COUNT ? block->m_firstLevelMap & (~0u << (firstLevel + 1)) : 0;
+        if (!firstLevelMap)
+        {
+            return DEVICE_MEMORY_NONE;
+        }
+
+        firstLevel = FindLowestBit(firstLevelMap);
+        secondLevelMap = block->m_secondLevelMaps[firstLevel];
+    }
+
+    return block->m_freeHeads[firstLevel][FindLowestBit(secondLevelMap)];
+}
+
+internal uint32 AddMemoryChunk(DeviceMemoryBlock * block)
+{
+    if (!block->m_unusedChunks.empty())
+    {
+        uint32 index = block->m_unusedChunks.back();
+        block->m_unusedChunks.pop_back();
+        return index;
+    }
+
+    block->m_chunks.push_back({});
+    return (uint32)block->m_chunks.size() - 1;
+}
+
+// NOTE: Cuts the chunk after size bytes and returns the chunk of the rest, which is left unlinked from the free lists
+internal uint32 SplitMemoryChunk(DeviceMemoryBlock * block, uint32 index, VkDeviceSize size)
+{
+    uint32 rest = AddMemoryChunk(block);
+
+    DeviceMemoryChunk & chunk = block->m_chunks[index];
+    DeviceMemoryChunk & restChunk = block->m_chunks[rest];
+    restChunk = {};
+    restChunk.m_offset       = chunk.m_offset + size;
+    restChunk.m_size         = chunk.m_size - size;
+    restChunk.m_prevPhysical = index;
+    restChunk.m_nextPhysical = chunk.m_nextPhysical;
+
+    if (chunk.m_nextPhysical != DEVICE_MEMORY_NONE)
+    {
+        block->m_chunks[chunk.m_nextPhysical].m_prevPhysical = rest;
+    }
+    chunk.m_nextPhysical = rest;
+    chunk.m_size = size;
+
+    return rest;
+}
+
+// NOTE: Folds next into index, next must directly follow it
+internal void MergeMemoryChunks(DeviceMemoryBlock * block, uint32 index, uint32 next)
+{
+    DeviceMemoryChunk & chunk = block->m_chunks[index];
+    DeviceMemoryChunk & nextChunk = block->m_chunks[next];
+
+    chunk.m_size += nextChunk.m_size;
+    chunk.m_nextPhysical = nextChunk.m_nextPhysical;
+    if (nextChunk.m_nextPhysical != DEVICE_MEMORY_NONE)
+    {
+        block->m_chunks[nextChunk.m_nextPhysical].m_prevPhysical = index;
+    }
+
+    nextChunk = {};
+    block->m_unusedChunks.push_back(next);
+}
+
+// NOTE: Good fit in constant time. Searching for size + alignment - 1 makes any chunk of the class fit whatever
+//       padding its offset needs, the padding is given back as a free chunk of its own
+internal bool AllocateFromBlock(DeviceMemoryBlock * block, VkDeviceSize size, VkDeviceSize alignment, uint32 * chunkIndex)
+{
+    uint32 firstLevel, secondLevel;
+    MapTlsfSearch(size + alignment - 1, &firstLevel, &secondLevel);
+    if (firstLevel >= TLSF_FL_COUNT)
+    {
+        return false;
+    }
+
+    uint32 index = FindFreeChunk(block, firstLevel, secondLevel);
+    if (index == DEVICE_MEMORY_NONE)
+    {
+        return false;
+    }
+    RemoveFreeChunk(block, index);
+
+    VkDeviceSize offset = block->m_chunks[index].m_offset;
+    VkDeviceSize padding = ((offset + alignment - 1) & ~(alignment - 1)) - offset;
+    if (padding > 0)
+    {
+        // NOTE: The chunk before is in use, free chunks are never neighbours
+        uint32 aligned = SplitMemoryChunk(block, index, padding);
+        InsertFreeChunk(block, index);
+        index = aligned;
+    }
+
+    if (block->m_chunks[index].m_size - size >= TLSF_MIN_SPLIT)
+    {
+        uint32 rest = SplitMemoryChunk(block, index, size);
+        InsertFreeChunk(block, rest);
+    }
+
+    block->m_used += block->m_chunks[index].m_size;
+    *chunkIndex = index;
+    return true;
+}
+
+internal void FreeBlockChunk(DeviceMemoryBlock * block, uint32 index)
+{
+    SM_ASSERT(!block->m_chunks[index].m_free, "device memory chunk %u is freed twice!", index);
+    block->m_used -= block->m_chunks[index].m_size;
+
+    uint32 prev = block->m_chunks[index].m_prevPhysical;
+    if (prev != DEVICE_MEMORY_NONE && block->m_chunks[prev].m_free)
+    {
+        RemoveFreeChunk(block, prev);
+        MergeMemoryChunks(block, prev, index);
+        index = prev;
+    }
+
+    uint32 next = block->m_chunks[index].m_nextPhysical;
+    if (next != DEVICE_MEMORY_NONE && block->m_chunks[next].m_free)
+    {
+        RemoveFreeChunk(block, next);
+        MergeMemoryChunks(block, index, next);
+    }
+
+    InsertFreeChunk(block, index);
+}
+
+//====================================================
+//      NOTE: Device Memory Functions
+//====================================================
+
+internal void InitDeviceMemoryAllocator(DeviceMemoryAllocator * allocator, VkPhysicalDevice physicalDevice, VkDevice device)
+{
+    *allocator = {};
+    allocator->m_device = device;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &allocator->m_properties);
+
+    VkPhysicalDeviceProperties properties = {};
+    vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+    allocator->m_bufferImageGranularity = properties.limits.bufferImageGranularity;
+    allocator->m_maxAllocationCount     = properties.limits.maxMemoryAllocationCount;
+
+    SM_TRACE("device memory: blocks of %llu MB, bufferImageGranularity %llu, at most %u allocations",
+             (unsigned long long)(DEVICE_MEMORY_BLOCK_SIZE / MB(1)),
+             (unsigned long long)allocator->m_bufferImageGranularity, allocator->m_maxAllocationCount);
+}
+
+internal uint32 FindMemoryType(DeviceMemoryAllocator * allocator, uint32 typeFilter, VkMemoryPropertyFlags properties)
+{
+    const VkPhysicalDeviceMemoryProperties & memProperties = allocator->m_properties;
+    for (uint32 i = 0; i < memProperties.memoryTypeCount; i++)
+    {
+        if ((typeFilter & (1 << i)) &&
+            (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+        {
+            return i;
+        }
+    }
+
+    SM_ASSERT(false, "failed to find suitable memory type!");
+
+    return 0;
+}
+
+internal bool IsHostVisibleMemoryType(DeviceMemoryAllocator * allocator, uint32 memoryType)
+{
+    return (allocator->m_properties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) != 0;
+}
+
+// NOTE: Maps host visible memory right away, it stays mapped until it is freed
+internal VkDeviceMemory AllocateMemoryOfType(DeviceMemoryAllocator * allocator, VkDeviceSize size, uint32 memoryType, uint8 ** mapped)
+{
+    *mapped = nullptr;
+    if (allocator->m_stats.m_allocationCount >= allocator->m_maxAllocationCount)
+    {
+        SM_WARN("device memory: at maxMemoryAllocationCount (%u)", allocator->m_maxAllocationCount);
+    }
+
+    VkMemoryAllocateInfo allocateInfo = {};
+    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocateInfo.allocationSize = size;
+    allocateInfo.memoryTypeIndex = memoryType;
+
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    if (vkAllocateMemory(allocator->m_device, &allocateInfo, nullptr, &memory) != VK_SUCCESS)
+    {
+        return VK_NULL_HANDLE;
+    }
+
+    if (IsHostVisibleMemoryType(allocator, memoryType))
+    {
+        vkMapMemory(allocator->m_device, memory, 0, VK_WHOLE_SIZE, 0, (void **)mapped);
+    }
+
+    allocator->m_stats.m_allocationCount++;
+    allocator->m_stats.m_allocatedBytes += size;
+    return memory;
+}
+
+internal void FreeMemoryOfType(DeviceMemoryAllocator * allocator, VkDeviceMemory memory, VkDeviceSize size, bool mapped)
+{
+    if (mapped)
+    {
+        vkUnmapMemory(allocator->m_device, memory);
+    }
+    vkFreeMemory(allocator->m_device, memory, nullptr);
+
+    allocator->m_stats.m_allocationCount--;
+    allocator->m_stats.m_allocatedBytes -= size;
+}
+
+// NOTE: Returns the index of the new block, DEVICE_MEMORY_NONE if the heap is out of room for one
+internal uint32 CreateDeviceMemoryBlock(DeviceMemoryAllocator * allocator, uint32 memoryType, DeviceMemoryKind kind, VkDeviceSize size)
+{
+    uint8 * mapped = nullptr;
+    VkDeviceMemory memory = AllocateMemoryOfType(allocator, size, memoryType, &mapped);
+    if (!memory)
+    {
+        return DEVICE_MEMORY_NONE;
+    }
+
+    uint32 index = 0;
+    while (index < allocator->m_blocks.size() && allocator->m_blocks[index].m_memory)
+    {
+        index++;
+    }
+    if (index == allocator->m_blocks.size())
+    {
+        allocator->m_blocks.push_back({});
+    }
+
+    DeviceMemoryBlock & block = allocator->m_blocks[index];
+    block = {};
+    block.m_memory     = memory;
+    block.m_size       = size;
+    block.m_mapped     = mapped;
+    block.m_memoryType = memoryType;
+    block.m_kind       = kind;
+    memset(block.m_freeHeads, 0xFF, sizeof(block.m_freeHeads));
+
+    DeviceMemoryChunk whole = {};
+    whole.m_size         = size;
+    whole.m_prevPhysical = DEVICE_MEMORY_NONE;
+    whole.m_nextPhysical = DEVICE_MEMORY_NONE;
+    block.m_chunks.push_back(whole);
+    InsertFreeChunk(&block, 0);
+
+    SM_TRACE("device memory: new %llu MB block %u of memory type %u", (unsigned long long)(size / MB(1)), index, memoryType);
+    return index;
+}
+
+internal void DestroyDeviceMemoryBlock(DeviceMemoryAllocator * allocator, uint32 index)
+{
+    DeviceMemoryBlock & block = allocator->m_blocks[index];
+    FreeMemoryOfType(allocator, block.m_memory, block.m_size, block.m_mapped != nullptr);
+    block = {};
+}
+
+internal VkDeviceSize GetDeviceMemoryBlockSize(DeviceMemoryAllocator * allocator, uint32 memoryType)
+{
+    uint32 heap = allocator->m_properties.memoryTypes[memoryType].heapIndex;
+    return std::min(DEVICE_MEMORY_BLOCK_SIZE, allocator->m_properties.memoryHeaps[heap].size / 8);
+}
+
+internal bool AllocateDedicatedMemory(DeviceMemoryAllocator * allocator, VkDeviceSize size, uint32 memoryType, DeviceAllocation * allocation)
+{
+    uint8 * mapped = nullptr;
+    VkDeviceMemory memory = AllocateMemoryOfType(allocator, size, memoryType, &mapped);
+    if (!memory)
+    {
+        return false;
+    }
+
+    allocation->m_memory = memory;
+    allocation->m_offset = 0;
+    allocation->m_size   = size;
+    allocation->m_mapped = mapped;
+    allocation->m_block  = DEVICE_MEMORY_DEDICATED;
+    allocation->m_chunk  = DEVICE_MEMORY_NONE;
+
+    allocator->m_stats.m_usedBytes += size;
+    return true;
+}
+
+internal void FillBlockAllocation(DeviceMemoryAllocator * allocator, uint32 blockIndex, uint32 chunkIndex, DeviceAllocation * allocation)
+{
+    DeviceMemoryBlock & block = allocator->m_blocks[blockIndex];
+    const DeviceMemoryChunk & chunk = block.m_chunks[chunkIndex];
+
+    allocation->m_memory = block.m_memory;
+    allocation->m_offset = chunk.m_offset;
+    allocation->m_size   = chunk.m_size;
+    allocation->m_mapped = block.m_mapped ? block.m_mapped + chunk.m_offset : nullptr;
+    allocation->m_block  = blockIndex;
+    allocation->m_chunk  = chunkIndex;
+
+    allocator->m_stats.m_usedBytes += chunk.m_size;
+}
+
+// NOTE: Sub-allocates from an existing block of the memory type, then from a new one. dedicated, or anything over
+//       half a block, gets memory of its own. Returns false if the device is out of memory
+internal bool AllocateDeviceMemory(DeviceMemoryAllocator * allocator, const VkMemoryRequirements & requirements,
+                                   VkMemoryPropertyFlags properties, DeviceMemoryKind kind, bool dedicated,
+                                   DeviceAllocation * allocation)
+{
+    *allocation = {};
+
+    uint32 memoryType = FindMemoryType(allocator, requirements.memoryTypeBits, properties);
+    VkDeviceSize blockSize = GetDeviceMemoryBlockSize(allocator, memoryType);
+
+    if (allocator->m_bufferImageGranularity <= 1)
+    {
+        kind = DEVICE_MEMORY_LINEAR;
+    }
+
+    if (dedicated || requirements.size > blockSize / 2)
+    {
+        return AllocateDedicatedMemory(allocator, requirements.size, memoryType, allocation);
+    }
+
+    uint32 chunkIndex = DEVICE_MEMORY_NONE;
+    for (uint32 b = 0; b < allocator->m_blocks.size(); b++)
+    {
+        DeviceMemoryBlock & block = allocator->m_blocks[b];
+        if (!block.m_memory || block.m_memoryType != memoryType || block.m_kind != kind ||
+            block.m_size - block.m_used < requirements.size)
+        {
+            continue;
+        }
+
+        if (AllocateFromBlock(&block, requirements.size, requirements.alignment, &chunkIndex))
+        {
+            FillBlockAllocation(allocator, b, chunkIndex, allocation);
+            return true;
+        }
+    }
+
+    uint32 blockIndex = CreateDeviceMemoryBlock(allocator, memoryType, kind, blockSize);
+    if (blockIndex == DEVICE_MEMORY_NONE)
+    {
+        // NOTE: The heap may still have room for the resource itself
+        SM_WARN("device memory: no room for a new block of memory type %u", memoryType);
+        return AllocateDedicatedMemory(allocator, requirements.size, memoryType, allocation);
+    }
+
+    if (!AllocateFromBlock(&allocator->m_blocks[blockIndex], requirements.size, requirements.alignment, &chunkIndex))
+    {
+        SM_ASSERT(false, "a new block does not fit %llu bytes!", (unsigned long long)requirements.size);
+        return false;
+    }
+
+    FillBlockAllocation(allocator, blockIndex, chunkIndex, allocation);
+    return true;
+}
+
+// NOTE: Empty blocks go back to the driver, except the last one of their memory type and kind, which is kept for
+//       the next upload
+internal void FreeDeviceMemory(DeviceMemoryAllocator * allocator, DeviceAllocation * allocation)
+{
+    if (!allocation->m_memory)
+    {
+        return;
+    }
+
+    allocator->m_stats.m_usedBytes -= allocation->m_size;
+
+    if (allocation->m_block == DEVICE_MEMORY_DEDICATED)
+    {
+        FreeMemoryOfType(allocator, allocation->m_memory, allocation->m_size, allocation->m_mapped != nullptr);
+        *allocation = {};
+        return;
+    }
+
+    DeviceMemoryBlock & block = allocator->m_blocks[allocation->m_block];
+    FreeBlockChunk(&block, allocation->m_chunk);
+
+    if (block.m_used == 0)
+    {
+        for (uint32 b = 0; b < allocator->m_blocks.size(); b++)
+        {
+            const DeviceMemoryBlock & other = allocator->m_blocks[b];
+            if (b != allocation->m_block && other.m_memory &&
+                other.m_memoryType == block.m_memoryType && other.m_kind == block.m_kind)
+            {
+                DestroyDeviceMemoryBlock(allocator, allocation->m_block);
+                break;
+            }
+        }
+    }
+
+    *allocation = {};
+}
+
+// NOTE: Everything sub-allocated has to be freed by now, only the blocks themselves are left
+internal void ShutdownDeviceMemoryAllocator(DeviceMemoryAllocator * allocator)
+{
+    for (uint32 b = 0; b < allocator->m_blocks.size(); b++)
+    {
+        if (allocator->m_blocks[b].m_memory)
+        {
+            SM_ASSERT(allocator->m_blocks[b].m_used == 0, "device memory block %u still has allocations!", b);
+            DestroyDeviceMemoryBlock(allocator, b);
+        }
+    }
+
+    SM_ASSERT(allocator->m_stats.m_allocationCount == 0, "%u dedicated allocations were never freed!", allocator->m_stats.m_allocationCount);
+    allocator->m_blocks.clear();
+}
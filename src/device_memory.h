@@ -0,0 +1,108 @@
+/* date = October 18th 2026 10:45 pm */
+
+#ifndef DEVICE_MEMORY_H
+
+#include <vulkan/vulkan.h>
+
+#include "engine_lib.h"
+
+//====================================================
+//      NOTE: Device Memory Constexpr
+//====================================================
+
+// NOTE: Buffers and images are sub-allocated from blocks of this size, a list of blocks per memory type. Heaps
+//       smaller than eight blocks get blocks of an eighth of the heap instead
+constexpr VkDeviceSize DEVICE_MEMORY_BLOCK_SIZE = MB(64);
+
+// NOTE: Images at least this large get a vkAllocateMemory of their own instead of most of a block. So does
+//       anything over half a block, and render targets, which come and go with the swapchain
+constexpr VkDeviceSize DEVICE_MEMORY_DEDICATED_SIZE = MB(16);
+
+// NOTE: TLSF size classes. Every power of two is split into TLSF_SL_COUNT linear classes, sizes under
+//       1 << TLSF_FL_SHIFT all share first level 0
+constexpr uint32 TLSF_SL_LOG2  = 4;
+constexpr uint32 TLSF_SL_COUNT = 1 << TLSF_SL_LOG2;
+constexpr uint32 TLSF_FL_SHIFT = 8;
+constexpr uint32 TLSF_FL_COUNT = 32;
+constexpr VkDeviceSize TLSF_SMALL_SIZE = 1 << TLSF_FL_SHIFT;
+
+// NOTE: Leftovers smaller than this stay with the allocation instead of becoming a free chunk
+constexpr VkDeviceSize TLSF_MIN_SPLIT = 256;
+
+constexpr uint32 DEVICE_MEMORY_NONE      = 0xFFFFFFFF;
+constexpr uint32 DEVICE_MEMORY_DEDICATED = 0xFFFFFFFE;
+
+//====================================================
+//      NOTE: Device Memory Structs
+//====================================================
+
+// NOTE: Buffers and linear images never share a block with optimal images, so bufferImageGranularity can not
+//       apply between neighbours. Devices without a granularity requirement put everything in linear blocks
+enum DeviceMemoryKind
+{
+    DEVICE_MEMORY_LINEAR,
+    DEVICE_MEMORY_OPTIMAL,
+};
+
+// NOTE: A range of a block, used or free, linked to its physical neighbours. Free chunks are also linked into the
+//       list of their size class. No two free chunks are ever neighbours, freeing merges them
+struct DeviceMemoryChunk
+{
+    VkDeviceSize m_offset;
+    VkDeviceSize m_size;
+    uint32       m_prevPhysical;
+    uint32       m_nextPhysical;
+    uint32       m_prevFree;
+    uint32       m_nextFree;
+    bool         m_free;
+};
+
+struct DeviceMemoryBlock
+{
+    VkDeviceMemory   m_memory;
+    VkDeviceSize     m_size;
+    VkDeviceSize     m_used;
+    uint8 *          m_mapped; // NOTE: Host visible blocks stay mapped for their whole life
+    uint32           m_memoryType;
+    DeviceMemoryKind m_kind;
+
+    uint32 m_firstLevelMap;
+    uint32 m_secondLevelMaps[TLSF_FL_COUNT];
+    uint32 m_freeHeads[TLSF_FL_COUNT][TLSF_SL_COUNT];
+
+    std::vector<DeviceMemoryChunk> m_chunks;
+    std::vector<uint32>            m_unusedChunks; // NOTE: Slots of merged chunks, reused before m_chunks grows
+};
+
+// NOTE: m_block is DEVICE_MEMORY_DEDICATED for allocations with a VkDeviceMemory of their own. m_mapped points at
+//       m_offset for host visible memory, nullptr otherwise
+struct DeviceAllocation
+{
+    VkDeviceMemory m_memory;
+    VkDeviceSize   m_offset;
+    VkDeviceSize   m_size;
+    void *         m_mapped;
+    uint32         m_block;
+    uint32         m_chunk;
+};
+
+struct DeviceMemoryStats
+{
+    uint32       m_allocationCount; // NOTE: Live vkAllocateMemory calls, blocks and dedicated allocations
+    VkDeviceSize m_allocatedBytes;
+    VkDeviceSize m_usedBytes;
+};
+
+struct DeviceMemoryAllocator
+{
+    VkDevice                         m_device;
+    VkPhysicalDeviceMemoryProperties m_properties;
+    VkDeviceSize                     m_bufferImageGranularity;
+    uint32                           m_maxAllocationCount;
+
+    std::vector<DeviceMemoryBlock> m_blocks; // NOTE: Released blocks keep their slot with a null m_memory
+    DeviceMemoryStats              m_stats;
+};
+
+#define DEVICE_MEMORY_H
+#endif //DEVICE_MEMORY_H
@@ -13,11 +13,29 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#define NOGDI
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 #include <cmath>
 #include <vector>
 #include <set>
 #include <optional>
 #include <iostream>
+#include <deque>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <filesystem>
 //  ========================================================================
 // NOTE: Defines
 //  ========================================================================
@@ -251,6 +269,242 @@ struct Array
 
 };
 
+//  ========================================================================
+// NOTE: Span
+//  ========================================================================
+// NOTE: Non owning view of count contiguous elements, e.g. part of a mapped file. C++17 has no std::span
+template<typename T>
+struct Span
+{
+    T *    elements = nullptr;
+    size_t count    = 0;
+
+    T & operator[](size_t idx) const
+    {
+        SM_ASSERT(idx < count, "Idx out of bounds!");
+        return elements[idx];
+    }
+
+    T * begin() const { return elements; }
+    T * end() const   { return elements + count; }
+
+    bool IsEmpty() const
+    {
+        return count == 0;
+    }
+};
+
+
+//  ========================================================================
+// NOTE: Hash Table
+//  ========================================================================
+internal uint64 RotateLeft64(uint64 x, uint32 shift)
+{
+    return (x << shift) | (x >> (64 - shift));
+}
+
+// NOTE: Final avalanche step, every input bit affects every output bit
+internal uint64 HashMix64(uint64 h)
+{
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+// NOTE: 64 bit hash of raw bytes, eight bytes per round
+internal uint64 HashBytes64(const void * data, size_t size)
+{
+    constexpr uint64 PRIME1 = 0x9E3779B185EBCA87ULL;
+    constexpr uint64 PRIME2 = 0xC2B2AE3D27D4EB4FULL;
+    constexpr uint64 PRIME3 = 0x165667B19E3779F9ULL;
+
+    const uint8 * bytes = (const uint8 *)data;
+    uint64 h = PRIME3 ^ ((uint64)size * PRIME1);
+
+    while (size >= 8)
+    {
+        uint64 k;
+        memcpy(&k, bytes, 8);
+        h ^= RotateLeft64(k * PRIME2, 31) * PRIME1;
+        h = RotateLeft64(h, 27) * PRIME1 + PRIME3;
+        bytes += 8;
+        size -= 8;
+    }
+
+    while (size > 0)
+    {
+        h ^= (*bytes) * PRIME3;
+        h = RotateLeft64(h, 11) * PRIME1;
+        bytes++;
+        size--;
+    }
+
+    return HashMix64(h);
+}
+
+// NOTE: Flat open addressing table with Robin Hood linear probing. Keys are hashed and compared
+//       bitwise, so they must be plain data without padding. Nothing is ever removed
+template<typename K, typename V>
+struct HashTable
+{
+    static_assert(std::is_trivially_copyable<K>::value, "HashTable keys are compared bitwise!");
+
+    struct Slot
+    {
+        uint32 distance; // NOTE: Probe distance + 1, 0 means empty
+        uint32 hashTag;
+        K key;
+        V value;
+    };
+
+    std::vector<Slot> slots;
+    uint32 count = 0;
+    uint32 mask = 0;
+
+    void Init(uint32 expectedCount)
+    {
+        // NOTE: Keep the load factor under 7/8 without growing
+        uint64 capacity = 16;
+        while (capacity * 7 < (uint64)expectedCount * 8)
+        {
+            capacity *= 2;
+        }
+
+        slots.clear();
+        slots.resize(capacity);
+        count = 0;
+        mask = (uint32)capacity - 1;
+    }
+
+    V * Find(const K & key)
+    {
+        if (slots.empty())
+        {
+            return nullptr;
+        }
+
+        uint64 hash = HashBytes64(&key, sizeof(K));
+        uint32 hashTag = (uint32)(hash >> 32);
+        uint32 index = (uint32)hash & mask;
+
+        for (uint32 distance = 1; ; distance++)
+        {
+            Slot & slot = slots[index];
+
+            // NOTE: A richer slot means the key would have been placed before it
+            if (slot.distance < distance)
+            {
+                return nullptr;
+            }
+
+            if (slot.hashTag == hashTag && memcmp(&slot.key, &key, sizeof(K)) == 0)
+            {
+                return &slot.value;
+            }
+
+            index = (index + 1) & mask;
+        }
+    }
+
+    // NOTE: Returns the value already stored for key, or stores and returns value
+    V FindOrAdd(const K & key, V value)
+    {
+        if (slots.empty() || (count + 1) * 8 > (uint32)slots.size() * 7)
+        {
+            Grow();
+        }
+
+        uint64 hash = HashBytes64(&key, sizeof(K));
+        uint32 hashTag = (uint32)(hash >> 32);
+        uint32 index = (uint32)hash & mask;
+
+        for (uint32 distance = 1; ; distance++)
+        {
+            Slot & slot = slots[index];
+
+            if (slot.distance < distance)
+            {
+                Slot entry = { distance, hashTag, key, value };
+                if (slot.distance != 0)
+                {
+                    Place(slot, index);
+                }
+                slot = entry;
+                count++;
+                return value;
+            }
+
+            if (slot.hashTag == hashTag && memcmp(&slot.key, &key, sizeof(K)) == 0)
+            {
+                return slot.value;
+            }
+
+            index = (index + 1) & mask;
+        }
+    }
+
+    void Clear()
+    {
+        slots.clear();
+        count = 0;
+        mask = 0;
+    }
+
+    // NOTE: Pushes a displaced entry further down the chain, stealing from richer slots on the way
+    void Place(Slot entry, uint32 index)
+    {
+        for (;;)
+        {
+            index = (index + 1) & mask;
+            entry.distance++;
+
+            Slot & slot = slots[index];
+            if (slot.distance == 0)
+            {
+                slot = entry;
+                return;
+            }
+
+            if (slot.distance < entry.distance)
+            {
+                Slot temp = slot;
+                slot = entry;
+                entry = temp;
+            }
+        }
+    }
+
+    void Grow()
+    {
+        std::vector<Slot> oldSlots = std::move(slots);
+        Init(oldSlots.empty() ? 0 : (uint32)oldSlots.size());
+
+        for (Slot & oldSlot : oldSlots)
+        {
+            if (oldSlot.distance == 0)
+            {
+                continue;
+            }
+
+            Slot entry = oldSlot;
+            entry.distance = 1;
+
+            uint32 index = (uint32)HashBytes64(&entry.key, sizeof(K)) & mask;
+            if (slots[index].distance == 0)
+            {
+                slots[index] = entry;
+            }
+            else
+            {
+                Place(entry, index);
+            }
+            count++;
+        }
+    }
+};
 
 //  ========================================================================
 // NOTE: Bump Allocator
@@ -302,6 +556,173 @@ internal char * BumpAlloc(BumpAllocator * ba, size_t size)
     
 }
 
+//  ========================================================================
+// NOTE: Memory Mapped Files
+//  ========================================================================
+// NOTE: How a mapping is going to be read, turned into madvise / file flag hints so the OS reads ahead the right way
+enum FileAccess
+{
+    FILE_ACCESS_NORMAL,
+    FILE_ACCESS_SEQUENTIAL, // NOTE: Read front to back once, e.g. a cooked mesh copied out or a shader
+    FILE_ACCESS_RANDOM,     // NOTE: Scattered reads, e.g. the resource archive index and its entries
+};
+
+struct MappedFile
+{
+    char * memory;
+    size_t size;
+
+#ifdef _WIN32
+    HANDLE fileHandle;
+    HANDLE mappingHandle;
+#endif
+};
+
+// NOTE: Hints that [offset, offset + size) of the mapping is about to be read with the given pattern. Windows has
+//       no per range equivalent of madvise, there sequential ranges are prefetched and the rest is left alone
+internal void AdviseMappedFile(MappedFile * file, size_t offset, size_t size, FileAccess access)
+{
+    SM_ASSERT(file, "No mapped file provided!");
+    SM_ASSERT(offset + size <= file->size, "Advised range is outside the mapping!");
+
+    if (!file->memory || size == 0)
+    {
+        return;
+    }
+
+#ifdef _WIN32
+    if (access == FILE_ACCESS_SEQUENTIAL)
+    {
+        WIN32_MEMORY_RANGE_ENTRY range = {};
+        range.VirtualAddress = file->memory + offset;
+        range.NumberOfBytes  = size;
+        PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+    }
+#else
+    // NOTE: madvise wants a page aligned start
+    size_t pageSize = (size_t)sysconf(_SC_PAGESIZE);
+    size_t begin = offset & ~(pageSize - 1);
+
+    int advice = access == FILE_ACCESS_SEQUENTIAL ? MADV_SEQUENTIAL :
+        access == FILE_ACCESS_RANDOM ? MADV_RANDOM : MADV_NORMAL;
+    madvise(file->memory + begin, offset + size - begin, advice);
+#endif
+}
+
+// NOTE: Maps a whole file read-only. memory is nullptr if the file could not be opened or is empty
+internal MappedFile MapFile(char * filePath, FileAccess access = FILE_ACCESS_NORMAL)
+{
+    SM_ASSERT(filePath, "No file path provided!");
+
+    MappedFile result = {};
+
+#ifdef _WIN32
+    DWORD flags = FILE_ATTRIBUTE_NORMAL;
+    flags |= access == FILE_ACCESS_SEQUENTIAL ? FILE_FLAG_SEQUENTIAL_SCAN : 0;
+    flags |= access == FILE_ACCESS_RANDOM ? FILE_FLAG_RANDOM_ACCESS : 0;
+
+    HANDLE fileHandle = CreateFileA(filePath, GENERIC_READ, FILE_SHARE_READ, nullptr,
+                                    OPEN_EXISTING, flags, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE)
+    {
+        return result;
+    }
+
+    LARGE_INTEGER fileSize = {};
+    if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart == 0)
+    {
+        CloseHandle(fileHandle);
+        return result;
+    }
+
+    HANDLE mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mappingHandle)
+    {
+        CloseHandle(fileHandle);
+        return result;
+    }
+
+    void * memory = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+    if (!memory)
+    {
+        CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        return result;
+    }
+
+    result.memory        = (char *)memory;
+    result.size          = (size_t)fileSize.QuadPart;
+    result.fileHandle    = fileHandle;
+    result.mappingHandle = mappingHandle;
+#else
+    int fd = open(filePath, O_RDONLY);
+    if (fd < 0)
+    {
+        return result;
+    }
+
+    struct stat fileStat = {};
+    if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+    {
+        close(fd);
+        return result;
+    }
+
+    void * memory = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // NOTE: The mapping keeps its own reference to the file
+    close(fd);
+    if (memory == MAP_FAILED)
+    {
+        return result;
+    }
+
+    result.memory = (char *)memory;
+    result.size   = (size_t)fileStat.st_size;
+#endif
+
+    if (access != FILE_ACCESS_NORMAL)
+    {
+        AdviseMappedFile(&result, 0, result.size, access);
+    }
+
+    return result;
+}
+
+internal void UnmapFile(MappedFile * file)
+{
+    SM_ASSERT(file, "No mapped file provided!");
+
+    if (file->memory)
+    {
+#ifdef _WIN32
+        UnmapViewOfFile(file->memory);
+        CloseHandle(file->mappingHandle);
+        CloseHandle(file->fileHandle);
+#else
+        munmap(file->memory, file->size);
+#endif
+    }
+
+    *file = {};
+}
+
+// NOTE: Views count elements of T at offset into the mapping, without copying. The mapping must outlive the span
+template<typename T>
+internal Span<const T> ViewMappedFile(const MappedFile & file, size_t offset, size_t count)
+{
+    SM_ASSERT(offset + count * sizeof(T) <= file.size, "View is outside the mapping!");
+
+    Span<const T> result = {};
+    result.elements = (const T *)(file.memory + offset);
+    result.count    = count;
+    return result;
+}
+
+internal Span<const char> ViewMappedFile(const MappedFile & file)
+{
+    return ViewMappedFile<char>(file, 0, file.size);
+}
+
 //  ========================================================================
 // NOTE: File I/O
 //  ========================================================================
@@ -326,29 +747,23 @@ internal bool FileExists(char * filePath)
     return true;    
 }
 
+// NOTE: Asks the file system instead of opening the file
 internal long GetFileSize(char * filePath)
 {
     SM_ASSERT(filePath, "No file path provided!");
 
-    long fileSize = 0;
-    
-    auto file = fopen(filePath, "rb");
-    if (!file)
+    struct stat fileStat = {};
+    if (stat(filePath, &fileStat) != 0)
     {
         SM_ERROR("Failed to open file: %s", filePath);
         return 0;
     }
 
-    fseek(file, 0, SEEK_END);
-    fileSize = ftell(file);
-    fseek(file, 0, SEEK_SET);
-        
-    fclose(file);
-
-    return fileSize;
+    return (long)fileStat.st_size;
 }
 
-// NOTE: Reads a file into a supplied buffer. We manage our own memory and therefore want more contorl over where it is allocated
+// NOTE: Reads a file into a supplied buffer. We manage our own memory and therefore want more contorl over where it is allocated.
+//       The buffer needs one byte more than the file for the terminator. Prefer MapFile when a view of the file is enough
 internal char * read_file(char * filePath, int * fileSize, char * buffer)
 {
     SM_ASSERT(filePath, "No file pth provided!");
@@ -368,8 +783,8 @@ internal char * read_file(char * filePath, int * fileSize, char * buffer)
     *fileSize = ftell(file);
     fseek(file, 0, SEEK_SET);
 
-    memset(buffer, 0, *fileSize + 1);
-    fread(buffer, sizeof(char), *fileSize, file);
+    *fileSize = (int)fread(buffer, sizeof(char), *fileSize, file);
+    buffer[*fileSize] = 0;
 
     fclose(file);
 
@@ -425,44 +840,184 @@ internal void write_file(char * filePath, char * buffer, int size)
     fclose(file);
 }
 
-internal bool copy_file(char * fileName, char * outputName, char * buffer)
+// NOTE: Writes straight out of a mapping of the source, nothing is staged in between
+internal bool copy_file(char * fileName, char * outputName)
 {
-    int fileSize = 0;
-    char * data = read_file(fileName, &fileSize, buffer);
+    MappedFile source = MapFile(fileName, FILE_ACCESS_SEQUENTIAL);
+    if (!source.memory && !FileExists(fileName))
+    {
+        SM_ERROR("Failed to open file: %s", fileName);
+        return false;
+    }
 
     auto outputFile = fopen(outputName, "wb");
     if (!outputFile)
     {
         SM_ERROR("Failed to open file: %s", outputName);
+        UnmapFile(&source);
         return false;
     }
 
-    size_t result = fwrite(data, sizeof(char), fileSize, outputFile);
-    if (!result)
+    // NOTE: An empty source maps to nothing and copies to an empty file
+    size_t size = source.size;
+    size_t result = fwrite(source.memory, sizeof(char), size, outputFile);
+    fclose(outputFile);
+    UnmapFile(&source);
+
+    if (result != size)
     {
-        SM_ERROR("Failed to open file: %s", outputName);
+        SM_ERROR("Failed to write file: %s", outputName);
         return false;
     }
 
-    fclose(outputFile);
-
     return true;
 }
 
+// NOTE: The buffer is no longer needed, copies go through a mapping of the source
+internal bool copy_file(char * fileName, char * outputName, char *)
+{
+    return copy_file(fileName, outputName);
+}
 
-internal bool copy_file(char * fileName, char * outputName, BumpAllocator * ba)
+internal bool copy_file(char * fileName, char * outputName, BumpAllocator *)
 {
+    return copy_file(fileName, outputName);
+}
 
-    char * file = nullptr;
-    long fileSize = GetFileSize(fileName);
-    if (fileSize)
+//  ========================================================================
+// NOTE: Work Queue
+//  ========================================================================
+struct WorkCounter
+{
+    std::atomic<uint32> pending = 0;
+};
+
+struct WorkQueueEntry
+{
+    std::function<void()> work;
+    WorkCounter * counter;
+};
+
+struct WorkQueue
+{
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workCompleted;
+    std::deque<WorkQueueEntry> entries;
+    std::vector<std::thread> threads;
+    bool running = false;
+};
+
+internal void RunWorkQueueEntry(WorkQueue * queue, WorkQueueEntry & entry)
+{
+    entry.work();
+
+    if (entry.counter)
     {
-        char * buffer = BumpAlloc(ba, fileSize + 1);
-        return copy_file(fileName, outputName, buffer);
+        entry.counter->pending--;
     }
 
-    return false;
-    
+    // NOTE: Take the lock so a waiter can not miss the notify between checking the counter and sleeping
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+    }
+    queue->workCompleted.notify_all();
+}
+
+internal void WorkQueueThreadProc(WorkQueue * queue)
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        queue->workAvailable.wait(lock, [queue] { return !queue->running || !queue->entries.empty(); });
+
+        if (queue->entries.empty())
+        {
+            return;
+        }
+
+        WorkQueueEntry entry = std::move(queue->entries.front());
+        queue->entries.pop_front();
+        lock.unlock();
+
+        RunWorkQueueEntry(queue, entry);
+    }
+}
+
+internal void InitWorkQueue(WorkQueue * queue, uint32 threadCount)
+{
+    SM_ASSERT(threadCount > 0, "Work queue needs at least one thread!");
+
+    queue->running = true;
+    for (uint32 i = 0; i < threadCount; i++)
+    {
+        queue->threads.push_back(std::thread(WorkQueueThreadProc, queue));
+    }
+}
+
+// NOTE: Finishes all queued work before the threads exit
+internal void ShutdownWorkQueue(WorkQueue * queue)
+{
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->running = false;
+    }
+    queue->workAvailable.notify_all();
+
+    for (std::thread & thread : queue->threads)
+    {
+        thread.join();
+    }
+    queue->threads.clear();
+}
+
+internal void AddWork(WorkQueue * queue, WorkCounter * counter, std::function<void()> work)
+{
+    if (counter)
+    {
+        counter->pending++;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->entries.push_back({ std::move(work), counter });
+    }
+    queue->workAvailable.notify_one();
+}
+
+// NOTE: The waiting thread helps with queued work instead of sleeping, so it is safe to wait from inside a job
+internal void WaitForWork(WorkQueue * queue, WorkCounter * counter)
+{
+    for (;;)
+    {
+        std::unique_lock<std::mutex> lock(queue->mutex);
+        if (counter->pending == 0)
+        {
+            return;
+        }
+
+        if (!queue->entries.empty())
+        {
+            WorkQueueEntry entry = std::move(queue->entries.front());
+            queue->entries.pop_front();
+            lock.unlock();
+
+            RunWorkQueueEntry(queue, entry);
+            continue;
+        }
+
+        queue->workCompleted.wait(lock);
+    }
+}
+
+internal void ParallelFor(WorkQueue * queue, uint32 count, std::function<void(uint32)> work)
+{
+    WorkCounter counter;
+    for (uint32 i = 0; i < count; i++)
+    {
+        AddWork(queue, &counter, [&work, i] { work(i); });
+    }
+    WaitForWork(queue, &counter);
 }
 
 //  ========================================================================
@@ -165,6 +165,36 @@ internal void UpdateImGui(Application * app)
                     camera.m_pos.y,
                     camera.m_pos.z);
         
+        TextureMemoryStats & textureMemory = app->m_renderContext.m_textureMemory;
+        ImGui::Text("Texture Memory %.2f MB (RGBA8 %.2f MB, saved %.2f MB)", 
+                    textureMemory.m_texelBytes / (1024.0 * 1024.0),
+                    textureMemory.m_rgba8Bytes / (1024.0 * 1024.0),
+                    (textureMemory.m_rgba8Bytes - textureMemory.m_texelBytes) / (1024.0 * 1024.0));
+        
+        DeviceMemoryStats & deviceMemory = app->m_renderContext.m_deviceMemory.m_stats;
+        ImGui::Text("Device Memory %.2f / %.2f MB in %u allocations", 
+                    deviceMemory.m_usedBytes / (1024.0 * 1024.0),
+                    deviceMemory.m_allocatedBytes / (1024.0 * 1024.0),
+                    deviceMemory.m_allocationCount);
+        
+        GeometryBuffer & geometryVertices = app->m_renderContext.m_geometryVertices;
+        GeometryBuffer & geometryIndices16 = app->m_renderContext.m_geometryIndices16;
+        GeometryBuffer & geometryIndices32 = app->m_renderContext.m_geometryIndices32;
+        ImGui::Text("Geometry Vertices %.2f / %.2f MB, Indices16 %.2f / %.2f MB, Indices32 %.2f / %.2f MB", 
+                    geometryVertices.m_used / (1024.0 * 1024.0),
+                    geometryVertices.m_size / (1024.0 * 1024.0),
+                    geometryIndices16.m_used / (1024.0 * 1024.0),
+                    geometryIndices16.m_size / (1024.0 * 1024.0),
+                    geometryIndices32.m_used / (1024.0 * 1024.0),
+                    geometryIndices32.m_size / (1024.0 * 1024.0));
+        
+        TextureResidency & residency = app->m_renderContext.m_textureResidency;
+        int32 budgetMB = (int32)(residency.m_budget / MB(1));
+        if (ImGui::SliderInt("Texture Budget MB", &budgetMB, 16, 4096))
+        {
+            residency.m_budget = MB(budgetMB);
+        }
+        
         
     for (uint32 i  = 0; i < app->m_renderData.m_transforms.count; i++)
     {
@@ -8,8 +8,14 @@
 
 #include "application.cpp"
 
-int main()
+int main(int argc, char ** argv)
 {
+    // NOTE: --pack writes RESOURCE_ARCHIVE_PATH from the loose files instead of running, the next launch mounts it
+    if (argc > 1 && strcmp(argv[1], "--pack") == 0)
+    {
+        return PackResourceArchive(RESOURCE_ARCHIVE_PATH) ? 0 : -1;
+    }
+    
     Application * app = new(Application);
     if (!app)
     {
@@ -0,0 +1,165 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "mesh_cache.h"
+
+//====================================================
+//      NOTE: Mesh Cache Functions
+//====================================================
+
+internal void GetMeshCachePath(const char * sourcePath, char * cachePath, uint32 cachePathSize)
+{
+    snprintf(cachePath, cachePathSize, "%s%s", sourcePath, MESH_CACHE_EXTENSION);
+}
+
+// NOTE: Validates an already read cooked mesh of sourcePath and takes ownership of file, which is closed if it
+//       fails. Fails if checkSource is set and the source changed since it was written
+internal bool MapMeshCache(const char * sourcePath, ResourceFile file, bool checkSource, MeshCacheView * view)
+{
+    SM_ASSERT(view, "No mesh cache view provided!");
+    *view = {};
+
+    char cachePath[300];
+    GetMeshCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    if (!file.m_data || file.m_size < sizeof(MeshCacheHeader))
+    {
+        CloseResource(&file);
+        return false;
+    }
+
+    MeshCacheHeader * header = (MeshCacheHeader *)file.m_data;
+    bool packed = header->m_vertexFormat == VERTEX_FORMAT_PACKED;
+    size_t vertexStride = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    size_t expectedSize = sizeof(MeshCacheHeader) +
+        (size_t)header->m_vertexCount * vertexStride +
+        (size_t)header->m_indexCount * sizeof(uint32) +
+        (size_t)header->m_materialCount * sizeof(ModelMaterial);
+
+    bool valid = header->m_magic == MESH_CACHE_MAGIC &&
+        header->m_version == MESH_CACHE_VERSION &&
+        header->m_vertexFormat < VERTEX_FORMAT_COUNT &&
+        header->m_vertexStride == vertexStride &&
+        (!checkSource || (header->m_sourceTimestamp == GetResourceTimestamp(sourcePath) &&
+                          header->m_sourceSize == GetResourceSize(sourcePath))) &&
+        file.m_size == expectedSize;
+
+    if (!valid)
+    {
+        SM_TRACE("mesh cache %s is stale", cachePath);
+        CloseResource(&file);
+        return false;
+    }
+
+    view->m_file      = file;
+    view->m_header    = header;
+    char * vertices = file.m_data + sizeof(MeshCacheHeader);
+    view->m_vertices       = packed ? nullptr : (Vertex *)vertices;
+    view->m_packedVertices = packed ? (PackedVertex *)vertices : nullptr;
+    view->m_indices        = (uint32 *)(vertices + header->m_vertexCount * vertexStride);
+    view->m_materials      = (ModelMaterial *)(view->m_indices + header->m_indexCount);
+
+    return true;
+}
+
+// NOTE: Maps the cooked mesh of sourcePath. Fails if there is none or it is stale, see above
+internal bool MapMeshCache(const char * sourcePath, bool checkSource, MeshCacheView * view)
+{
+    char cachePath[300];
+    GetMeshCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    return MapMeshCache(sourcePath, OpenResource(cachePath, FILE_ACCESS_SEQUENTIAL), checkSource, view);
+}
+
+internal void UnmapMeshCache(MeshCacheView * view)
+{
+    CloseResource(&view->m_file);
+    *view = {};
+}
+
+internal bool LoadMeshCache(const char * sourcePath, ResourceFile file, bool checkSource, Model * model)
+{
+    MeshCacheView view;
+    if (!MapMeshCache(sourcePath, file, checkSource, &view))
+    {
+        return false;
+    }
+
+    if (view.m_packedVertices)
+    {
+        model->m_packedVertices.assign(view.m_packedVertices, view.m_packedVertices + view.m_header->m_vertexCount);
+    }
+    else
+    {
+        model->m_vertices.assign(view.m_vertices, view.m_vertices + view.m_header->m_vertexCount);
+    }
+    model->m_vertexFormat = (VertexFormat)view.m_header->m_vertexFormat;
+    model->m_aabbMin      = view.m_header->m_aabbMin;
+    model->m_aabbMax      = view.m_header->m_aabbMax;
+    model->m_indices.assign(view.m_indices, view.m_indices + view.m_header->m_indexCount);
+    model->m_materials.assign(view.m_materials, view.m_materials + view.m_header->m_materialCount);
+
+    UnmapMeshCache(&view);
+
+    return true;
+}
+
+internal bool LoadMeshCache(const char * sourcePath, bool checkSource, Model * model)
+{
+    char cachePath[300];
+    GetMeshCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    return LoadMeshCache(sourcePath, OpenResource(cachePath, FILE_ACCESS_SEQUENTIAL), checkSource, model);
+}
+
+internal bool WriteMeshCache(const char * sourcePath, Model & model)
+{
+    char cachePath[300];
+    GetMeshCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    auto file = fopen(cachePath, "wb");
+    if (!file)
+    {
+        SM_WARN("Failed to write mesh cache: %s", cachePath);
+        return false;
+    }
+
+    bool packed = model.m_vertexFormat == VERTEX_FORMAT_PACKED;
+
+    MeshCacheHeader header = {};
+    header.m_version         = MESH_CACHE_VERSION;
+    header.m_sourceTimestamp = GetResourceTimestamp(sourcePath);
+    header.m_sourceSize      = GetResourceSize(sourcePath);
+    header.m_vertexStride    = packed ? sizeof(PackedVertex) : sizeof(Vertex);
+    header.m_vertexCount     = (uint32)(packed ? model.m_packedVertices.size() : model.m_vertices.size());
+    header.m_indexCount      = (uint32)model.m_indices.size();
+    header.m_materialCount   = (uint32)model.m_materials.size();
+    header.m_vertexFormat    = model.m_vertexFormat;
+    header.m_aabbMin         = model.m_aabbMin;
+    header.m_aabbMax         = model.m_aabbMax;
+
+    // NOTE: The magic is written last so a half written cache never validates
+    fwrite(&header, sizeof(header), 1, file);
+    if (packed)
+    {
+        fwrite(model.m_packedVertices.data(), sizeof(PackedVertex), model.m_packedVertices.size(), file);
+    }
+    else
+    {
+        fwrite(model.m_vertices.data(), sizeof(Vertex), model.m_vertices.size(), file);
+    }
+    fwrite(model.m_indices.data(), sizeof(uint32), model.m_indices.size(), file);
+    fwrite(model.m_materials.data(), sizeof(ModelMaterial), model.m_materials.size(), file);
+
+    header.m_magic = MESH_CACHE_MAGIC;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,54 @@
+/* date = October 18th 2026 10:12 am */
+
+#ifndef MESH_CACHE_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+#include "resource_archive.h"
+
+//====================================================
+//      NOTE: Mesh Cache Constexpr
+//====================================================
+
+// NOTE: The cooked mesh lives next to its source, e.g. cyborg.obj -> cyborg.obj.mesh
+constexpr char * MESH_CACHE_EXTENSION = ".mesh";
+constexpr uint32 MESH_CACHE_MAGIC     = 0x4853454D; // 'MESH'
+constexpr uint32 MESH_CACHE_VERSION   = 5; // NOTE: Bump whenever the import or optimization output changes
+
+//====================================================
+//      NOTE: Mesh Cache Structs
+//====================================================
+
+/*
+  NOTE: File layout
+  [MeshCacheHeader][Vertex or PackedVertex * m_vertexCount][uint32 * m_indexCount][ModelMaterial * m_materialCount]
+  Everything is tightly packed, so the vertex and index arrays can be used straight out of the mapping. Packed
+  meshes are cooked packed, the AABB is what dequantizes their positions.
+ */
+struct MeshCacheHeader
+{
+    uint32    m_magic;
+    uint32    m_version;
+    int64     m_sourceTimestamp;
+    int64     m_sourceSize;
+    uint32    m_vertexStride;
+    uint32    m_vertexCount;
+    uint32    m_indexCount;
+    uint32    m_materialCount;
+    uint32    m_vertexFormat; // NOTE: VertexFormat, m_vertexStride matches it
+    glm::vec3 m_aabbMin;
+    glm::vec3 m_aabbMax;
+};
+
+struct MeshCacheView
+{
+    ResourceFile      m_file;
+    MeshCacheHeader * m_header;
+    Vertex          * m_vertices;       // NOTE: nullptr for VERTEX_FORMAT_PACKED
+    PackedVertex    * m_packedVertices; // NOTE: nullptr for VERTEX_FORMAT_FLOAT
+    uint32          * m_indices;
+    ModelMaterial   * m_materials;
+};
+
+#define MESH_CACHE_H
+#endif //MESH_CACHE_H
@@ -0,0 +1,430 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "mesh_optimizer.h"
+
+//====================================================
+//      NOTE: Mesh Optimizer Functions
+//====================================================
+
+// NOTE: Replays the index buffer through a FIFO cache of VERTEX_CACHE_SIZE entries
+internal VertexCacheStats AnalyzeVertexCache(const std::vector<uint32> & indices, uint32 vertexCount)
+{
+    VertexCacheStats stats = {};
+    stats.m_triangleCount = (uint32)(indices.size() / 3);
+
+    // NOTE: A vertex is in the cache if it was pushed less than VERTEX_CACHE_SIZE misses ago
+    std::vector<uint32> pushedAt(vertexCount, 0);
+    std::vector<bool> referenced(vertexCount, false);
+    uint32 time = VERTEX_CACHE_SIZE + 1;
+
+    for (uint32 index : indices)
+    {
+        if (!referenced[index])
+        {
+            referenced[index] = true;
+            stats.m_vertexCount++;
+        }
+
+        if (time - pushedAt[index] > VERTEX_CACHE_SIZE)
+        {
+            pushedAt[index] = time++;
+            stats.m_cacheMisses++;
+        }
+    }
+
+    stats.m_acmr = stats.m_triangleCount ? (real32)stats.m_cacheMisses / stats.m_triangleCount : 0.0f;
+    stats.m_atvr = stats.m_vertexCount ? (real32)stats.m_cacheMisses / stats.m_vertexCount : 0.0f;
+
+    return stats;
+}
+
+/*
+  NOTE: Tipsify, from Sander, Nehab and Barczak, "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw".
+        Fans around one vertex at a time and picks the next fanning vertex among the ones just emitted, preferring
+        those that will still be in the cache after their remaining triangles are emitted.
+        Every time it has to jump to a vertex outside the cache a new cluster starts, the start triangle of each
+        cluster is written to clusters so OptimizeOverdraw can move them around without hurting the cache much.
+ */
+internal void OptimizeVertexCache(std::vector<uint32> & indices, uint32 vertexCount, std::vector<uint32> * clusters)
+{
+    uint32 triangleCount = (uint32)(indices.size() / 3);
+    if (triangleCount == 0)
+    {
+        return;
+    }
+
+    // NOTE: Vertex -> triangle adjacency, packed into one array
+    std::vector<uint32> liveCount(vertexCount, 0);
+    for (uint32 index : indices)
+    {
+        liveCount[index]++;
+    }
+
+    std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+    for (uint32 v = 0; v < vertexCount; v++)
+    {
+        adjacencyOffset[v + 1] = adjacencyOffset[v] + liveCount[v];
+    }
+
+    std::vector<uint32> adjacency(indices.size());
+    {
+        std::vector<uint32> fill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+        for (uint32 i = 0; i < (uint32)indices.size(); i++)
+        {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<uint32> cacheTime(vertexCount, 0);
+    std::vector<bool> emitted(triangleCount, false);
+    std::vector<uint32> deadEnd;
+    std::vector<uint32> candidates;
+
+    std::vector<uint32> result;
+    result.reserve(indices.size());
+
+    uint32 time = VERTEX_CACHE_SIZE + 1;
+    uint32 cursor = 0;
+    int64 fanning = -1;
+
+    if (clusters)
+    {
+        clusters->clear();
+    }
+
+    for (;;)
+    {
+        if (fanning < 0)
+        {
+            // NOTE: Dead end, fall back to the most recently emitted vertex with triangles left, then to input order
+            while (!deadEnd.empty() && fanning < 0)
+            {
+                uint32 v = deadEnd.back();
+                deadEnd.pop_back();
+                if (liveCount[v] > 0)
+                {
+                    fanning = v;
+                }
+            }
+
+            while (cursor < vertexCount && fanning < 0)
+            {
+                if (liveCount[cursor] > 0)
+                {
+                    fanning = cursor;
+                }
+                cursor++;
+            }
+
+            if (fanning < 0)
+            {
+                break;
+            }
+
+            if (clusters)
+            {
+                clusters->push_back((uint32)(result.size() / 3));
+            }
+        }
+
+        candidates.clear();
+        for (uint32 a = adjacencyOffset[fanning]; a < adjacencyOffset[fanning + 1]; a++)
+        {
+            uint32 triangle = adjacency[a];
+            if (emitted[triangle])
+            {
+                continue;
+            }
+            emitted[triangle] = true;
+
+            for (uint32 c = 0; c < 3; c++)
+            {
+                uint32 v = indices[triangle * 3 + c];
+                result.push_back(v);
+                deadEnd.push_back(v);
+                candidates.push_back(v);
+                liveCount[v]--;
+
+                if (time - cacheTime[v] > VERTEX_CACHE_SIZE)
+                {
+                    cacheTime[v] = time++;
+                }
+            }
+        }
+
+        // NOTE: Prefer the oldest candidate that stays cached for all of its remaining triangles
+        int64 best = -1;
+        int64 bestPriority = -1;
+        for (uint32 v : candidates)
+        {
+            if (liveCount[v] == 0)
+            {
+                continue;
+            }
+
+            int64 priority = 0;
+            if (time - cacheTime[v] + 2 * liveCount[v] <= VERTEX_CACHE_SIZE)
+            {
+                priority = time - cacheTime[v];
+            }
+
+            if (priority > bestPriority)
+            {
+                best = v;
+                bestPriority = priority;
+            }
+        }
+
+        fanning = best;
+    }
+
+    indices.swap(result);
+}
+
+/*
+  NOTE: Sorts the Tipsify clusters so the ones facing away from the mesh centroid come first. Those are the
+        most likely occluders for a roughly convex mesh, so they fill the depth buffer early and later
+        clusters get rejected. The order inside a cluster is kept, so the cache behaviour barely changes.
+ */
+internal void OptimizeOverdraw(std::vector<uint32> & indices, const std::vector<Vertex> & vertices,
+                               const std::vector<uint32> & clusters)
+{
+    uint32 triangleCount = (uint32)(indices.size() / 3);
+    uint32 clusterCount = (uint32)clusters.size();
+    if (clusterCount < 2)
+    {
+        return;
+    }
+
+    glm::vec3 meshCentroid = glm::vec3(0.0f);
+    real32 meshArea = 0.0f;
+
+    std::vector<glm::vec3> clusterCentroid(clusterCount, glm::vec3(0.0f));
+    std::vector<glm::vec3> clusterNormal(clusterCount, glm::vec3(0.0f));
+    std::vector<real32> clusterArea(clusterCount, 0.0f);
+
+    for (uint32 c = 0; c < clusterCount; c++)
+    {
+        uint32 end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+        for (uint32 t = clusters[c]; t < end; t++)
+        {
+            const glm::vec3 & p0 = vertices[indices[t * 3 + 0]].m_pos;
+            const glm::vec3 & p1 = vertices[indices[t * 3 + 1]].m_pos;
+            const glm::vec3 & p2 = vertices[indices[t * 3 + 2]].m_pos;
+
+            // NOTE: The cross product is twice the area weighted normal
+            glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+            real32 area = glm::length(normal);
+            glm::vec3 centroid = (p0 + p1 + p2) * (area / 3.0f);
+
+            clusterNormal[c] += normal;
+            clusterCentroid[c] += centroid;
+            clusterArea[c] += area;
+
+            meshCentroid += centroid;
+            meshArea += area;
+        }
+    }
+
+    if (meshArea > 0.0f)
+    {
+        meshCentroid /= meshArea;
+    }
+
+    std::vector<real32> sortKey(clusterCount);
+    std::vector<uint32> order(clusterCount);
+    for (uint32 c = 0; c < clusterCount; c++)
+    {
+        glm::vec3 centroid = clusterArea[c] > 0.0f ? clusterCentroid[c] / clusterArea[c] : meshCentroid;
+        sortKey[c] = glm::dot(centroid - meshCentroid, clusterNormal[c]);
+        order[c] = c;
+    }
+
+    std::stable_sort(order.begin(), order.end(), [&sortKey](uint32 a, uint32 b)
+                     {
+                         return sortKey[a] > sortKey[b];
+                     });
+
+    std::vector<uint32> result;
+    result.reserve(indices.size());
+    for (uint32 c : order)
+    {
+        uint32 end = c + 1 < clusterCount ? clusters[c + 1] : triangleCount;
+        result.insert(result.end(), indices.begin() + clusters[c] * 3, indices.begin() + end * 3);
+    }
+
+    indices.swap(result);
+}
+
+// NOTE: Renumbers vertices in the order the index buffer first touches them, unreferenced vertices are dropped
+internal void OptimizeVertexFetch(Model * model)
+{
+    uint32 vertexCount = (uint32)model->m_vertices.size();
+    std::vector<uint32> remap(vertexCount, UINT32_MAX);
+    std::vector<Vertex> vertices;
+    vertices.reserve(vertexCount);
+
+    for (uint32 & index : model->m_indices)
+    {
+        if (remap[index] == UINT32_MAX)
+        {
+            remap[index] = (uint32)vertices.size();
+            vertices.push_back(model->m_vertices[index]);
+        }
+        index = remap[index];
+    }
+
+    model->m_vertices.swap(vertices);
+}
+
+internal MeshOptimizeStats OptimizeModel(Model * model, bool optimizeOverdraw)
+{
+    MeshOptimizeStats stats = {};
+    stats.m_before = AnalyzeVertexCache(model->m_indices, (uint32)model->m_vertices.size());
+
+    // NOTE: Triangles never move across material ranges, each range is reordered on its own
+    if (model->m_materials.empty())
+    {
+        std::vector<uint32> clusters;
+        OptimizeVertexCache(model->m_indices, (uint32)model->m_vertices.size(), &clusters);
+
+        if (optimizeOverdraw)
+        {
+            OptimizeOverdraw(model->m_indices, model->m_vertices, clusters);
+        }
+    }
+
+    for (const ModelMaterial & material : model->m_materials)
+    {
+        auto first = model->m_indices.begin() + material.m_firstIndex;
+        std::vector<uint32> indices(first, first + material.m_indexCount);
+
+        std::vector<uint32> clusters;
+        OptimizeVertexCache(indices, (uint32)model->m_vertices.size(), &clusters);
+
+        if (optimizeOverdraw)
+        {
+            OptimizeOverdraw(indices, model->m_vertices, clusters);
+        }
+
+        std::copy(indices.begin(), indices.end(), first);
+    }
+
+    OptimizeVertexFetch(model);
+
+    stats.m_after = AnalyzeVertexCache(model->m_indices, (uint32)model->m_vertices.size());
+    return stats;
+}
+
+//====================================================
+//      NOTE: Vertex Packing
+//====================================================
+
+// NOTE: Folds the unit sphere onto the [-1, 1] square, the lower hemisphere is mirrored into the corners
+internal glm::vec2 OctahedralEncode(glm::vec3 n)
+{
+    n /= (glm::abs(n.x) + glm::abs(n.y) + glm::abs(n.z));
+
+    glm::vec2 e = glm::vec2(n.x, n.y);
+    if (n.z < 0.0f)
+    {
+        e.x = (1.0f - glm::abs(n.y)) * (n.x >= 0.0f ? 1.0f : -1.0f);
+        e.y = (1.0f - glm::abs(n.x)) * (n.y >= 0.0f ? 1.0f : -1.0f);
+    }
+
+    return e;
+}
+
+internal int8 PackSnorm8(real32 value)
+{
+    return (int8)glm::round(glm::clamp(value, -1.0f, 1.0f) * 127.0f);
+}
+
+internal uint16 PackUnorm16(real32 value)
+{
+    return (uint16)glm::round(glm::clamp(value, 0.0f, 1.0f) * 65535.0f);
+}
+
+/*
+  NOTE: Converts the model to VERTEX_FORMAT_PACKED. The OBJ normals are not imported, so smooth normals are
+        rebuilt from the area weighted face normals. Returns false and leaves the model alone if the vertex
+        color is not the constant white the packed format drops.
+ */
+internal bool PackModelVertices(Model * model)
+{
+    if (model->m_vertexFormat == VERTEX_FORMAT_PACKED || model->m_vertices.empty())
+    {
+        return false;
+    }
+
+    glm::vec3 white = glm::vec3(1.0f);
+    glm::vec3 aabbMin = model->m_vertices[0].m_pos;
+    glm::vec3 aabbMax = model->m_vertices[0].m_pos;
+    for (const Vertex & vertex : model->m_vertices)
+    {
+        if (vertex.m_color != white)
+        {
+            return false;
+        }
+
+        aabbMin = glm::min(aabbMin, vertex.m_pos);
+        aabbMax = glm::max(aabbMax, vertex.m_pos);
+    }
+
+    std::vector<glm::vec3> normals(model->m_vertices.size(), glm::vec3(0.0f));
+    for (size_t i = 0; i + 2 < model->m_indices.size(); i += 3)
+    {
+        uint32 i0 = model->m_indices[i + 0];
+        uint32 i1 = model->m_indices[i + 1];
+        uint32 i2 = model->m_indices[i + 2];
+
+        const glm::vec3 & p0 = model->m_vertices[i0].m_pos;
+        const glm::vec3 & p1 = model->m_vertices[i1].m_pos;
+        const glm::vec3 & p2 = model->m_vertices[i2].m_pos;
+
+        glm::vec3 faceNormal = glm::cross(p1 - p0, p2 - p0);
+        normals[i0] += faceNormal;
+        normals[i1] += faceNormal;
+        normals[i2] += faceNormal;
+    }
+
+    glm::vec3 extent = aabbMax - aabbMin;
+    glm::vec3 invExtent = glm::vec3(extent.x > 0.0f ? 1.0f / extent.x : 0.0f,
+                                    extent.y > 0.0f ? 1.0f / extent.y : 0.0f,
+                                    extent.z > 0.0f ? 1.0f / extent.z : 0.0f);
+
+    model->m_packedVertices.resize(model->m_vertices.size());
+    for (size_t v = 0; v < model->m_vertices.size(); v++)
+    {
+        const Vertex & vertex = model->m_vertices[v];
+        PackedVertex & packed = model->m_packedVertices[v];
+
+        glm::vec3 unit = (vertex.m_pos - aabbMin) * invExtent;
+        packed.m_pos[0] = PackUnorm16(unit.x);
+        packed.m_pos[1] = PackUnorm16(unit.y);
+        packed.m_pos[2] = PackUnorm16(unit.z);
+
+        glm::vec3 normal = normals[v];
+        real32 length = glm::length(normal);
+        glm::vec2 octahedral = length > 0.0f ? OctahedralEncode(normal / length) : glm::vec2(0.0f);
+        packed.m_normal[0] = PackSnorm8(octahedral.x);
+        packed.m_normal[1] = PackSnorm8(octahedral.y);
+
+        uint32 texCoord = glm::packHalf2x16(vertex.m_texCoord);
+        packed.m_texCoord[0] = (uint16)(texCoord & 0xFFFF);
+        packed.m_texCoord[1] = (uint16)(texCoord >> 16);
+    }
+
+    model->m_vertexFormat = VERTEX_FORMAT_PACKED;
+    model->m_aabbMin = aabbMin;
+    model->m_aabbMax = aabbMax;
+    model->m_vertices = {};
+
+    return true;
+}
@@ -0,0 +1,42 @@
+/* date = October 18th 2026 2:40 pm */
+
+#ifndef MESH_OPTIMIZER_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+
+#include <algorithm>
+#include <glm/gtc/packing.hpp>
+
+//====================================================
+//      NOTE: Mesh Optimizer Constexpr
+//====================================================
+
+// NOTE: Size of the simulated FIFO post-transform cache, both for Tipsify and for the stats
+constexpr uint32 VERTEX_CACHE_SIZE = 16;
+
+//====================================================
+//      NOTE: Mesh Optimizer Structs
+//====================================================
+
+/*
+  NOTE: ACMR = cache misses per triangle, 0.5 is the best case for a regular grid and 3 the worst.
+        ATVR = cache misses per referenced vertex, 1.0 is optimal.
+ */
+struct VertexCacheStats
+{
+    uint32 m_triangleCount;
+    uint32 m_vertexCount;
+    uint32 m_cacheMisses;
+    real32 m_acmr;
+    real32 m_atvr;
+};
+
+struct MeshOptimizeStats
+{
+    VertexCacheStats m_before;
+    VertexCacheStats m_after;
+};
+
+#define MESH_OPTIMIZER_H
+#endif //MESH_OPTIMIZER_H
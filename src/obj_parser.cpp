@@ -0,0 +1,1056 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "obj_parser.h"
+
+// NOTE: This parser only handles the subset of OBJ the engine actually reads (v, vt, faces of
+//       3 or 4 corners and their materials) and must produce exactly the vertices, indices and
+//       material ranges of the tinyobj path in ImportObjModel. It reuses the tinyobj number parsers so every float is bit identical.
+//       Anything else makes it bail out so the caller can fall back to tinyobj.
+
+//====================================================
+//      NOTE: OBJ Parser Functions
+//====================================================
+
+// NOTE: End of the chunk starting at begin, roughly OBJ_CHUNK_SIZE bytes later
+internal const char * FindObjChunkEnd(const char * begin, const char * end)
+{
+    if ((size_t)(end - begin) <= OBJ_CHUNK_SIZE)
+    {
+        return end;
+    }
+
+    // NOTE: Always cut right after a '\n' so a "\r\n" pair never straddles two chunks
+    const char * split = begin + OBJ_CHUNK_SIZE;
+    while (split < end && *split != '\n')
+    {
+        split++;
+    }
+    if (split < end)
+    {
+        split++;
+    }
+    return split;
+}
+
+internal void SplitObjChunks(const char * data, size_t size, std::vector<ObjChunk> & chunks)
+{
+    const char * end = data + size;
+    const char * begin = data;
+
+    while (begin < end)
+    {
+        const char * split = FindObjChunkEnd(begin, end);
+
+        ObjChunk chunk = {};
+        chunk.m_begin = begin;
+        chunk.m_end = split;
+        chunk.m_isFirst = chunks.empty();
+        chunk.m_supported = true;
+        chunks.push_back(std::move(chunk));
+
+        begin = split;
+    }
+}
+
+// NOTE: Stores a face index zero based. Negative indices are relative to the attribute count
+//       at this line, which is only known relative to the chunk until all chunks are parsed
+internal bool FixObjChunkIndex(int32 index, uint32 localCount, bool allowZero, int32 * result, bool * relative)
+{
+    *relative = false;
+    if (index > 0)
+    {
+        *result = index - 1;
+        return true;
+    }
+
+    if (index == 0)
+    {
+        *result = -1;
+        return allowZero;
+    }
+
+    *result = (int32)localCount + index;
+    *relative = true;
+    return true;
+}
+
+internal void TokenizeObjChunk(ObjChunk * chunk)
+{
+    std::string linebuf;
+
+    const char * cursor = chunk->m_begin;
+    bool firstLine = chunk->m_isFirst;
+    int32 materialEvent = -1;
+    while (cursor < chunk->m_end && chunk->m_supported)
+    {
+        const char * lineEnd = cursor;
+        while (lineEnd < chunk->m_end && *lineEnd != '\n' && *lineEnd != '\r')
+        {
+            lineEnd++;
+        }
+
+        linebuf.assign(cursor, lineEnd);
+
+        cursor = lineEnd;
+        if (cursor < chunk->m_end)
+        {
+            if (*cursor == '\r' && cursor + 1 < chunk->m_end && cursor[1] == '\n')
+            {
+                cursor++;
+            }
+            cursor++;
+        }
+
+        bool isFirstLine = firstLine;
+        firstLine = false;
+
+        if (linebuf.empty())
+        {
+            continue;
+        }
+
+        if (isFirstLine && linebuf.size() >= 3 &&
+            (uint8)linebuf[0] == 0xEF && (uint8)linebuf[1] == 0xBB && (uint8)linebuf[2] == 0xBF)
+        {
+            linebuf.erase(0, 3);
+        }
+
+        const char * token = linebuf.c_str();
+        token += strspn(token, " \t");
+
+        if (token[0] == '\0' || token[0] == '#')
+        {
+            continue;
+        }
+
+        if (token[0] == 'v' && IS_SPACE((token[1])))
+        {
+            token += 2;
+            real32 x, y, z;
+            tinyobj::parseReal3(&x, &y, &z, &token);
+            chunk->m_positions.push_back(x);
+            chunk->m_positions.push_back(y);
+            chunk->m_positions.push_back(z);
+            continue;
+        }
+
+        if (token[0] == 'v' && token[1] == 't' && IS_SPACE((token[2])))
+        {
+            token += 3;
+            real32 x, y;
+            tinyobj::parseReal2(&x, &y, &token);
+            chunk->m_texcoords.push_back(x);
+            chunk->m_texcoords.push_back(y);
+            continue;
+        }
+
+        if (token[0] == 'v' && token[1] == 'n' && IS_SPACE((token[2])))
+        {
+            continue;
+        }
+
+        // NOTE: Lines, points and skin weights can fail the whole tinyobj load, leave them to it. They never
+        //       make triangles, so streaming skips them
+        if ((token[0] == 'l' && IS_SPACE((token[1]))) ||
+            (token[0] == 'p' && IS_SPACE((token[1]))) ||
+            (token[0] == 'v' && token[1] == 'w' && IS_SPACE((token[2]))))
+        {
+            chunk->m_supported = chunk->m_streaming;
+            continue;
+        }
+
+        if (token[0] == 'f' && IS_SPACE((token[1])))
+        {
+            token += 2;
+            token += strspn(token, " \t");
+
+            uint32 faceSize = 0;
+            while (!IS_NEW_LINE(token[0]) && token[0] != '#')
+            {
+                tinyobj::vertex_index_t raw = tinyobj::parseRawTriple(&token);
+
+                ObjCorner corner = {};
+                bool relative = false;
+                if (!FixObjChunkIndex(raw.v_idx, (uint32)(chunk->m_positions.size() / 3), false, &corner.m_position, &relative))
+                {
+                    chunk->m_supported = false;
+                    break;
+                }
+                corner.m_relativeFlags |= relative ? OBJ_RELATIVE_POSITION : 0;
+
+                if (!FixObjChunkIndex(raw.vt_idx, (uint32)(chunk->m_texcoords.size() / 2), true, &corner.m_texcoord, &relative))
+                {
+                    chunk->m_supported = false;
+                    break;
+                }
+                corner.m_relativeFlags |= relative ? OBJ_RELATIVE_TEXCOORD : 0;
+
+                // NOTE: Normals are not read, but a relative normal index can still fail the tinyobj load
+                if (raw.vn_idx < 0 && !chunk->m_streaming)
+                {
+                    chunk->m_supported = false;
+                    break;
+                }
+
+                chunk->m_corners.push_back(corner);
+                faceSize++;
+
+                token += strspn(token, " \t\r");
+            }
+
+            if (faceSize > 4 && !chunk->m_streaming)
+            {
+                // NOTE: Polygons go through tinyobj's ear clipping
+                chunk->m_supported = false;
+            }
+
+            ObjFace face = {};
+            face.m_cornerCount = faceSize;
+            face.m_positionCount = (uint32)(chunk->m_positions.size() / 3);
+            face.m_materialEvent = materialEvent;
+            chunk->m_faces.push_back(face);
+            continue;
+        }
+
+        // NOTE: Same prefix match as tinyobj, which does not require a space after usemtl
+        if (strncmp(token, "usemtl", 6) == 0)
+        {
+            token += 6;
+            ObjMaterialEvent event = {};
+            event.m_name = tinyobj::parseString(&token);
+            chunk->m_materialEvents.push_back(event);
+            materialEvent = (int32)chunk->m_materialEvents.size() - 1;
+            continue;
+        }
+
+        if (strncmp(token, "mtllib", 6) == 0 && IS_SPACE((token[6])))
+        {
+            ObjMaterialEvent event = {};
+            event.m_isLibrary = true;
+            event.m_name = token + 7;
+            chunk->m_materialEvents.push_back(event);
+            continue;
+        }
+
+        // NOTE: Groups, objects and smoothing groups do not change the face order
+    }
+}
+
+internal bool ResolveObjCorner(ObjCorner & corner, ObjChunk * chunk)
+{
+    if (corner.m_relativeFlags & OBJ_RELATIVE_POSITION)
+    {
+        corner.m_position += (int32)chunk->m_positionBase;
+        if (corner.m_position < 0)
+        {
+            return false;
+        }
+    }
+    if (corner.m_relativeFlags & OBJ_RELATIVE_TEXCOORD)
+    {
+        corner.m_texcoord += (int32)chunk->m_texcoordBase;
+        if (corner.m_texcoord < 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// NOTE: Built exactly like ImportObjModel so deduplication sees the same bits
+internal Vertex MakeObjVertex(const std::vector<real32> & positions, const std::vector<real32> & texcoords, const ObjCorner & corner)
+{
+    Vertex vertex = {};
+
+    vertex.m_pos.x = positions[3 * size_t(corner.m_position) + 0];
+    vertex.m_pos.y = positions[3 * size_t(corner.m_position) + 1];
+    vertex.m_pos.z = positions[3 * size_t(corner.m_position) + 2];
+
+    if (corner.m_texcoord >= 0)
+    {
+        vertex.m_texCoord.x = texcoords[2 * size_t(corner.m_texcoord) + 0];
+        vertex.m_texCoord.y = 1.0f - texcoords[2 * size_t(corner.m_texcoord) + 1];
+    }
+
+    vertex.m_color = { 1.0f, 1.0f, 1.0f };
+
+    return vertex;
+}
+
+internal void AddObjChunkVertex(ObjChunk * chunk, HashTable<Vertex, uint32> & uniqueVertices,
+                                const std::vector<real32> & positions, const std::vector<real32> & texcoords,
+                                const ObjCorner & corner)
+{
+    Vertex vertex = MakeObjVertex(positions, texcoords, corner);
+
+    uint32 index = uniqueVertices.FindOrAdd(vertex, (uint32)chunk->m_vertices.size());
+    if (index == chunk->m_vertices.size())
+    {
+        chunk->m_vertices.push_back(vertex);
+    }
+
+    chunk->m_indices.push_back(index);
+}
+
+// NOTE: Resolves and range checks the faces of a tokenized chunk and hands addTriangle every triangle in file order
+//       as (corner, corner, corner, material). positions and texcoords are everything parsed so far
+template <typename AddTriangle>
+internal void TriangulateObjChunk(ObjChunk * chunk, const std::vector<real32> & positions, const std::vector<real32> & texcoords,
+                                  AddTriangle addTriangle)
+{
+    size_t positionCount = positions.size() / 3;
+    size_t texcoordCount = texcoords.size() / 2;
+
+    size_t cornerOffset = 0;
+    for (size_t f = 0; f < chunk->m_faces.size() && chunk->m_supported; f++)
+    {
+        const ObjFace & face = chunk->m_faces[f];
+        uint32 faceSize = face.m_cornerCount;
+        ObjCorner * corners = chunk->m_corners.data() + cornerOffset;
+        cornerOffset += faceSize;
+
+        if (faceSize < 3)
+        {
+            continue;
+        }
+
+        // NOTE: tinyobj drops quads whose positions are not parsed yet when the group gets flushed,
+        //       which depends on g, o and usemtl lines. Forward references are left to it
+        size_t seenPositionCount = chunk->m_positionBase + face.m_positionCount;
+
+        bool inRange = true;
+        for (uint32 c = 0; c < faceSize; c++)
+        {
+            if (!ResolveObjCorner(corners[c], chunk))
+            {
+                // NOTE: Invalid relative index, tinyobj rejects the whole file
+                chunk->m_supported = false;
+                break;
+            }
+
+            size_t positionLimit = faceSize == 4 && !chunk->m_streaming ? seenPositionCount : positionCount;
+            inRange &= (size_t)corners[c].m_position < positionLimit;
+            inRange &= corners[c].m_texcoord < 0 || (size_t)corners[c].m_texcoord < texcoordCount;
+        }
+
+        if (!chunk->m_supported)
+        {
+            break;
+        }
+
+        if (!inRange)
+        {
+            chunk->m_supported = false;
+            break;
+        }
+
+        int32 material = face.m_materialEvent < 0 ? chunk->m_startMaterial : chunk->m_eventMaterials[face.m_materialEvent];
+
+        if (faceSize == 3)
+        {
+            addTriangle(corners[0], corners[1], corners[2], material);
+            continue;
+        }
+
+        // NOTE: Only streaming chunks get here, it has no tinyobj to hand polygons to. A fan is exact for the convex
+        //       polygons exporters write
+        if (faceSize > 4)
+        {
+            for (uint32 c = 1; c + 1 < faceSize; c++)
+            {
+                addTriangle(corners[0], corners[c], corners[c + 1], material);
+            }
+            continue;
+        }
+
+        // NOTE: Same shortest diagonal split as tinyobj, in the same float evaluation order
+        const real32 * v0 = &positions[3 * size_t(corners[0].m_position)];
+        const real32 * v1 = &positions[3 * size_t(corners[1].m_position)];
+        const real32 * v2 = &positions[3 * size_t(corners[2].m_position)];
+        const real32 * v3 = &positions[3 * size_t(corners[3].m_position)];
+
+        real32 e02x = v2[0] - v0[0];
+        real32 e02y = v2[1] - v0[1];
+        real32 e02z = v2[2] - v0[2];
+        real32 e13x = v3[0] - v1[0];
+        real32 e13y = v3[1] - v1[1];
+        real32 e13z = v3[2] - v1[2];
+
+        real32 sqr02 = e02x * e02x + e02y * e02y + e02z * e02z;
+        real32 sqr13 = e13x * e13x + e13y * e13y + e13z * e13z;
+
+        if (sqr02 < sqr13)
+        {
+            addTriangle(corners[0], corners[1], corners[2], material);
+            addTriangle(corners[0], corners[2], corners[3], material);
+        }
+        else
+        {
+            addTriangle(corners[0], corners[1], corners[3], material);
+            addTriangle(corners[1], corners[2], corners[3], material);
+        }
+    }
+}
+
+internal void BuildObjChunk(ObjChunk * chunk, const std::vector<real32> & positions, const std::vector<real32> & texcoords)
+{
+    chunk->m_triangleMaterials.reserve(chunk->m_faces.size() * 2);
+
+    HashTable<Vertex, uint32> uniqueVertices = {};
+    uniqueVertices.Init((uint32)chunk->m_corners.size());
+
+    TriangulateObjChunk(chunk, positions, texcoords,
+                        [chunk, &uniqueVertices, &positions, &texcoords](const ObjCorner & a, const ObjCorner & b, const ObjCorner & c, int32 material)
+                        {
+                            AddObjChunkVertex(chunk, uniqueVertices, positions, texcoords, a);
+                            AddObjChunkVertex(chunk, uniqueVertices, positions, texcoords, b);
+                            AddObjChunkVertex(chunk, uniqueVertices, positions, texcoords, c);
+                            chunk->m_triangleMaterials.push_back(material);
+                        });
+}
+
+//====================================================
+//      NOTE: OBJ Materials
+//====================================================
+
+// NOTE: Directory of the .obj including the trailing slash, .mtl files and textures are relative to it
+internal std::string GetObjBaseDirectory(const char * objFileName)
+{
+    char normalized[300];
+    NormalizeResourcePath(objFileName, normalized, ArrayCount(normalized));
+
+    const char * slash = strrchr(normalized, '/');
+    return slash ? std::string(normalized, (size_t)(slash + 1 - normalized)) : std::string();
+}
+
+// NOTE: tinyobj only opens .mtl files from disk by itself, this goes through the resource API instead so
+//       archived models find their materials too
+class ObjMaterialReader : public tinyobj::MaterialReader
+{
+public:
+    explicit ObjMaterialReader(const std::string & baseDirectory) : m_baseDirectory(baseDirectory) {}
+
+    bool operator()(const std::string & materialId, std::vector<tinyobj::material_t> * materials,
+                    std::map<std::string, int> * materialMap, std::string * warn, std::string * err) override
+    {
+        std::string path = m_baseDirectory + materialId;
+
+        ResourceFile file = OpenResource(path.c_str(), FILE_ACCESS_SEQUENTIAL);
+        if (!file.m_data)
+        {
+            if (warn)
+            {
+                (*warn) += "Material file [ " + path + " ] not found.\n";
+            }
+            return false;
+        }
+
+        std::istringstream stream(std::string(file.m_data, file.m_size));
+        CloseResource(&file);
+
+        tinyobj::LoadMtl(materialMap, materials, &stream, warn, err);
+        return true;
+    }
+
+private:
+    std::string m_baseDirectory;
+};
+
+// NOTE: Same as the mtllib handling of tinyobj, the first file of the line that loads wins
+internal void LoadObjMaterialLibrary(const std::string & line, ObjMaterialReader & reader, std::set<std::string> & loadedFiles,
+                                     std::vector<tinyobj::material_t> & materials, std::map<std::string, int> & materialMap)
+{
+    std::vector<std::string> filenames;
+    tinyobj::SplitString(line, ' ', '\\', filenames);
+
+    for (const std::string & filename : filenames)
+    {
+        if (loadedFiles.count(filename) > 0)
+        {
+            continue;
+        }
+
+        std::string warn;
+        std::string err;
+        if (reader(filename, &materials, &materialMap, &warn, &err))
+        {
+            loadedFiles.insert(filename);
+            break;
+        }
+    }
+}
+
+// NOTE: Stable sorts the triangles by material so every material is one contiguous index range, faces without a
+//       material first. Models that end up with a single range keep none and draw with the transform texture
+internal void GroupModelMaterials(const char * objFileName, const std::vector<tinyobj::material_t> & materials,
+                                  const std::vector<int32> & triangleMaterials, Model * model)
+{
+    uint32 triangleCount = (uint32)(model->m_indices.size() / 3);
+    SM_ASSERT(triangleMaterials.size() == triangleCount, "%s has %zu triangle materials for %u triangles!",
+              objFileName, triangleMaterials.size(), triangleCount);
+
+    // NOTE: Group 0 collects the faces without a material (-1)
+    uint32 groupCount = (uint32)materials.size() + 1;
+    std::vector<uint32> groupStart(groupCount + 1, 0);
+    for (int32 material : triangleMaterials)
+    {
+        groupStart[material + 2]++;
+    }
+
+    uint32 usedGroups = 0;
+    for (uint32 group = 0; group < groupCount; group++)
+    {
+        usedGroups += groupStart[group + 1] > 0 ? 1 : 0;
+        groupStart[group + 1] += groupStart[group];
+    }
+
+    if (usedGroups < 2)
+    {
+        return;
+    }
+
+    std::vector<uint32> cursor(groupStart.begin(), groupStart.end() - 1);
+    std::vector<uint32> grouped(model->m_indices.size());
+    for (uint32 triangle = 0; triangle < triangleCount; triangle++)
+    {
+        uint32 target = cursor[triangleMaterials[triangle] + 1]++;
+        memcpy(&grouped[3 * (size_t)target], &model->m_indices[3 * (size_t)triangle], 3 * sizeof(uint32));
+    }
+    model->m_indices = std::move(grouped);
+
+    std::string baseDirectory = GetObjBaseDirectory(objFileName);
+    for (uint32 group = 0; group < groupCount; group++)
+    {
+        uint32 count = groupStart[group + 1] - groupStart[group];
+        if (count == 0)
+        {
+            continue;
+        }
+
+        ModelMaterial range = {};
+        range.m_firstIndex = 3 * groupStart[group];
+        range.m_indexCount = 3 * count;
+
+        // NOTE: Only the diffuse map is sampled, missing textures fall back to the transform texture
+        if (group > 0 && !materials[group - 1].diffuse_texname.empty())
+        {
+            std::string texturePath = baseDirectory + materials[group - 1].diffuse_texname;
+            NormalizeResourcePath(texturePath.c_str(), range.m_diffusePath, ArrayCount(range.m_diffusePath));
+            if (!ResourceExists(range.m_diffusePath))
+            {
+                SM_WARN("%s: diffuse texture %s not found", objFileName, range.m_diffusePath);
+                range.m_diffusePath[0] = 0;
+            }
+        }
+
+        model->m_materials.push_back(range);
+    }
+}
+
+// NOTE: Parses and deduplicates the file in line aligned chunks on the work queue. Returns false
+//       if the file uses anything this path does not replicate exactly; use ImportObjModel then
+internal bool ImportObjModelParallel(const char * objFileName, WorkQueue * workQueue, Model * model)
+{
+    ResourceFile file = OpenResource(objFileName, FILE_ACCESS_SEQUENTIAL);
+    if (!file.m_data)
+    {
+        return false;
+    }
+
+    std::vector<ObjChunk> chunks;
+    SplitObjChunks(file.m_data, file.m_size, chunks);
+
+    ParallelFor(workQueue, (uint32)chunks.size(), [&chunks](uint32 i)
+                {
+                    TokenizeObjChunk(&chunks[i]);
+                });
+
+    CloseResource(&file);
+
+    // NOTE: Every chunk needs to know how many attributes came before it
+    std::vector<real32> positions;
+    std::vector<real32> texcoords;
+    for (ObjChunk & chunk : chunks)
+    {
+        if (!chunk.m_supported)
+        {
+            return false;
+        }
+
+        chunk.m_positionBase = (uint32)(positions.size() / 3);
+        chunk.m_texcoordBase = (uint32)(texcoords.size() / 2);
+        positions.insert(positions.end(), chunk.m_positions.begin(), chunk.m_positions.end());
+        texcoords.insert(texcoords.end(), chunk.m_texcoords.begin(), chunk.m_texcoords.end());
+
+        chunk.m_positions = {};
+        chunk.m_texcoords = {};
+    }
+
+    // NOTE: Materials are replayed in file order, a usemtl only sees the .mtl files loaded before it
+    ObjMaterialReader materialReader(GetObjBaseDirectory(objFileName));
+    std::set<std::string> materialFiles;
+    std::vector<tinyobj::material_t> materials;
+    std::map<std::string, int> materialMap;
+
+    int32 material = -1;
+    for (ObjChunk & chunk : chunks)
+    {
+        chunk.m_startMaterial = material;
+        chunk.m_eventMaterials.assign(chunk.m_materialEvents.size(), -1);
+
+        for (size_t e = 0; e < chunk.m_materialEvents.size(); e++)
+        {
+            const ObjMaterialEvent & event = chunk.m_materialEvents[e];
+            if (event.m_isLibrary)
+            {
+                LoadObjMaterialLibrary(event.m_name, materialReader, materialFiles, materials, materialMap);
+                continue;
+            }
+
+            auto it = materialMap.find(event.m_name);
+            material = it != materialMap.end() ? it->second : -1;
+            chunk.m_eventMaterials[e] = material;
+        }
+    }
+
+    ParallelFor(workQueue, (uint32)chunks.size(), [&chunks, &positions, &texcoords](uint32 i)
+                {
+                    BuildObjChunk(&chunks[i], positions, texcoords);
+                });
+
+    for (ObjChunk & chunk : chunks)
+    {
+        if (!chunk.m_supported)
+        {
+            return false;
+        }
+    }
+
+    // NOTE: Merging in chunk order keeps the first occurrence order of the serial path
+    uint32 chunkVertexCount = 0;
+    for (ObjChunk & chunk : chunks)
+    {
+        chunkVertexCount += (uint32)chunk.m_vertices.size();
+    }
+
+    HashTable<Vertex, uint32> uniqueVertices = {};
+    uniqueVertices.Init(chunkVertexCount);
+
+    uint32 indexCount = 0;
+    std::vector<int32> triangleMaterials;
+    for (ObjChunk & chunk : chunks)
+    {
+        triangleMaterials.insert(triangleMaterials.end(), chunk.m_triangleMaterials.begin(), chunk.m_triangleMaterials.end());
+
+        chunk.m_remap.resize(chunk.m_vertices.size());
+        for (size_t v = 0; v < chunk.m_vertices.size(); v++)
+        {
+            const Vertex & vertex = chunk.m_vertices[v];
+            uint32 index = uniqueVertices.FindOrAdd(vertex, (uint32)model->m_vertices.size());
+            if (index == model->m_vertices.size())
+            {
+                model->m_vertices.push_back(vertex);
+            }
+            chunk.m_remap[v] = index;
+        }
+
+        chunk.m_indexOffset = indexCount;
+        indexCount += (uint32)chunk.m_indices.size();
+    }
+
+    model->m_indices.resize(indexCount);
+    ParallelFor(workQueue, (uint32)chunks.size(), [&chunks, model](uint32 i)
+                {
+                    ObjChunk & chunk = chunks[i];
+                    for (size_t index = 0; index < chunk.m_indices.size(); index++)
+                    {
+                        model->m_indices[chunk.m_indexOffset + index] = chunk.m_remap[chunk.m_indices[index]];
+                    }
+                });
+
+    GroupModelMaterials(objFileName, materials, triangleMaterials, model);
+
+    return true;
+}
+
+//====================================================
+//      NOTE: OBJ Streaming Import
+//====================================================
+
+internal size_t GetObjVertexTableSlotCount(size_t vertexCount)
+{
+    // NOTE: Load factor under 3/4, linear probing degrades faster than the robin hood table
+    size_t slotCount = 16;
+    while (slotCount * 3 < vertexCount * 4)
+    {
+        slotCount *= 2;
+    }
+    return slotCount;
+}
+
+internal uint32 FindOrAddObjVertex(ObjVertexTable * table, std::vector<Vertex> & vertices, const Vertex & vertex)
+{
+    uint64 hash = HashBytes64(&vertex, sizeof(Vertex));
+    uint32 hashTag = (uint32)(hash >> 32);
+    uint32 mask = (uint32)table->m_slots.size() - 1;
+
+    for (uint32 index = (uint32)hash & mask; ; index = (index + 1) & mask)
+    {
+        ObjVertexSlot & slot = table->m_slots[index];
+        if (slot.m_vertex == 0)
+        {
+            uint32 result = (uint32)vertices.size();
+            slot.m_vertex  = result + 1;
+            slot.m_hashTag = hashTag;
+            vertices.push_back(vertex);
+            table->m_count++;
+            return result;
+        }
+
+        if (slot.m_hashTag == hashTag && memcmp(&vertices[slot.m_vertex - 1], &vertex, sizeof(Vertex)) == 0)
+        {
+            return slot.m_vertex - 1;
+        }
+    }
+}
+
+// NOTE: Rehashes from the vertices themselves, the slots do not keep the full hash
+internal void GrowObjVertexTable(ObjVertexTable * table, const std::vector<Vertex> & vertices, size_t slotCount)
+{
+    table->m_slots.clear();
+    table->m_slots.shrink_to_fit();
+    table->m_slots.resize(slotCount);
+
+    uint32 mask = (uint32)slotCount - 1;
+    for (uint32 v = 0; v < table->m_count; v++)
+    {
+        uint64 hash = HashBytes64(&vertices[v], sizeof(Vertex));
+        uint32 index = (uint32)hash & mask;
+        while (table->m_slots[index].m_vertex != 0)
+        {
+            index = (index + 1) & mask;
+        }
+        table->m_slots[index].m_vertex  = v + 1;
+        table->m_slots[index].m_hashTag = (uint32)(hash >> 32);
+    }
+}
+
+template <typename T>
+internal size_t GetVectorBytes(const std::vector<T> & buffer)
+{
+    return buffer.capacity() * sizeof(T);
+}
+
+internal size_t GetObjStreamBytes(const ObjStreamImport * import)
+{
+    return import->m_sourceBytes + GetVectorBytes(import->m_positions) + GetVectorBytes(import->m_texcoords) +
+        GetVectorBytes(import->m_triangleMaterials) + GetVectorBytes(import->m_vertexTable.m_slots) +
+        GetVectorBytes(import->m_model->m_vertices) + GetVectorBytes(import->m_model->m_indices);
+}
+
+internal size_t GetObjChunkBytes(const ObjChunk * chunk)
+{
+    size_t bytes = GetVectorBytes(chunk->m_positions) + GetVectorBytes(chunk->m_texcoords) + GetVectorBytes(chunk->m_corners) +
+        GetVectorBytes(chunk->m_faces) + GetVectorBytes(chunk->m_eventMaterials);
+    for (const ObjMaterialEvent & event : chunk->m_materialEvents)
+    {
+        bytes += sizeof(event) + event.m_name.capacity();
+    }
+    return bytes;
+}
+
+// NOTE: Grows buffer to hold count elements, by half again where that fits so appending stays amortized. The old and
+//       the new allocation are both alive while the elements move, that peak is what has to stay under the cap.
+//       extraBytes is whatever else is alive right now, the chunk being imported
+template <typename T>
+internal bool ReserveObjStream(ObjStreamImport * import, std::vector<T> & buffer, size_t count, size_t extraBytes)
+{
+    if (count <= buffer.capacity())
+    {
+        return true;
+    }
+
+    size_t used = GetObjStreamBytes(import) + extraBytes;
+    size_t capacity = std::max(count, buffer.capacity() + buffer.capacity() / 2);
+    if (used + capacity * sizeof(T) > import->m_memoryCap)
+    {
+        capacity = count;
+    }
+    if (used + capacity * sizeof(T) > import->m_memoryCap)
+    {
+        return false;
+    }
+
+    buffer.reserve(capacity);
+    return true;
+}
+
+// NOTE: Makes room for everything the chunk can add before it is built, so the build itself never allocates.
+//       Every corner of every triangle is assumed to be a new vertex
+internal bool ReserveObjStreamChunk(ObjStreamImport * import, const ObjChunk * chunk)
+{
+    size_t chunkBytes = GetObjChunkBytes(chunk);
+
+    size_t triangleCount = 0;
+    for (const ObjFace & face : chunk->m_faces)
+    {
+        triangleCount += face.m_cornerCount >= 3 ? face.m_cornerCount - 2 : 0;
+    }
+
+    Model * model = import->m_model;
+    bool reserved =
+        ReserveObjStream(import, import->m_positions, import->m_positions.size() + chunk->m_positions.size(), chunkBytes) &&
+        ReserveObjStream(import, import->m_texcoords, import->m_texcoords.size() + chunk->m_texcoords.size(), chunkBytes) &&
+        ReserveObjStream(import, import->m_triangleMaterials, import->m_triangleMaterials.size() + triangleCount, chunkBytes) &&
+        ReserveObjStream(import, model->m_indices, model->m_indices.size() + 3 * triangleCount, chunkBytes) &&
+        ReserveObjStream(import, model->m_vertices, model->m_vertices.size() + 3 * triangleCount, chunkBytes);
+    if (!reserved)
+    {
+        return false;
+    }
+
+    ObjVertexTable * table = &import->m_vertexTable;
+    size_t slotCount = GetObjVertexTableSlotCount(table->m_count + 3 * triangleCount);
+    if (slotCount > table->m_slots.size())
+    {
+        // NOTE: The old slots are freed before the new ones are allocated, rehashing only needs the vertices
+        size_t used = GetObjStreamBytes(import) - GetVectorBytes(table->m_slots) + chunkBytes;
+        if (used + slotCount * sizeof(ObjVertexSlot) > import->m_memoryCap)
+        {
+            return false;
+        }
+        GrowObjVertexTable(table, model->m_vertices, slotCount);
+    }
+
+    return true;
+}
+
+// NOTE: Walks the mapped file, archived or loose, tokenizing, deduplicating and appending one line aligned chunk at
+//       a time, so only the attributes, the model and its dedup table grow with the file. Polygons are fanned and
+//       lines, points and skin weights skipped, since there is no whole file import to leave them to. Faces must not
+//       reference attributes past the end of their chunk, exporters write them first; anything else returns
+//       OBJ_IMPORT_UNSUPPORTED. model is left empty unless the result is OBJ_IMPORT_OK
+internal ObjImportResult ImportObjModelStreaming(const char * objFileName, size_t memoryCap, Model * model)
+{
+    *model = {};
+
+    ResourceFile file = OpenResource(objFileName, FILE_ACCESS_SEQUENTIAL);
+    if (!file.m_data)
+    {
+        return OBJ_IMPORT_UNSUPPORTED;
+    }
+
+    ObjStreamImport import = {};
+    import.m_model       = model;
+    import.m_memoryCap   = memoryCap;
+    import.m_sourceBytes = file.m_owned ? file.m_size : 0;
+
+    ObjMaterialReader materialReader(GetObjBaseDirectory(objFileName));
+    std::set<std::string> materialFiles;
+    std::vector<tinyobj::material_t> materials;
+    std::map<std::string, int> materialMap;
+    int32 material = -1;
+
+    // NOTE: Archive entries that are compressed are decompressed whole, mapped files are paged by the OS
+    ObjImportResult result = import.m_sourceBytes <= memoryCap ? OBJ_IMPORT_OK : OBJ_IMPORT_OVER_BUDGET;
+
+    const char * end = file.m_data + file.m_size;
+    const char * begin = file.m_data;
+    while (result == OBJ_IMPORT_OK && begin < end)
+    {
+        ObjChunk chunk = {};
+        chunk.m_begin     = begin;
+        chunk.m_end       = FindObjChunkEnd(begin, end);
+        chunk.m_isFirst   = begin == file.m_data;
+        chunk.m_supported = true;
+        chunk.m_streaming = true;
+        begin = chunk.m_end;
+
+        TokenizeObjChunk(&chunk);
+        if (!chunk.m_supported)
+        {
+            result = OBJ_IMPORT_UNSUPPORTED;
+            break;
+        }
+
+        if (!ReserveObjStreamChunk(&import, &chunk))
+        {
+            result = OBJ_IMPORT_OVER_BUDGET;
+            break;
+        }
+
+        chunk.m_positionBase = (uint32)(import.m_positions.size() / 3);
+        chunk.m_texcoordBase = (uint32)(import.m_texcoords.size() / 2);
+        import.m_positions.insert(import.m_positions.end(), chunk.m_positions.begin(), chunk.m_positions.end());
+        import.m_texcoords.insert(import.m_texcoords.end(), chunk.m_texcoords.begin(), chunk.m_texcoords.end());
+
+        // NOTE: Chunks are in file order already, so materials resolve as they come
+        chunk.m_startMaterial = material;
+        chunk.m_eventMaterials.assign(chunk.m_materialEvents.size(), -1);
+        for (size_t e = 0; e < chunk.m_materialEvents.size(); e++)
+        {
+            const ObjMaterialEvent & event = chunk.m_materialEvents[e];
+            if (event.m_isLibrary)
+            {
+                LoadObjMaterialLibrary(event.m_name, materialReader, materialFiles, materials, materialMap);
+                continue;
+            }
+
+            auto it = materialMap.find(event.m_name);
+            material = it != materialMap.end() ? it->second : -1;
+            chunk.m_eventMaterials[e] = material;
+        }
+
+        TriangulateObjChunk(&chunk, import.m_positions, import.m_texcoords,
+                            [&import, model](const ObjCorner & a, const ObjCorner & b, const ObjCorner & c, int32 triangleMaterial)
+                            {
+                                const ObjCorner * corners[3] = { &a, &b, &c };
+                                for (const ObjCorner * corner : corners)
+                                {
+                                    Vertex vertex = MakeObjVertex(import.m_positions, import.m_texcoords, *corner);
+                                    model->m_indices.push_back(FindOrAddObjVertex(&import.m_vertexTable, model->m_vertices, vertex));
+                                }
+                                import.m_triangleMaterials.push_back(triangleMaterial);
+                            });
+        if (!chunk.m_supported)
+        {
+            result = OBJ_IMPORT_UNSUPPORTED;
+            break;
+        }
+    }
+
+    CloseResource(&file);
+
+    // NOTE: Only the model and the triangle materials are needed from here on
+    import.m_sourceBytes = 0;
+    import.m_positions   = {};
+    import.m_texcoords   = {};
+    import.m_vertexTable = {};
+
+    // NOTE: Grouping the triangles by material makes a second copy of the indices
+    if (result == OBJ_IMPORT_OK &&
+        GetObjStreamBytes(&import) + GetVectorBytes(model->m_indices) > memoryCap)
+    {
+        result = OBJ_IMPORT_OVER_BUDGET;
+    }
+
+    if (result != OBJ_IMPORT_OK)
+    {
+        if (result == OBJ_IMPORT_OVER_BUDGET)
+        {
+            SM_WARN("%s does not import within %zu MB", objFileName, (size_t)(memoryCap / MB(1)));
+        }
+        *model = {};
+        return result;
+    }
+
+    GroupModelMaterials(objFileName, materials, import.m_triangleMaterials, model);
+
+    return OBJ_IMPORT_OK;
+}
+
+// NOTE: tinyobj based import, handles everything ImportObjModelParallel bails out on
+internal Model ImportObjModel(const char * objFileName)
+{
+    tinyobj::attrib_t attrib;
+    std::vector<tinyobj::shape_t> shapes;
+    std::vector<tinyobj::material_t> materials;
+    std::string warn;
+    std::string err;
+    
+    // NOTE: tinyobj only reads from disk by itself, so the file and its .mtl go through the resource API
+    //       as streams, archived or not
+    bool ret = false;
+    ResourceFile file = OpenResource(objFileName, FILE_ACCESS_SEQUENTIAL);
+    if (file.m_data)
+    {
+        std::istringstream stream(std::string(file.m_data, file.m_size));
+        CloseResource(&file);
+        
+        ObjMaterialReader materialReader(GetObjBaseDirectory(objFileName));
+        ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, &stream, &materialReader);
+    }
+    else
+    {
+        err = "failed to open " + std::string(objFileName);
+    }
+    if (!warn.empty())
+    {
+        SM_WARN("%s", warn.c_str());
+    }
+    if (!err.empty())
+    {
+        SM_ERROR("%s", err.c_str());
+    }
+    
+    SM_ASSERT(ret, "failed to load object file, err: %s", err.c_str());
+    
+    HashTable<Vertex, uint32> uniqueVertices = {};
+    uniqueVertices.Init((uint32)(attrib.vertices.size() / 3));
+    Model model = {};
+    std::vector<int32> triangleMaterials;
+    
+    // Loop over shapes
+    for (size_t s = 0; s < shapes.size(); s++)
+    {
+        // Loop over faces(polygon)
+        size_t index_offset = 0;
+        for (size_t f = 0; f < shapes[s].mesh.num_face_vertices.size(); f++)
+        {
+            size_t fv = size_t(shapes[s].mesh.num_face_vertices[f]);
+            
+            // Loop over vertices in the face.
+            for (size_t v = 0; v < fv; v++)
+            {
+                Vertex vertex = {};
+                
+                // access to vertex
+                tinyobj::index_t idx = shapes[s].mesh.indices[index_offset + v];
+                
+                vertex.m_pos.x = attrib.vertices[3*size_t(idx.vertex_index)+0];
+                vertex.m_pos.y = attrib.vertices[3*size_t(idx.vertex_index)+1];
+                vertex.m_pos.z = attrib.vertices[3*size_t(idx.vertex_index)+2];
+                
+                // Check if `normal_index` is zero or positive. negative = no normal data
+                if (idx.normal_index >= 0) {
+                    tinyobj::real_t nx = attrib.normals[3*size_t(idx.normal_index)+0];
+                    tinyobj::real_t ny = attrib.normals[3*size_t(idx.normal_index)+1];
+                    tinyobj::real_t nz = attrib.normals[3*size_t(idx.normal_index)+2];
+                }
+                
+                // Check if `texcoord_index` is zero or positive. negative = no texcoord data
+                if (idx.texcoord_index >= 0) {
+                    vertex.m_texCoord.x = attrib.texcoords[2*size_t(idx.texcoord_index)+0];
+                    vertex.m_texCoord.y = 1.0f - attrib.texcoords[2*size_t(idx.texcoord_index)+1];
+                    //vertex.m_texCoord.y = attrib.texcoords[2*size_t(idx.texcoord_index)+1];
+                }
+                
+                vertex.m_color = { 1.0f, 1.0f, 1.0f };
+                
+                uint32 index = uniqueVertices.FindOrAdd(vertex, (uint32)model.m_vertices.size());
+                if (index == model.m_vertices.size())
+                {
+                    model.m_vertices.push_back(vertex);
+                }
+                
+                model.m_indices.push_back(index);
+            }
+            
+            index_offset += fv;
+            
+            // NOTE: Faces are triangulated, so this is one material per triangle
+            triangleMaterials.push_back(shapes[s].mesh.material_ids[f]);
+        }
+    }
+    
+    GroupModelMaterials(objFileName, materials, triangleMaterials, &model);
+
+    return model;
+}
@@ -0,0 +1,122 @@
+/* date = October 18th 2026 11:02 am */
+
+#ifndef OBJ_PARSER_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+#include "resource_archive.h"
+
+#include <map>
+#include <set>
+#include <sstream>
+
+//====================================================
+//      NOTE: OBJ Parser Constexpr
+//====================================================
+
+// NOTE: Files are split into line aligned chunks of roughly this size, one job per chunk
+constexpr size_t OBJ_CHUNK_SIZE = MB(1);
+
+// NOTE: Sources at least this large go through ImportObjModelStreaming, which only ever tokenizes one chunk of the
+//       file at a time. They fail to cook rather than fall back to an import that holds every token at once
+constexpr size_t OBJ_STREAMING_THRESHOLD = MB(64);
+
+// NOTE: Peak bytes a streaming import may hold, counting the file window, the attributes, the model being built and
+//       its dedup table. Imports that would need more fail instead of taking the machine down
+constexpr size_t OBJ_STREAMING_MEMORY_CAP = GB(1);
+
+constexpr uint32 OBJ_RELATIVE_POSITION = BIT(0);
+constexpr uint32 OBJ_RELATIVE_TEXCOORD = BIT(1);
+
+//====================================================
+//      NOTE: OBJ Parser Structs
+//====================================================
+
+// NOTE: Zero based attribute indices of one face corner. Relative (negative) OBJ indices are stored
+//       relative to the start of the chunk and fixed up once the chunk bases are known
+struct ObjCorner
+{
+    int32  m_position;
+    int32  m_texcoord;
+    uint32 m_relativeFlags;
+};
+
+struct ObjFace
+{
+    uint32 m_cornerCount;
+    uint32 m_positionCount; // NOTE: Positions parsed in this chunk before the face
+    int32  m_materialEvent; // NOTE: Last usemtl in this chunk before the face, -1 keeps the one the chunk starts with
+};
+
+// NOTE: mtllib and usemtl lines in file order. A usemtl resolves against whatever .mtl files were loaded before it,
+//       so they are replayed in order once every chunk is tokenized
+struct ObjMaterialEvent
+{
+    bool        m_isLibrary;
+    std::string m_name;
+};
+
+struct ObjChunk
+{
+    const char * m_begin;
+    const char * m_end;
+    bool         m_isFirst;
+    bool         m_supported;
+    bool         m_streaming; // NOTE: Fans polygons and skips what only tinyobj would handle, nothing falls back to it
+
+    // NOTE: Tokenize pass
+    std::vector<real32>    m_positions;
+    std::vector<real32>    m_texcoords;
+    std::vector<ObjCorner> m_corners;
+    std::vector<ObjFace>   m_faces;
+    std::vector<ObjMaterialEvent> m_materialEvents;
+
+    uint32 m_positionBase;
+    uint32 m_texcoordBase;
+    int32  m_startMaterial;
+    std::vector<int32> m_eventMaterials; // NOTE: Material id of each usemtl event, -1 if the .mtl does not have it
+
+    // NOTE: Build pass, deduplicated within the chunk only
+    std::vector<Vertex> m_vertices;
+    std::vector<uint32> m_indices;
+    std::vector<uint32> m_remap;
+    std::vector<int32>  m_triangleMaterials;
+    uint32              m_indexOffset;
+};
+
+enum ObjImportResult
+{
+    OBJ_IMPORT_OK,
+    OBJ_IMPORT_UNSUPPORTED,  // NOTE: Uses something only tinyobj handles, or could not be opened
+    OBJ_IMPORT_OVER_BUDGET,
+};
+
+struct ObjVertexSlot
+{
+    uint32 m_vertex; // NOTE: Vertex index + 1, 0 means empty
+    uint32 m_hashTag;
+};
+
+// NOTE: Linear probing over indices into the model's vertices, 8 bytes a slot instead of a second copy of every
+//       vertex like HashTable<Vertex, uint32> keeps
+struct ObjVertexTable
+{
+    std::vector<ObjVertexSlot> m_slots;
+    uint32                     m_count;
+};
+
+// NOTE: Everything a streaming import holds between chunks, all of it is counted against m_memoryCap
+struct ObjStreamImport
+{
+    Model * m_model;
+    size_t  m_memoryCap;
+
+    size_t              m_sourceBytes; // NOTE: Only a decompressed archive entry is held in memory
+    std::vector<real32> m_positions;
+    std::vector<real32> m_texcoords;
+    std::vector<int32>  m_triangleMaterials;
+    ObjVertexTable      m_vertexTable;
+};
+
+#define OBJ_PARSER_H
+#endif //OBJ_PARSER_H
@@ -3,7 +3,13 @@
 #ifndef RENDER_INTERFACE_H
 
 #include "engine_lib.h"
+#include "asset_registry.h"
+#include "resource_archive.h"
+#ifndef GLM_ENABLE_EXPERIMENTAL
+#define GLM_ENABLE_EXPERIMENTAL
+#endif
 #include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
 
  constexpr char * TEXTURE_PATH1 = "resources/objects/backpack/diffuse_2.jpg";
 constexpr char * MODEL_PATH1   = "resources/objects/backpack/backpack_2.obj";
@@ -30,10 +36,84 @@ struct Vertex
     }
 };
 
+internal uint32 VertexHash(const Vertex & vertex)
+{
+    uint32 h1 = (uint32)std::hash<glm::vec3>()(vertex.m_pos);
+    uint32 h2 = (uint32)std::hash<glm::vec3>()(vertex.m_color);
+    uint32 h3 = (uint32)std::hash<glm::vec2>()(vertex.m_texCoord);
+    
+    return ((h1 ^ (h2 << 1)) >> 1) ^ (h3 << 1);
+}
+
+template<> struct std::hash<Vertex>
+{
+    size_t operator()(Vertex const& vertex) const
+    {
+        return VertexHash(vertex);
+    }
+};
+
+enum VertexFormat : uint32
+{
+    VERTEX_FORMAT_FLOAT,
+    VERTEX_FORMAT_PACKED,
+
+    VERTEX_FORMAT_COUNT,
+};
+
+// NOTE: 12 bytes instead of 32. The position is unorm16 inside the model AABB, the normal is octahedral snorm8 in
+//       what would otherwise be the padding after it, and the uv is half float. Color is dropped, models only get
+//       packed when it is the constant white
+struct PackedVertex
+{
+    uint16 m_pos[3];
+    int8   m_normal[2];
+    uint16 m_texCoord[2];
+};
+
+// NOTE: Contiguous index range of one OBJ material. Without a diffuse path the range draws with the texture of the
+//       transform, the same as a model without materials
+struct ModelMaterial
+{
+    char   m_diffusePath[ASSET_PATH_LENGTH];
+    uint32 m_firstIndex;
+    uint32 m_indexCount;
+};
+
 struct Model
 {
     std::vector<Vertex> m_vertices;
     std::vector<uint32> m_indices;
+
+    // NOTE: For VERTEX_FORMAT_PACKED m_vertices is released and the AABB is needed to dequantize
+    VertexFormat              m_vertexFormat = VERTEX_FORMAT_FLOAT;
+    std::vector<PackedVertex> m_packedVertices;
+    glm::vec3                 m_aabbMin = {};
+    glm::vec3                 m_aabbMax = {};
+
+    // NOTE: Empty for models with a single material, those draw the whole index buffer with the transform texture
+    std::vector<ModelMaterial> m_materials;
+};
+
+enum TextureEncoding : uint32
+{
+    TEXTURE_ENCODING_RAW, // NOTE: m_channels bytes per texel
+    TEXTURE_ENCODING_BC1, // NOTE: Opaque RGB, 8 bytes per 4x4 block
+    TEXTURE_ENCODING_BC7, // NOTE: RGBA, 16 bytes per block
+};
+
+// NOTE: Decoded 8 bit pixels with m_channels of 1 or 4, filled on a worker and freed once the texture is uploaded.
+//       m_pixels holds m_mipLevels tightly packed levels, anything short of the full chain is blitted at upload.
+//       Block compressed textures always carry their full chain
+struct TextureData
+{
+    uint8 *         m_pixels;
+    uint32          m_width;
+    uint32          m_height;
+    uint32          m_mipLevels = 1;
+    uint32          m_channels = 4;
+    TextureEncoding m_encoding = TEXTURE_ENCODING_RAW;
+    ResourceFile    m_file; // NOTE: Set when m_pixels points into a cooked texture cache
 };
 
 struct Camera
@@ -56,7 +136,10 @@ struct Transform
     uint32 m_numCopies;
     
     std::vector<glm::vec3> m_meshPositions;
-    Model m_model;
+    
+    // NOTE: Shared with every other transform of the same m_modelID / m_textureID
+    ModelHandle   m_model   = INVALID_ASSET_HANDLE;
+    TextureHandle m_texture = INVALID_ASSET_HANDLE;
     };
 
 struct Fog
@@ -78,6 +161,9 @@ struct RenderData
     
     // TODO: Current We can only Render one transform. 
     Array<Transform, MAX_TRANSFORM> m_transforms;
+    
+    AssetRegistry      m_assets;
+    std::vector<Model> m_models; // NOTE: Indexed by ModelHandle
     };
 
 #define RENDER_INTERFACE_H
@@ -0,0 +1,571 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "resource_archive.h"
+
+// NOTE: Mounted once before any asset is loaded and only read afterwards, so workers can look paths up freely
+global_variable ResourceArchive mountedResourceArchive;
+
+//====================================================
+//      NOTE: LZ4 Block Codec
+//====================================================
+
+internal uint32 ReadLz4Sequence(const uint8 * src)
+{
+    uint32 sequence;
+    memcpy(&sequence, src, sizeof(sequence));
+    return sequence;
+}
+
+internal uint32 HashLz4Sequence(uint32 sequence)
+{
+    return (sequence * 2654435761u) >> (32 - LZ4_HASH_BITS);
+}
+
+internal size_t GetLz4CompressBound(size_t size)
+{
+    return size + size / 255 + 16;
+}
+
+// NOTE: Lengths of 15 and up spill into extra bytes, each 255 means another byte follows
+internal uint8 * WriteLz4Length(uint8 * dst, size_t length)
+{
+    length -= 15;
+    while (length >= 255)
+    {
+        *dst++ = 255;
+        length -= 255;
+    }
+    *dst++ = (uint8)length;
+    return dst;
+}
+
+internal bool ReadLz4Length(const uint8 ** src, const uint8 * srcEnd, size_t * length)
+{
+    uint8 byte;
+    do
+    {
+        if (*src == srcEnd)
+        {
+            return false;
+        }
+        byte = *(*src)++;
+        *length += byte;
+    } while (byte == 255);
+
+    return true;
+}
+
+// NOTE: One sequence is a token, the literals and then a match. The last sequence of a block has no match
+internal uint8 * WriteLz4Sequence(uint8 * dst, const uint8 * literals, size_t literalLength, uint32 offset, size_t matchLength)
+{
+    uint8 * token = dst++;
+    *token = (uint8)(std::min<size_t>(literalLength, 15) << 4);
+    if (literalLength >= 15)
+    {
+        dst = WriteLz4Length(dst, literalLength);
+    }
+
+    memcpy(dst, literals, literalLength);
+    dst += literalLength;
+
+    if (matchLength)
+    {
+        *dst++ = (uint8)(offset & 0xFF);
+        *dst++ = (uint8)(offset >> 8);
+
+        size_t extraLength = matchLength - LZ4_MIN_MATCH;
+        *token |= (uint8)std::min<size_t>(extraLength, 15);
+        if (extraLength >= 15)
+        {
+            dst = WriteLz4Length(dst, extraLength);
+        }
+    }
+    return dst;
+}
+
+// NOTE: Greedy single probe compressor producing a standard LZ4 block, dst needs GetLz4CompressBound(size) bytes.
+//       Returns the compressed size
+internal size_t Lz4Compress(const uint8 * src, size_t size, uint8 * dst)
+{
+    SM_ASSERT(size < UINT32_MAX, "LZ4 blocks are limited to 4GB!");
+
+    std::vector<uint32> table((size_t)1 << LZ4_HASH_BITS, 0);
+
+    uint8 * out = dst;
+    size_t anchor = 0;
+    size_t position = 0;
+
+    while (position + LZ4_MATCH_LIMIT <= size)
+    {
+        uint32 sequence = ReadLz4Sequence(src + position);
+        uint32 hash = HashLz4Sequence(sequence);
+        size_t candidate = table[hash];
+        table[hash] = (uint32)position;
+
+        if (candidate < position && position - candidate <= LZ4_MAX_OFFSET && ReadLz4Sequence(src + candidate) == sequence)
+        {
+            size_t matchEnd = position + LZ4_MIN_MATCH;
+            size_t matchMax = size - LZ4_LAST_LITERALS;
+            while (matchEnd < matchMax && src[matchEnd] == src[candidate + (matchEnd - position)])
+            {
+                matchEnd++;
+            }
+
+            out = WriteLz4Sequence(out, src + anchor, position - anchor, (uint32)(position - candidate), matchEnd - position);
+            position = matchEnd;
+            anchor = position;
+        }
+        else
+        {
+            position++;
+        }
+    }
+
+    out = WriteLz4Sequence(out, src + anchor, size - anchor, 0, 0);
+    return (size_t)(out - dst);
+}
+
+// NOTE: Bounds checked, returns false for a corrupt block or one that does not decode to exactly dstSize bytes
+internal bool Lz4Decompress(const uint8 * src, size_t srcSize, uint8 * dst, size_t dstSize)
+{
+    const uint8 * in = src;
+    const uint8 * inEnd = src + srcSize;
+    uint8 * out = dst;
+    uint8 * outEnd = dst + dstSize;
+
+    while (in < inEnd)
+    {
+        uint8 token = *in++;
+
+        size_t literalLength = token >> 4;
+        if (literalLength == 15 && !ReadLz4Length(&in, inEnd, &literalLength))
+        {
+            return false;
+        }
+        if (literalLength > (size_t)(inEnd - in) || literalLength > (size_t)(outEnd - out))
+        {
+            return false;
+        }
+
+        memcpy(out, in, literalLength);
+        in += literalLength;
+        out += literalLength;
+
+        if (in == inEnd)
+        {
+            break;
+        }
+
+        if (inEnd - in < 2)
+        {
+            return false;
+        }
+        size_t offset = (size_t)in[0] | ((size_t)in[1] << 8);
+        in += 2;
+        if (offset == 0 || offset > (size_t)(out - dst))
+        {
+            return false;
+        }
+
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !ReadLz4Length(&in, inEnd, &matchLength))
+        {
+            return false;
+        }
+        matchLength += LZ4_MIN_MATCH;
+        if (matchLength > (size_t)(outEnd - out))
+        {
+            return false;
+        }
+
+        // NOTE: Matches may overlap their own output, which repeats the last offset bytes
+        const uint8 * match = out - offset;
+        if (offset >= matchLength)
+        {
+            memcpy(out, match, matchLength);
+        }
+        else
+        {
+            for (size_t i = 0; i < matchLength; i++)
+            {
+                out[i] = match[i];
+            }
+        }
+        out += matchLength;
+    }
+
+    return out == outEnd;
+}
+
+//====================================================
+//      NOTE: Resource Archive Functions
+//====================================================
+
+// NOTE: Archive paths always use forward slashes and never start with ./
+internal void NormalizeResourcePath(const char * path, char * normalized, uint32 normalizedSize)
+{
+    if (path[0] == '.' && (path[1] == '/' || path[1] == '\\'))
+    {
+        path += 2;
+    }
+
+    uint32 i = 0;
+    for (; path[i] && i + 1 < normalizedSize; i++)
+    {
+        normalized[i] = path[i] == '\\' ? '/' : path[i];
+    }
+    normalized[i] = 0;
+}
+
+internal int32 CompareResourcePath(const ResourceArchive & archive, const ResourceArchiveEntry & entry, const char * path, size_t pathLength)
+{
+    int32 result = memcmp(archive.m_paths + entry.m_pathOffset, path, std::min<size_t>(entry.m_pathLength, pathLength));
+    if (result == 0)
+    {
+        result = entry.m_pathLength < pathLength ? -1 : (entry.m_pathLength > pathLength ? 1 : 0);
+    }
+    return result;
+}
+
+// NOTE: Binary search over the sorted index, nullptr when no archive is mounted or it does not contain path.
+//       Also nullptr when the loose file changed after it was packed, so edits and recooks are picked up without
+//       repacking. Costs a stat of the loose path per lookup
+internal const ResourceArchiveEntry * FindResourceEntry(const char * path)
+{
+    const ResourceArchive & archive = mountedResourceArchive;
+    if (!archive.m_header)
+    {
+        return nullptr;
+    }
+
+    char normalized[300];
+    NormalizeResourcePath(path, normalized, ArrayCount(normalized));
+    size_t length = strlen(normalized);
+
+    uint32 low = 0;
+    uint32 high = archive.m_header->m_entryCount;
+    while (low < high)
+    {
+        uint32 middle = low + (high - low) / 2;
+        int32 order = CompareResourcePath(archive, archive.m_entries[middle], normalized, length);
+        if (order == 0)
+        {
+            const ResourceArchiveEntry * entry = &archive.m_entries[middle];
+            return GetTimestamp(normalized) > entry->m_sourceTimestamp ? nullptr : entry;
+        }
+
+        if (order < 0)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+    return nullptr;
+}
+
+// NOTE: Every later resource lookup checks the archive before falling back to loose files, unless the loose file
+//       is newer than its entry
+internal bool MountResourceArchive(const char * archivePath)
+{
+    SM_ASSERT(!mountedResourceArchive.m_header, "a resource archive is already mounted!");
+
+    // NOTE: Lookups binary search the index and entries are read in whatever order assets stream in
+    MappedFile file = MapFile((char *)archivePath, FILE_ACCESS_RANDOM);
+    if (!file.memory || file.size < sizeof(ResourceArchiveHeader))
+    {
+        UnmapFile(&file);
+        return false;
+    }
+
+    ResourceArchiveHeader * header = (ResourceArchiveHeader *)file.memory;
+    uint64 indexEnd = sizeof(ResourceArchiveHeader) + (uint64)header->m_entryCount * sizeof(ResourceArchiveEntry);
+    bool valid = header->m_magic == RESOURCE_ARCHIVE_MAGIC &&
+        header->m_version == RESOURCE_ARCHIVE_VERSION &&
+        indexEnd <= file.size &&
+        header->m_pathsOffset >= indexEnd &&
+        header->m_pathsOffset + header->m_pathsSize <= file.size;
+
+    ResourceArchiveEntry * entries = (ResourceArchiveEntry *)(file.memory + sizeof(ResourceArchiveHeader));
+    for (uint32 i = 0; valid && i < header->m_entryCount; i++)
+    {
+        valid = (uint64)entries[i].m_pathOffset + entries[i].m_pathLength <= header->m_pathsSize &&
+            entries[i].m_compression <= RESOURCE_COMPRESSION_LZ4 &&
+            entries[i].m_offset + entries[i].m_storedSize <= file.size;
+    }
+
+    if (!valid)
+    {
+        SM_WARN("resource archive %s is corrupt or out of date, using loose files", archivePath);
+        UnmapFile(&file);
+        return false;
+    }
+
+    mountedResourceArchive.m_file    = file;
+    mountedResourceArchive.m_header  = header;
+    mountedResourceArchive.m_entries = entries;
+    mountedResourceArchive.m_paths   = file.memory + header->m_pathsOffset;
+
+    SM_TRACE("mounted resource archive %s, %u entries, %.2f MB", archivePath, header->m_entryCount, file.size / (1024.0 * 1024.0));
+    return true;
+}
+
+internal void UnmountResourceArchive()
+{
+    UnmapFile(&mountedResourceArchive.m_file);
+    mountedResourceArchive = {};
+}
+
+internal bool ResourceExists(const char * path)
+{
+    return FindResourceEntry(path) || FileExists((char *)path);
+}
+
+// NOTE: For archived resources this is the timestamp the loose file had when it was packed, which keeps cooked
+//       caches packed next to their source valid
+internal int64 GetResourceTimestamp(const char * path)
+{
+    const ResourceArchiveEntry * entry = FindResourceEntry(path);
+    return entry ? entry->m_sourceTimestamp : GetTimestamp((char *)path);
+}
+
+internal int64 GetResourceSize(const char * path)
+{
+    const ResourceArchiveEntry * entry = FindResourceEntry(path);
+    return entry ? (int64)entry->m_size : (int64)GetFileSize((char *)path);
+}
+
+// NOTE: m_data is nullptr if path is neither in the archive nor on disk. access hints how the caller reads it,
+//       archived entries get the hint for their range of the archive mapping
+internal ResourceFile OpenResource(const char * path, FileAccess access = FILE_ACCESS_NORMAL)
+{
+    ResourceFile result = {};
+
+    const ResourceArchiveEntry * entry = FindResourceEntry(path);
+    if (!entry)
+    {
+        result.m_file = MapFile((char *)path, access);
+        result.m_data = result.m_file.memory;
+        result.m_size = result.m_file.size;
+        return result;
+    }
+
+    char * stored = mountedResourceArchive.m_file.memory + entry->m_offset;
+    if (entry->m_compression == RESOURCE_COMPRESSION_NONE)
+    {
+        AdviseMappedFile(&mountedResourceArchive.m_file, (size_t)entry->m_offset, (size_t)entry->m_storedSize, access);
+        result.m_data = stored;
+        result.m_size = (size_t)entry->m_size;
+        return result;
+    }
+
+    // NOTE: The decoder walks the stored bytes front to back once
+    AdviseMappedFile(&mountedResourceArchive.m_file, (size_t)entry->m_offset, (size_t)entry->m_storedSize, FILE_ACCESS_SEQUENTIAL);
+    char * buffer = (char *)malloc(std::max<size_t>((size_t)entry->m_size, 1));
+    if (!Lz4Decompress((uint8 *)stored, (size_t)entry->m_storedSize, (uint8 *)buffer, (size_t)entry->m_size))
+    {
+        SM_ERROR("failed to decompress %s from the resource archive", path);
+        free(buffer);
+        return result;
+    }
+
+    result.m_data  = buffer;
+    result.m_size  = (size_t)entry->m_size;
+    result.m_owned = true;
+    return result;
+}
+
+internal void CloseResource(ResourceFile * file)
+{
+    SM_ASSERT(file, "No resource file provided!");
+
+    if (file->m_owned)
+    {
+        free(file->m_data);
+    }
+    else
+    {
+        UnmapFile(&file->m_file);
+    }
+    *file = {};
+}
+
+// NOTE: The bytes of an open resource without a copy, valid until it is closed
+internal Span<const char> ViewResource(const ResourceFile & file)
+{
+    Span<const char> result = {};
+    result.elements = file.m_data;
+    result.count    = file.m_size;
+    return result;
+}
+
+// NOTE: Same contract as read_file, the result is null terminated and therefore one byte longer than the file
+internal std::vector<char> ReadResource(const char * path)
+{
+    std::vector<char> result;
+
+    ResourceFile file = OpenResource(path, FILE_ACCESS_SEQUENTIAL);
+    if (file.m_data)
+    {
+        result.resize(file.m_size + 1);
+        memcpy(result.data(), file.m_data, file.m_size);
+        CloseResource(&file);
+    }
+    else
+    {
+        SM_ERROR("Failed to open resource: %s", path);
+    }
+
+    return result;
+}
+
+//====================================================
+//      NOTE: Resource Archive Packing
+//====================================================
+
+internal void CollectResourcePaths(const char * root, std::vector<std::string> & paths)
+{
+    std::error_code error;
+    for (auto iterator = std::filesystem::recursive_directory_iterator(root, error);
+         iterator != std::filesystem::recursive_directory_iterator();
+         iterator.increment(error))
+    {
+        if (error)
+        {
+            SM_WARN("failed to walk %s: %s", root, error.message().c_str());
+            break;
+        }
+
+        if (iterator->is_regular_file())
+        {
+            paths.push_back(iterator->path().generic_string());
+        }
+    }
+}
+
+internal void WriteResourcePadding(FILE * file, uint64 * offset)
+{
+    static const uint8 zeros[RESOURCE_ARCHIVE_ALIGNMENT] = {};
+
+    uint64 aligned = (*offset + RESOURCE_ARCHIVE_ALIGNMENT - 1) & ~(RESOURCE_ARCHIVE_ALIGNMENT - 1);
+    fwrite(zeros, 1, (size_t)(aligned - *offset), file);
+    *offset = aligned;
+}
+
+// NOTE: Packs the given loose files into one archive. Entries are compressed one at a time, so memory stays
+//       bounded by the largest file
+internal bool WriteResourceArchive(const char * archivePath, std::vector<std::string> paths)
+{
+    for (std::string & path : paths)
+    {
+        char normalized[300];
+        NormalizeResourcePath(path.c_str(), normalized, ArrayCount(normalized));
+        path = normalized;
+    }
+    std::sort(paths.begin(), paths.end());
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+
+    std::vector<ResourceArchiveEntry> entries(paths.size());
+    std::string pathBlock;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        entries[i].m_pathOffset = (uint32)pathBlock.size();
+        entries[i].m_pathLength = (uint32)paths[i].size();
+        pathBlock += paths[i];
+    }
+
+    auto file = fopen(archivePath, "wb");
+    if (!file)
+    {
+        SM_WARN("Failed to write resource archive: %s", archivePath);
+        return false;
+    }
+
+    ResourceArchiveHeader header = {};
+    header.m_version     = RESOURCE_ARCHIVE_VERSION;
+    header.m_entryCount  = (uint32)entries.size();
+    header.m_pathsOffset = sizeof(ResourceArchiveHeader) + entries.size() * sizeof(ResourceArchiveEntry);
+    header.m_pathsSize   = pathBlock.size();
+
+    // NOTE: The index is written again once every entry knows its offset
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries.data(), sizeof(ResourceArchiveEntry), entries.size(), file);
+    fwrite(pathBlock.data(), 1, pathBlock.size(), file);
+    uint64 offset = header.m_pathsOffset + header.m_pathsSize;
+
+    uint64 totalSize = 0;
+    uint64 totalStored = 0;
+    std::vector<uint8> compressed;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        ResourceArchiveEntry & entry = entries[i];
+        entry.m_sourceTimestamp = GetTimestamp((char *)paths[i].c_str());
+
+        MappedFile source = MapFile((char *)paths[i].c_str(), FILE_ACCESS_SEQUENTIAL);
+        const uint8 * data = (const uint8 *)source.memory;
+        size_t size = source.size;
+
+        const uint8 * stored = data;
+        size_t storedSize = size;
+        entry.m_compression = RESOURCE_COMPRESSION_NONE;
+        if (size > 0)
+        {
+            compressed.resize(GetLz4CompressBound(size));
+            size_t compressedSize = Lz4Compress(data, size, compressed.data());
+            if (compressedSize <= size - (size >> RESOURCE_ARCHIVE_MIN_SAVING_SHIFT))
+            {
+                stored = compressed.data();
+                storedSize = compressedSize;
+                entry.m_compression = RESOURCE_COMPRESSION_LZ4;
+            }
+        }
+
+        WriteResourcePadding(file, &offset);
+        entry.m_offset     = offset;
+        entry.m_size       = size;
+        entry.m_storedSize = storedSize;
+
+        if (storedSize > 0)
+        {
+            fwrite(stored, 1, storedSize, file);
+        }
+        offset += storedSize;
+        totalSize += size;
+        totalStored += storedSize;
+
+        UnmapFile(&source);
+    }
+
+    // NOTE: The magic is written last so a half written archive never mounts
+    header.m_magic = RESOURCE_ARCHIVE_MAGIC;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(entries.data(), sizeof(ResourceArchiveEntry), entries.size(), file);
+
+    fclose(file);
+
+    SM_TRACE("packed %zu files into %s: %.2f MB -> %.2f MB", paths.size(), archivePath,
+             totalSize / (1024.0 * 1024.0), totalStored / (1024.0 * 1024.0));
+    return true;
+}
+
+// NOTE: Packs everything under RESOURCE_ARCHIVE_ROOTS, including cooked .mesh and .tex files already next to
+//       their sources
+internal bool PackResourceArchive(const char * archivePath)
+{
+    std::vector<std::string> paths;
+    for (uint32 i = 0; i < ArrayCount(RESOURCE_ARCHIVE_ROOTS); i++)
+    {
+        CollectResourcePaths(RESOURCE_ARCHIVE_ROOTS[i], paths);
+    }
+
+    return WriteResourceArchive(archivePath, paths);
+}
@@ -0,0 +1,96 @@
+/* date = October 18th 2026 6:05 pm */
+
+#ifndef RESOURCE_ARCHIVE_H
+
+#include "engine_lib.h"
+
+#include <algorithm>
+#include <string>
+
+//====================================================
+//      NOTE: Resource Archive Constexpr
+//====================================================
+
+constexpr char * RESOURCE_ARCHIVE_PATH    = "resources.pak";
+constexpr uint32 RESOURCE_ARCHIVE_MAGIC   = 0x4B415052; // 'RPAK'
+constexpr uint32 RESOURCE_ARCHIVE_VERSION = 1;
+
+// NOTE: Entry data starts on this boundary so cooked files can be used straight out of the mapping
+constexpr uint64 RESOURCE_ARCHIVE_ALIGNMENT = 16;
+
+// NOTE: Directories packed by --pack, paths inside the archive are relative to the working directory like the loose ones
+constexpr char * RESOURCE_ARCHIVE_ROOTS[] =
+{
+    "resources/objects",
+    "src/Shaders/bytecode",
+};
+
+// NOTE: LZ4 only pays off if it saves at least 1/8 of an entry, otherwise the entry is stored raw and can be
+//       read without a copy. Already compressed images usually end up raw
+constexpr uint32 RESOURCE_ARCHIVE_MIN_SAVING_SHIFT = 3;
+
+// NOTE: LZ4 block format limits
+constexpr uint32 LZ4_MIN_MATCH      = 4;
+constexpr uint32 LZ4_LAST_LITERALS  = 5;  // NOTE: The last 5 bytes are always literals
+constexpr uint32 LZ4_MATCH_LIMIT    = 12; // NOTE: No match may start in the last 12 bytes
+constexpr uint32 LZ4_MAX_OFFSET     = 65535;
+constexpr uint32 LZ4_HASH_BITS      = 16;
+
+//====================================================
+//      NOTE: Resource Archive Structs
+//====================================================
+
+enum ResourceCompression : uint32
+{
+    RESOURCE_COMPRESSION_NONE,
+    RESOURCE_COMPRESSION_LZ4,
+};
+
+/*
+  NOTE: File layout
+  [ResourceArchiveHeader][ResourceArchiveEntry * m_entryCount][path strings][entry data]...
+  Entries are sorted by path (strcmp order) so lookups are a binary search over the mapped index.
+  Paths are stored without terminator and always use forward slashes.
+ */
+struct ResourceArchiveHeader
+{
+    uint32 m_magic;
+    uint32 m_version;
+    uint32 m_entryCount;
+    uint32 m_reserved;
+    uint64 m_pathsOffset;
+    uint64 m_pathsSize;
+};
+
+struct ResourceArchiveEntry
+{
+    uint32 m_pathOffset; // NOTE: Relative to m_pathsOffset
+    uint32 m_pathLength;
+    uint32 m_compression; // NOTE: ResourceCompression
+    uint32 m_reserved;
+    int64  m_sourceTimestamp;
+    uint64 m_offset; // NOTE: Relative to the start of the archive
+    uint64 m_size; // NOTE: Uncompressed
+    uint64 m_storedSize;
+};
+
+struct ResourceArchive
+{
+    MappedFile              m_file;
+    ResourceArchiveHeader * m_header;
+    ResourceArchiveEntry  * m_entries;
+    char                  * m_paths;
+};
+
+// NOTE: One opened resource. m_data points into the archive mapping for raw entries, into m_file for loose
+//       files, or into an owned buffer for LZ4 entries. Trivially copyable, close it exactly once
+struct ResourceFile
+{
+    char *     m_data;
+    size_t     m_size;
+    MappedFile m_file;
+    bool       m_owned;
+};
+
+#define RESOURCE_ARCHIVE_H
+#endif //RESOURCE_ARCHIVE_H
@@ -0,0 +1,243 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "texture_cache.h"
+
+//====================================================
+//      NOTE: Texture Cache Functions
+//====================================================
+
+internal void GetTextureCachePath(const char * sourcePath, char * cachePath, uint32 cachePathSize)
+{
+    snprintf(cachePath, cachePathSize, "%s%s", sourcePath, TEXTURE_CACHE_EXTENSION);
+}
+
+// NOTE: Every texture is sampled as color, grey included, only alpha is linear
+internal bool IsSrgbChannel(uint32 channels, uint32 channel)
+{
+    return channel < std::min(channels, 3u);
+}
+
+// NOTE: stbi grey or rgba. RGB is padded to RGBA since three channel formats are rarely sampleable, and grey alpha
+//       is expanded too, an R8G8_SRGB image would decode its alpha as sRGB
+internal uint32 GetTextureChannelCount(int32 channelsInFile)
+{
+    return channelsInFile == 1 ? 1 : 4;
+}
+
+internal uint32 GetMipLevelCount(uint32 width, uint32 height)
+{
+    return (uint32)(std::floor(std::log2(std::max(width, height)))) + 1;
+}
+
+// NOTE: Fills levels with the tightly packed layout of a mip chain and returns its total size
+internal uint64 GetMipChainLayout(uint32 width, uint32 height, uint32 mipLevels, uint32 channels, TextureEncoding encoding, TextureCacheLevel * levels)
+{
+    uint64 offset = 0;
+    for (uint32 level = 0; level < mipLevels; level++)
+    {
+        levels[level].m_width  = std::max(width >> level, 1u);
+        levels[level].m_height = std::max(height >> level, 1u);
+        levels[level].m_offset = offset;
+
+        if (encoding == TEXTURE_ENCODING_RAW)
+        {
+            levels[level].m_size = (uint64)levels[level].m_width * levels[level].m_height * channels;
+        }
+        else
+        {
+            uint64 blocksX = (levels[level].m_width + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+            uint64 blocksY = (levels[level].m_height + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+            levels[level].m_size = blocksX * blocksY * GetBcBlockBytes(encoding);
+        }
+        offset += levels[level].m_size;
+    }
+    return offset;
+}
+
+internal real32 SrgbToLinear(real32 c)
+{
+    return c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+}
+
+internal uint8 LinearToSrgb8(real32 c)
+{
+    real32 s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+    return (uint8)(glm::clamp(s, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+// NOTE: 2x2 box filter in linear space, the same thing the blit chain in GenerateMipMaps approximates.
+//       Odd edges clamp, so the last row / column of an odd sized level is folded into its neighbour
+internal void DownsampleMipLevel(const uint8 * src, TextureCacheLevel srcLevel, uint8 * dst, TextureCacheLevel dstLevel,
+                                 uint32 channels, const real32 * srgbToLinear)
+{
+    for (uint32 y = 0; y < dstLevel.m_height; y++)
+    {
+        uint32 y0 = std::min(y * 2, srcLevel.m_height - 1);
+        uint32 y1 = std::min(y * 2 + 1, srcLevel.m_height - 1);
+
+        for (uint32 x = 0; x < dstLevel.m_width; x++)
+        {
+            uint32 x0 = std::min(x * 2, srcLevel.m_width - 1);
+            uint32 x1 = std::min(x * 2 + 1, srcLevel.m_width - 1);
+
+            const uint8 * taps[4] =
+            {
+                src + ((size_t)y0 * srcLevel.m_width + x0) * channels,
+                src + ((size_t)y0 * srcLevel.m_width + x1) * channels,
+                src + ((size_t)y1 * srcLevel.m_width + x0) * channels,
+                src + ((size_t)y1 * srcLevel.m_width + x1) * channels,
+            };
+
+            uint8 * out = dst + ((size_t)y * dstLevel.m_width + x) * channels;
+            for (uint32 c = 0; c < channels; c++)
+            {
+                // NOTE: Alpha is already linear
+                if (IsSrgbChannel(channels, c))
+                {
+                    real32 sum = srgbToLinear[taps[0][c]] + srgbToLinear[taps[1][c]] + srgbToLinear[taps[2][c]] + srgbToLinear[taps[3][c]];
+                    out[c] = LinearToSrgb8(sum * 0.25f);
+                }
+                else
+                {
+                    out[c] = (uint8)((taps[0][c] + taps[1][c] + taps[2][c] + taps[3][c] + 2) / 4);
+                }
+            }
+        }
+    }
+}
+
+// NOTE: Validates an already read cooked texture of sourcePath and takes ownership of file, which is closed if it
+//       fails. Fails if it was cooked with a different compression setting, or if checkSource is set and the source
+//       changed since it was written
+internal bool MapTextureCache(const char * sourcePath, ResourceFile file, bool compressed, bool checkSource, TextureCacheView * view)
+{
+    SM_ASSERT(view, "No texture cache view provided!");
+    *view = {};
+
+    char cachePath[300];
+    GetTextureCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    if (!file.m_data || file.m_size < sizeof(TextureCacheHeader))
+    {
+        CloseResource(&file);
+        return false;
+    }
+
+    TextureCacheHeader * header = (TextureCacheHeader *)file.m_data;
+    bool valid = header->m_magic == TEXTURE_CACHE_MAGIC &&
+        header->m_version == TEXTURE_CACHE_VERSION &&
+        header->m_mipLevels > 0 && header->m_mipLevels <= TEXTURE_CACHE_MAX_MIPS &&
+        (header->m_channels == 1 || header->m_channels == 4) &&
+        header->m_encoding <= TEXTURE_ENCODING_BC7 &&
+        (header->m_encoding != TEXTURE_ENCODING_RAW) == compressed &&
+        (!checkSource || (header->m_sourceTimestamp == GetResourceTimestamp(sourcePath) &&
+                          header->m_sourceSize == GetResourceSize(sourcePath))) &&
+        file.m_size == sizeof(TextureCacheHeader) + header->m_mipLevels * sizeof(TextureCacheLevel) + header->m_dataSize;
+
+    if (!valid)
+    {
+        SM_TRACE("texture cache %s is stale", cachePath);
+        CloseResource(&file);
+        return false;
+    }
+
+    view->m_file   = file;
+    view->m_header = header;
+    view->m_levels = (TextureCacheLevel *)(file.m_data + sizeof(TextureCacheHeader));
+    view->m_pixels = (uint8 *)(file.m_data + sizeof(TextureCacheHeader) + header->m_mipLevels * sizeof(TextureCacheLevel));
+
+    return true;
+}
+
+// NOTE: Maps the cooked texture of sourcePath. Fails if there is none or it is stale, see above
+internal bool MapTextureCache(const char * sourcePath, bool compressed, bool checkSource, TextureCacheView * view)
+{
+    char cachePath[300];
+    GetTextureCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    return MapTextureCache(sourcePath, OpenResource(cachePath, FILE_ACCESS_SEQUENTIAL), compressed, checkSource, view);
+}
+
+// NOTE: Builds the full mip chain from the decoded base level, block compresses it if asked to, and writes it
+//       next to the source
+internal bool WriteTextureCache(const char * sourcePath, const uint8 * pixels, uint32 width, uint32 height, uint32 channels, bool compress)
+{
+    uint32 mipLevels = GetMipLevelCount(width, height);
+    SM_ASSERT(mipLevels <= TEXTURE_CACHE_MAX_MIPS, "texture %s is too large to cook!", sourcePath);
+
+    TextureCacheLevel levels[TEXTURE_CACHE_MAX_MIPS] = {};
+    uint64 dataSize = GetMipChainLayout(width, height, mipLevels, channels, TEXTURE_ENCODING_RAW, levels);
+
+    std::vector<uint8> chain(dataSize);
+    memcpy(chain.data(), pixels, levels[0].m_size);
+
+    real32 srgbToLinear[256];
+    for (uint32 i = 0; i < 256; i++)
+    {
+        srgbToLinear[i] = SrgbToLinear(i / 255.0f);
+    }
+
+    for (uint32 level = 1; level < mipLevels; level++)
+    {
+        DownsampleMipLevel(chain.data() + levels[level - 1].m_offset, levels[level - 1],
+                           chain.data() + levels[level].m_offset, levels[level], channels, srgbToLinear);
+    }
+
+    TextureEncoding encoding = TEXTURE_ENCODING_RAW;
+    if (compress)
+    {
+        encoding = ChooseTextureEncoding(pixels, width, height, channels);
+
+        TextureCacheLevel compressedLevels[TEXTURE_CACHE_MAX_MIPS] = {};
+        dataSize = GetMipChainLayout(width, height, mipLevels, channels, encoding, compressedLevels);
+
+        std::vector<uint8> compressedChain(dataSize);
+        for (uint32 level = 0; level < mipLevels; level++)
+        {
+            CompressMipLevel(chain.data() + levels[level].m_offset, levels[level].m_width, levels[level].m_height,
+                             channels, encoding, compressedChain.data() + compressedLevels[level].m_offset);
+        }
+
+        chain = std::move(compressedChain);
+        memcpy(levels, compressedLevels, sizeof(levels));
+    }
+
+    char cachePath[300];
+    GetTextureCachePath(sourcePath, cachePath, ArrayCount(cachePath));
+
+    auto file = fopen(cachePath, "wb");
+    if (!file)
+    {
+        SM_WARN("Failed to write texture cache: %s", cachePath);
+        return false;
+    }
+
+    TextureCacheHeader header = {};
+    header.m_version         = TEXTURE_CACHE_VERSION;
+    header.m_sourceTimestamp = GetResourceTimestamp(sourcePath);
+    header.m_sourceSize      = GetResourceSize(sourcePath);
+    header.m_width           = width;
+    header.m_height          = height;
+    header.m_mipLevels       = mipLevels;
+    header.m_channels        = GetEncodingChannelCount(encoding, channels);
+    header.m_encoding        = encoding;
+    header.m_dataSize        = dataSize;
+
+    // NOTE: The magic is written last so a half written cache never validates
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(levels, sizeof(TextureCacheLevel), mipLevels, file);
+    fwrite(chain.data(), 1, chain.size(), file);
+
+    header.m_magic = TEXTURE_CACHE_MAGIC;
+    fseek(file, 0, SEEK_SET);
+    fwrite(&header, sizeof(header), 1, file);
+
+    fclose(file);
+    return true;
+}
@@ -0,0 +1,65 @@
+/* date = October 18th 2026 3:40 pm */
+
+#ifndef TEXTURE_CACHE_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+#include "resource_archive.h"
+#include "texture_compression.h"
+
+#include <algorithm>
+
+//====================================================
+//      NOTE: Texture Cache Constexpr
+//====================================================
+
+// NOTE: The cooked texture lives next to its source, e.g. cyborg_diffuse.png -> cyborg_diffuse.png.tex
+constexpr char * TEXTURE_CACHE_EXTENSION = ".tex";
+constexpr uint32 TEXTURE_CACHE_MAGIC     = 0x43584554; // 'TEXC'
+constexpr uint32 TEXTURE_CACHE_VERSION   = 3; // NOTE: Bump whenever the cooked pixels change
+constexpr uint32 TEXTURE_CACHE_MAX_MIPS  = 16;
+
+//====================================================
+//      NOTE: Texture Cache Structs
+//====================================================
+
+/*
+  NOTE: File layout, loosely modelled on KTX2
+  [TextureCacheHeader][TextureCacheLevel * m_mipLevels][level 0 pixels][level 1 pixels]...
+  Every level is tightly packed, either raw at m_channels bytes per texel (R8 or RGBA8) or as rows of
+  4x4 BC blocks, so the whole pixel block can be copied into one staging buffer and uploaded with a single
+  vkCmdCopyBufferToImage.
+ */
+struct TextureCacheHeader
+{
+    uint32 m_magic;
+    uint32 m_version;
+    int64  m_sourceTimestamp;
+    int64  m_sourceSize;
+    uint32 m_width;
+    uint32 m_height;
+    uint32 m_mipLevels;
+    uint32 m_channels;
+    uint32 m_encoding; // NOTE: TextureEncoding
+    uint32 m_reserved;
+    uint64 m_dataSize;
+};
+
+struct TextureCacheLevel
+{
+    uint32 m_width;
+    uint32 m_height;
+    uint64 m_offset; // NOTE: Relative to the start of the pixel block
+    uint64 m_size;
+};
+
+struct TextureCacheView
+{
+    ResourceFile         m_file;
+    TextureCacheHeader * m_header;
+    TextureCacheLevel  * m_levels;
+    uint8              * m_pixels;
+};
+
+#define TEXTURE_CACHE_H
+#endif //TEXTURE_CACHE_H
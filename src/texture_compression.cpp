@@ -0,0 +1,514 @@
+/* ========================================================================
+   $File: $
+   $Date: $
+   $Revision: $
+   $Creator: Junjie Mao $
+   $Notice: $
+   ======================================================================== */
+
+#include "texture_compression.h"
+
+/*
+  NOTE: A small block compression encoder, run when a texture is cooked.
+  - BC1: opaque color, endpoints on the principal axis of the block, 4 color mode only
+  - BC7: color with alpha, mode 6 only (one subset, RGBA endpoints with p-bits, 4 bit indices)
+  Grey images are color too and go to BC1 with the grey in all three channels. BC4 would cost the same 8 bytes
+  per block, but it has no sRGB variant.
+  Quality is below a proper offline compressor, but it is fast enough to run on first load. The decoders
+  only understand what the encoder writes and are used when the device can not sample BC formats.
+ */
+
+//====================================================
+//      NOTE: Texture Compression Helpers
+//====================================================
+
+internal uint32 GetBcBlockBytes(TextureEncoding encoding)
+{
+    switch (encoding)
+    {
+        case TEXTURE_ENCODING_BC1: return 8;
+        case TEXTURE_ENCODING_BC7: return 16;
+        default: return 0;
+    }
+}
+
+// NOTE: What the encoding decodes back to, RAW keeps whatever the source had
+internal uint32 GetEncodingChannelCount(TextureEncoding encoding, uint32 rawChannels)
+{
+    switch (encoding)
+    {
+        case TEXTURE_ENCODING_BC1:
+        case TEXTURE_ENCODING_BC7: return 4;
+        default: return rawChannels;
+    }
+}
+
+internal TextureEncoding ChooseTextureEncoding(const uint8 * pixels, uint32 width, uint32 height, uint32 channels)
+{
+    if (channels == 1)
+    {
+        return TEXTURE_ENCODING_BC1;
+    }
+
+    // NOTE: BC1 has no usable alpha, anything that is not fully opaque needs BC7
+    uint64 texelCount = (uint64)width * height;
+    for (uint64 i = 0; i < texelCount; i++)
+    {
+        if (pixels[i * 4 + 3] != 255)
+        {
+            return TEXTURE_ENCODING_BC7;
+        }
+    }
+    return TEXTURE_ENCODING_BC1;
+}
+
+// NOTE: Edge texels are replicated for levels that are not a multiple of the block size, and grey into rgb
+internal BcBlock LoadBcBlock(const uint8 * src, uint32 width, uint32 height, uint32 channels, uint32 blockX, uint32 blockY)
+{
+    BcBlock block = {};
+    for (uint32 y = 0; y < BC_BLOCK_SIZE; y++)
+    {
+        uint32 srcY = std::min(blockY * BC_BLOCK_SIZE + y, height - 1);
+        for (uint32 x = 0; x < BC_BLOCK_SIZE; x++)
+        {
+            uint32 srcX = std::min(blockX * BC_BLOCK_SIZE + x, width - 1);
+            const uint8 * texel = src + ((size_t)srcY * width + srcX) * channels;
+
+            uint8 * out = block.m_texels[y * BC_BLOCK_SIZE + x];
+            for (uint32 c = 0; c < 3; c++)
+            {
+                out[c] = texel[std::min(c, channels - 1)];
+            }
+            out[3] = channels == 4 ? texel[3] : 255;
+        }
+    }
+    return block;
+}
+
+internal void StoreBcBlock(const BcBlock & block, uint8 * dst, uint32 width, uint32 height, uint32 channels, uint32 blockX, uint32 blockY)
+{
+    for (uint32 y = 0; y < BC_BLOCK_SIZE; y++)
+    {
+        uint32 dstY = blockY * BC_BLOCK_SIZE + y;
+        for (uint32 x = 0; x < BC_BLOCK_SIZE; x++)
+        {
+            uint32 dstX = blockX * BC_BLOCK_SIZE + x;
+            if (dstX >= width || dstY >= height)
+            {
+                continue;
+            }
+
+            uint8 * texel = dst + ((size_t)dstY * width + dstX) * channels;
+            for (uint32 c = 0; c < channels; c++)
+            {
+                texel[c] = block.m_texels[y * BC_BLOCK_SIZE + x][c];
+            }
+        }
+    }
+}
+
+// NOTE: Fits a line through the block with a few power iterations on its covariance, and returns the two
+//       extreme points of the texels projected onto it
+internal void FitBcEndpoints(const BcBlock & block, uint32 dims, real32 * e0, real32 * e1)
+{
+    real32 mean[4] = {};
+    for (uint32 i = 0; i < 16; i++)
+    {
+        for (uint32 c = 0; c < dims; c++)
+        {
+            mean[c] += block.m_texels[i][c];
+        }
+    }
+    for (uint32 c = 0; c < dims; c++)
+    {
+        mean[c] /= 16.0f;
+    }
+
+    real32 covariance[4][4] = {};
+    for (uint32 i = 0; i < 16; i++)
+    {
+        for (uint32 r = 0; r < dims; r++)
+        {
+            for (uint32 c = 0; c < dims; c++)
+            {
+                covariance[r][c] += (block.m_texels[i][r] - mean[r]) * (block.m_texels[i][c] - mean[c]);
+            }
+        }
+    }
+
+    real32 axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+    for (uint32 iteration = 0; iteration < 8; iteration++)
+    {
+        real32 next[4] = {};
+        real32 length = 0.0f;
+        for (uint32 r = 0; r < dims; r++)
+        {
+            for (uint32 c = 0; c < dims; c++)
+            {
+                next[r] += covariance[r][c] * axis[c];
+            }
+            length = std::max(length, fabsf(next[r]));
+        }
+
+        if (length < 1e-6f)
+        {
+            break;
+        }
+        for (uint32 c = 0; c < dims; c++)
+        {
+            axis[c] = next[c] / length;
+        }
+    }
+
+    real32 minT = FLT_MAX;
+    real32 maxT = -FLT_MAX;
+    real32 axisLength2 = 0.0f;
+    for (uint32 c = 0; c < dims; c++)
+    {
+        axisLength2 += axis[c] * axis[c];
+    }
+
+    for (uint32 i = 0; i < 16; i++)
+    {
+        real32 t = 0.0f;
+        for (uint32 c = 0; c < dims; c++)
+        {
+            t += (block.m_texels[i][c] - mean[c]) * axis[c];
+        }
+        minT = std::min(minT, t);
+        maxT = std::max(maxT, t);
+    }
+
+    for (uint32 c = 0; c < dims; c++)
+    {
+        real32 scale = axisLength2 > 0.0f ? axis[c] / axisLength2 : 0.0f;
+        e0[c] = glm::clamp(mean[c] + minT * scale, 0.0f, 255.0f);
+        e1[c] = glm::clamp(mean[c] + maxT * scale, 0.0f, 255.0f);
+    }
+}
+
+internal uint32 BcDistance2(const uint8 * a, const uint8 * b, uint32 dims)
+{
+    uint32 result = 0;
+    for (uint32 c = 0; c < dims; c++)
+    {
+        int32 d = (int32)a[c] - (int32)b[c];
+        result += (uint32)(d * d);
+    }
+    return result;
+}
+
+//====================================================
+//      NOTE: BC1
+//====================================================
+
+internal uint16 PackRgb565(const real32 * rgb)
+{
+    uint32 r = (uint32)(rgb[0] * 31.0f / 255.0f + 0.5f);
+    uint32 g = (uint32)(rgb[1] * 63.0f / 255.0f + 0.5f);
+    uint32 b = (uint32)(rgb[2] * 31.0f / 255.0f + 0.5f);
+    return (uint16)((r << 11) | (g << 5) | b);
+}
+
+internal void UnpackRgb565(uint16 color, uint8 * rgb)
+{
+    uint32 r = (color >> 11) & 31;
+    uint32 g = (color >> 5) & 63;
+    uint32 b = color & 31;
+    rgb[0] = (uint8)((r << 3) | (r >> 2));
+    rgb[1] = (uint8)((g << 2) | (g >> 4));
+    rgb[2] = (uint8)((b << 3) | (b >> 2));
+}
+
+internal void GetBc1Palette(uint16 color0, uint16 color1, uint8 palette[4][4])
+{
+    UnpackRgb565(color0, palette[0]);
+    UnpackRgb565(color1, palette[1]);
+    for (uint32 c = 0; c < 3; c++)
+    {
+        if (color0 > color1)
+        {
+            palette[2][c] = (uint8)((2 * palette[0][c] + palette[1][c]) / 3);
+            palette[3][c] = (uint8)((palette[0][c] + 2 * palette[1][c]) / 3);
+        }
+        else
+        {
+            palette[2][c] = (uint8)((palette[0][c] + palette[1][c]) / 2);
+            palette[3][c] = 0;
+        }
+    }
+    for (uint32 i = 0; i < 4; i++)
+    {
+        palette[i][3] = 255;
+    }
+}
+
+internal void EncodeBc1Block(const BcBlock & block, uint8 * dst)
+{
+    real32 e0[4], e1[4];
+    FitBcEndpoints(block, 3, e0, e1);
+
+    // NOTE: The four color mode needs color0 > color1, equal endpoints just use index 0 everywhere
+    uint16 color0 = PackRgb565(e1);
+    uint16 color1 = PackRgb565(e0);
+    if (color0 < color1)
+    {
+        uint16 temp = color0;
+        color0 = color1;
+        color1 = temp;
+    }
+
+    uint8 palette[4][4];
+    GetBc1Palette(color0, color1, palette);
+
+    uint32 indices = 0;
+    if (color0 != color1)
+    {
+        for (uint32 i = 0; i < 16; i++)
+        {
+            uint32 best = 0;
+            uint32 bestDistance = UINT32_MAX;
+            for (uint32 p = 0; p < 4; p++)
+            {
+                uint32 distance = BcDistance2(block.m_texels[i], palette[p], 3);
+                if (distance < bestDistance)
+                {
+                    best = p;
+                    bestDistance = distance;
+                }
+            }
+            indices |= best << (i * 2);
+        }
+    }
+
+    memcpy(dst + 0, &color0, 2);
+    memcpy(dst + 2, &color1, 2);
+    memcpy(dst + 4, &indices, 4);
+}
+
+internal BcBlock DecodeBc1Block(const uint8 * src)
+{
+    uint16 color0, color1;
+    uint32 indices;
+    memcpy(&color0, src + 0, 2);
+    memcpy(&color1, src + 2, 2);
+    memcpy(&indices, src + 4, 4);
+
+    uint8 palette[4][4];
+    GetBc1Palette(color0, color1, palette);
+
+    BcBlock block = {};
+    for (uint32 i = 0; i < 16; i++)
+    {
+        memcpy(block.m_texels[i], palette[(indices >> (i * 2)) & 3], 4);
+    }
+    return block;
+}
+
+//====================================================
+//      NOTE: BC7 Mode 6
+//====================================================
+
+internal void WriteBcBits(BcBitStream * stream, uint32 value, uint32 bitCount)
+{
+    for (uint32 i = 0; i < bitCount; i++, stream->m_position++)
+    {
+        if ((value >> i) & 1)
+        {
+            stream->m_bytes[stream->m_position / 8] |= (uint8)(1 << (stream->m_position % 8));
+        }
+    }
+}
+
+internal uint32 ReadBcBits(BcBitStream * stream, uint32 bitCount)
+{
+    uint32 value = 0;
+    for (uint32 i = 0; i < bitCount; i++, stream->m_position++)
+    {
+        value |= (uint32)((stream->m_bytes[stream->m_position / 8] >> (stream->m_position % 8)) & 1) << i;
+    }
+    return value;
+}
+
+// NOTE: Mode 6 endpoints are 7 bits per channel plus one p-bit shared by the whole endpoint
+internal void QuantizeBc7Endpoint(const real32 * endpoint, uint8 * quantized, uint32 * pBit)
+{
+    real32 bestError = FLT_MAX;
+    for (uint32 p = 0; p < 2; p++)
+    {
+        uint8 candidate[4];
+        real32 error = 0.0f;
+        for (uint32 c = 0; c < 4; c++)
+        {
+            int32 q = (int32)((endpoint[c] - p) / 2.0f + 0.5f);
+            candidate[c] = (uint8)glm::clamp(q, 0, 127);
+
+            real32 d = (real32)(candidate[c] * 2 + p) - endpoint[c];
+            error += d * d;
+        }
+
+        if (error < bestError)
+        {
+            bestError = error;
+            memcpy(quantized, candidate, 4);
+            *pBit = p;
+        }
+    }
+}
+
+internal void GetBc7Palette(const uint8 * q0, uint32 p0, const uint8 * q1, uint32 p1, uint8 palette[16][4])
+{
+    for (uint32 i = 0; i < 16; i++)
+    {
+        for (uint32 c = 0; c < 4; c++)
+        {
+            uint32 v0 = q0[c] * 2 + p0;
+            uint32 v1 = q1[c] * 2 + p1;
+            palette[i][c] = (uint8)(((64 - BC7_WEIGHTS4[i]) * v0 + BC7_WEIGHTS4[i] * v1 + 32) >> 6);
+        }
+    }
+}
+
+internal void EncodeBc7Block(const BcBlock & block, uint8 * dst)
+{
+    real32 e0[4], e1[4];
+    FitBcEndpoints(block, 4, e0, e1);
+
+    uint8 q0[4], q1[4];
+    uint32 p0, p1;
+    QuantizeBc7Endpoint(e0, q0, &p0);
+    QuantizeBc7Endpoint(e1, q1, &p1);
+
+    uint8 palette[16][4];
+    GetBc7Palette(q0, p0, q1, p1, palette);
+
+    uint32 indices[16];
+    for (uint32 i = 0; i < 16; i++)
+    {
+        uint32 bestDistance = UINT32_MAX;
+        for (uint32 p = 0; p < 16; p++)
+        {
+            uint32 distance = BcDistance2(block.m_texels[i], palette[p], 4);
+            if (distance < bestDistance)
+            {
+                indices[i] = p;
+                bestDistance = distance;
+            }
+        }
+    }
+
+    // NOTE: The anchor index is stored without its top bit, so swap the endpoints if it is set
+    if (indices[0] & 8)
+    {
+        uint8 tempQ[4];
+        memcpy(tempQ, q0, 4);
+        memcpy(q0, q1, 4);
+        memcpy(q1, tempQ, 4);
+
+        uint32 tempP = p0;
+        p0 = p1;
+        p1 = tempP;
+
+        for (uint32 i = 0; i < 16; i++)
+        {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(dst, 0, 16);
+    BcBitStream stream = { dst, 0 };
+    WriteBcBits(&stream, 1 << 6, 7);
+    for (uint32 c = 0; c < 4; c++)
+    {
+        WriteBcBits(&stream, q0[c], 7);
+        WriteBcBits(&stream, q1[c], 7);
+    }
+    WriteBcBits(&stream, p0, 1);
+    WriteBcBits(&stream, p1, 1);
+    for (uint32 i = 0; i < 16; i++)
+    {
+        WriteBcBits(&stream, indices[i], i == 0 ? 3 : 4);
+    }
+}
+
+internal BcBlock DecodeBc7Block(const uint8 * src)
+{
+    BcBlock block = {};
+    BcBitStream stream = { (uint8 *)src, 0 };
+
+    uint32 mode = ReadBcBits(&stream, 7);
+    SM_ASSERT(mode == (1 << 6), "only BC7 mode 6 blocks can be decoded!");
+
+    uint8 q0[4], q1[4];
+    for (uint32 c = 0; c < 4; c++)
+    {
+        q0[c] = (uint8)ReadBcBits(&stream, 7);
+        q1[c] = (uint8)ReadBcBits(&stream, 7);
+    }
+    uint32 p0 = ReadBcBits(&stream, 1);
+    uint32 p1 = ReadBcBits(&stream, 1);
+
+    uint8 palette[16][4];
+    GetBc7Palette(q0, p0, q1, p1, palette);
+
+    for (uint32 i = 0; i < 16; i++)
+    {
+        memcpy(block.m_texels[i], palette[ReadBcBits(&stream, i == 0 ? 3 : 4)], 4);
+    }
+    return block;
+}
+
+//====================================================
+//      NOTE: Texture Compression Functions
+//====================================================
+
+// NOTE: Compresses one mip level of raw texels with channels per texel into dst
+internal void CompressMipLevel(const uint8 * src, uint32 width, uint32 height, uint32 channels, TextureEncoding encoding, uint8 * dst)
+{
+    uint32 blocksX = (width + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+    uint32 blocksY = (height + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+    uint32 blockBytes = GetBcBlockBytes(encoding);
+
+    for (uint32 blockY = 0; blockY < blocksY; blockY++)
+    {
+        for (uint32 blockX = 0; blockX < blocksX; blockX++)
+        {
+            BcBlock block = LoadBcBlock(src, width, height, channels, blockX, blockY);
+            uint8 * out = dst + ((size_t)blockY * blocksX + blockX) * blockBytes;
+
+            switch (encoding)
+            {
+                case TEXTURE_ENCODING_BC1: EncodeBc1Block(block, out); break;
+                case TEXTURE_ENCODING_BC7: EncodeBc7Block(block, out); break;
+                default: SM_ASSERT(false, "not a block compressed encoding!");
+            }
+        }
+    }
+}
+
+// NOTE: Expands one compressed mip level back to GetEncodingChannelCount(encoding) channels per texel
+internal void DecompressMipLevel(const uint8 * src, uint32 width, uint32 height, TextureEncoding encoding, uint8 * dst)
+{
+    uint32 blocksX = (width + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+    uint32 blocksY = (height + BC_BLOCK_SIZE - 1) / BC_BLOCK_SIZE;
+    uint32 blockBytes = GetBcBlockBytes(encoding);
+    uint32 channels = GetEncodingChannelCount(encoding, 4);
+
+    for (uint32 blockY = 0; blockY < blocksY; blockY++)
+    {
+        for (uint32 blockX = 0; blockX < blocksX; blockX++)
+        {
+            const uint8 * in = src + ((size_t)blockY * blocksX + blockX) * blockBytes;
+
+            BcBlock block = {};
+            switch (encoding)
+            {
+                case TEXTURE_ENCODING_BC1: block = DecodeBc1Block(in); break;
+                case TEXTURE_ENCODING_BC7: block = DecodeBc7Block(in); break;
+                default: SM_ASSERT(false, "not a block compressed encoding!");
+            }
+
+            StoreBcBlock(block, dst, width, height, channels, blockX, blockY);
+        }
+    }
+}
@@ -0,0 +1,38 @@
+/* date = October 18th 2026 5:15 pm */
+
+#ifndef TEXTURE_COMPRESSION_H
+
+#include "engine_lib.h"
+#include "render_interface.h"
+
+#include <algorithm>
+#include <cfloat>
+
+//====================================================
+//      NOTE: Texture Compression Constexpr
+//====================================================
+
+constexpr uint32 BC_BLOCK_SIZE = 4; // NOTE: Every BC format encodes 4x4 texel blocks
+
+// NOTE: Interpolation weights of the 4 bit BC7 index, out of 64
+constexpr uint32 BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+//====================================================
+//      NOTE: Texture Compression Structs
+//====================================================
+
+// NOTE: One 4x4 block, always expanded to four channels while encoding
+struct BcBlock
+{
+    uint8 m_texels[16][4];
+};
+
+// NOTE: Little endian bit stream over one BC7 block
+struct BcBitStream
+{
+    uint8 * m_bytes;
+    uint32  m_position;
+};
+
+#define TEXTURE_COMPRESSION_H
+#endif //TEXTURE_COMPRESSION_H
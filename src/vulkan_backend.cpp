@@ -18,21 +18,43 @@ internal VkSampleCountFlagBits GetMaxUsableSampleCount(VkPhysicalDevice physical
     return VK_SAMPLE_COUNT_1_BIT;
     }
 
-internal VkVertexInputBindingDescription GetVertexBindingDescription()
+internal VkVertexInputBindingDescription GetVertexBindingDescription(VertexFormat vertexFormat)
 {
     VkVertexInputBindingDescription bindingDescription = {};
     
     bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(Vertex);
+    bindingDescription.stride = vertexFormat == VERTEX_FORMAT_PACKED ? sizeof(PackedVertex) : sizeof(Vertex);
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
     
     return bindingDescription;
 }
 
-internal Array<VkVertexInputAttributeDescription, 3> GetVertexAttributeDescriptions()
+internal Array<VkVertexInputAttributeDescription, 3> GetVertexAttributeDescriptions(VertexFormat vertexFormat)
 {
     Array<VkVertexInputAttributeDescription, 3> attributeDescriptions(3);
     
+    if (vertexFormat == VERTEX_FORMAT_PACKED)
+    {
+        // NOTE: Three component 16 bit formats are rarely vertex fetchable, so the position is read as four and its
+        //       w is the normal bytes, which the shader ignores. The normal takes the location of the float color
+        attributeDescriptions[0].binding = 0;
+        attributeDescriptions[0].location = 0;
+        attributeDescriptions[0].format = VK_FORMAT_R16G16B16A16_UNORM;
+        attributeDescriptions[0].offset = offsetof(PackedVertex, m_pos);
+        
+        attributeDescriptions[1].binding = 0;
+        attributeDescriptions[1].location = 1;
+        attributeDescriptions[1].format = VK_FORMAT_R8G8_SNORM;
+        attributeDescriptions[1].offset = offsetof(PackedVertex, m_normal);
+        
+        attributeDescriptions[2].binding = 0;
+        attributeDescriptions[2].location = 2;
+        attributeDescriptions[2].format = VK_FORMAT_R16G16_SFLOAT;
+        attributeDescriptions[2].offset = offsetof(PackedVertex, m_texCoord);
+        
+        return attributeDescriptions;
+    }
+    
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
     attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
@@ -51,10 +73,11 @@ internal Array<VkVertexInputAttributeDescription, 3> GetVertexAttributeDescripti
     return attributeDescriptions;
 }
 
-internal VkFormat FindSupportedFormat(VkPhysicalDevice physicalDevice,
-                                      VkFormat * formats, uint32 formatCount,
-                                      VkImageTiling tiling,
-                                      VkFormatFeatureFlags features)
+// NOTE: Returns VK_FORMAT_UNDEFINED instead of asserting, for formats that are optional
+internal VkFormat TryFindSupportedFormat(VkPhysicalDevice physicalDevice,
+                                         VkFormat * formats, uint32 formatCount,
+                                         VkImageTiling tiling,
+                                         VkFormatFeatureFlags features)
 {
     for (uint32 i = 0; i < formatCount; i++)
     {
@@ -72,9 +95,27 @@ internal VkFormat FindSupportedFormat(VkPhysicalDevice physicalDevice,
         }
         
     }
-    SM_ASSERT(false, "failed to find supported format");
     
-    return (VkFormat)0;
+    return VK_FORMAT_UNDEFINED;
+}
+
+internal VkFormat FindSupportedFormat(VkPhysicalDevice physicalDevice,
+                                      VkFormat * formats, uint32 formatCount,
+                                      VkImageTiling tiling,
+                                      VkFormatFeatureFlags features)
+{
+    VkFormat format = TryFindSupportedFormat(physicalDevice, formats, formatCount, tiling, features);
+    SM_ASSERT(format != VK_FORMAT_UNDEFINED, "failed to find supported format");
+    
+    return format;
+}
+
+internal bool IsTextureCompressionBCSupported(VkPhysicalDevice physicalDevice)
+{
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    
+    return supportedFeatures.textureCompressionBC == VK_TRUE;
 }
 
 internal VkFormat FindDepthFormat(VkPhysicalDevice physicalDevice)
@@ -96,9 +137,24 @@ internal QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurface
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
     
+    bool transferOnly = false;
     for (int i = 0; i < queueFamilies.size(); i++)
     {
         const auto & queueFamily = queueFamilies[i];
+        
+        // NOTE: Graphics and compute families can transfer too, but only the others run beside the frame. Small mips
+        //       are copied whole, so the family has to take copies of any extent
+        VkExtent3D granularity = queueFamily.minImageTransferGranularity;
+        bool anyExtent = granularity.width == 1 && granularity.height == 1 && granularity.depth == 1;
+        if ((queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+            anyExtent && !transferOnly)
+        {
+            indices.m_transferFamily = i;
+            transferOnly = !(queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT);
+        }
+        
+        if (indices.IsComplete()) continue;
+        
         if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT)
         {
             indices.m_graphicsFamily = i;            
@@ -110,8 +166,6 @@ internal QueueFamilyIndices FindQueueFamilies(VkPhysicalDevice device, VkSurface
         {
             indices.m_presentFamily = i;
         }
-        
-        if (indices.IsComplete()) break;
     }
     
     return indices;
@@ -387,14 +441,20 @@ internal VkDevice CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurface
     
     QueueFamilyIndices indices = FindQueueFamilies(physicalDevice, surface);
     
-    Array<VkDeviceQueueCreateInfo, 2> queueCreateInfos;
-    Array<uint32, 2> uniqueQueueFamilies;
+    Array<VkDeviceQueueCreateInfo, 3> queueCreateInfos;
+    Array<uint32, 3> uniqueQueueFamilies;
     
     uniqueQueueFamilies.Add(indices.m_graphicsFamily.value());
     if (indices.m_presentFamily.value() != indices.m_graphicsFamily.value())
     {
         uniqueQueueFamilies.Add(indices.m_presentFamily.value());
     }
+    // NOTE: Never the graphics family, but it may be the one that presents
+    if (USE_TRANSFER_QUEUE && indices.m_transferFamily.has_value() &&
+        indices.m_transferFamily.value() != indices.m_presentFamily.value())
+    {
+        uniqueQueueFamilies.Add(indices.m_transferFamily.value());
+    }
     
     float queuePriority = 1.0f;
     for (uint32 i = 0; i < uniqueQueueFamilies.count; i++)
@@ -412,6 +472,7 @@ internal VkDevice CreateLogicalDevice(VkPhysicalDevice physicalDevice, VkSurface
     VkPhysicalDeviceFeatures deviceFeatures{};
     deviceFeatures.samplerAnisotropy = VK_TRUE;
     deviceFeatures.sampleRateShading = VK_TRUE; // enable sample shading feature for the device
+    deviceFeatures.textureCompressionBC = IsTextureCompressionBCSupported(physicalDevice) ? VK_TRUE : VK_FALSE; // NOTE: Optional, BC textures are decoded on the CPU without it
     
     VkDeviceCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
@@ -549,17 +610,15 @@ internal VkImageView CreateImageView(VkDevice device,
                                      VkImage image,
                                      VkFormat format,
                                      VkImageAspectFlags aspectFlags,
-                                     uint32 mipLevels)
+                                     uint32 mipLevels,
+                                     VkComponentMapping components = {})
 {
     VkImageViewCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     createInfo.image = image;
     createInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
     createInfo.format = format;
-    createInfo.components.r = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.g = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.b = VK_COMPONENT_SWIZZLE_IDENTITY;
-    createInfo.components.a = VK_COMPONENT_SWIZZLE_IDENTITY;
+    createInfo.components = components; // NOTE: Zero is VK_COMPONENT_SWIZZLE_IDENTITY
     createInfo.subresourceRange.aspectMask = aspectFlags;
     createInfo.subresourceRange.baseMipLevel = 0;
     createInfo.subresourceRange.levelCount = mipLevels;
@@ -587,23 +646,31 @@ internal std::vector<VkImageView> CreateImageViews(std::vector<VkImage> & swapCh
     return result;
 }
 
-internal VkImageView CreateTextureImageView(VkDevice device, VkImage image, uint32 mipLevels)
+internal VkImageView CreateTextureImageView(VkDevice device, VkImage image, VkFormat format, uint32 mipLevels)
 {
+    // NOTE: Grey textures read back the same as if they had been expanded to RGBA
+    VkComponentMapping components = {};
+    if (format == VK_FORMAT_R8_SRGB)
+    {
+        components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_ONE };
+    }
     
-    VkImageView imageView = CreateImageView(device, image, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+    VkImageView imageView = CreateImageView(device, image, format, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels, components);
     
     return imageView;
 }
 
 // IMPORTANT: Make sure the byte code is null terminated
-internal VkShaderModule CreateShaderModule(VkDevice device, std::vector<char> & code)
+// NOTE: SPIR-V is read straight out of the mapping, which is at least 4 byte aligned like pCode needs
+internal VkShaderModule CreateShaderModule(VkDevice device, Span<const char> code)
 {
-    SM_ASSERT(code.size() > 0, "file readed are empty");
+    SM_ASSERT(!code.IsEmpty(), "file readed are empty");
+    SM_ASSERT(((uintptr_t)code.elements & 3) == 0, "SPIR-V is not 4 byte aligned");
     
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size() - 1;
-    createInfo.pCode = (uint32_t *)code.data();
+    createInfo.codeSize = code.count;
+    createInfo.pCode = (const uint32_t *)code.elements;
     
     VkShaderModule result;
     
@@ -630,14 +697,17 @@ internal VkShaderModule CreateShaderModule(VkDevice device, std::vector<char> &
   ==================================================================
 */
 internal CreateGraphicsPipelineResult
-CreateGraphicsPipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkDescriptorSetLayout descriptorSetLayout, VkSampleCountFlagBits msaaSamples)
+CreateGraphicsPipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass renderPass, VkDescriptorSetLayout descriptorSetLayout, VkSampleCountFlagBits msaaSamples, VertexFormat vertexFormat)
 {
-    // NOTE: This is null terminated
-    std::vector<char> vertShaderCode = read_file(VS_PATH);
-    std::vector<char> fragShaderCode = read_file(FS_PATH);
+    ResourceFile vertShaderCode = OpenResource(VS_PATHS[vertexFormat], FILE_ACCESS_SEQUENTIAL);
+    ResourceFile fragShaderCode = OpenResource(FS_PATH, FILE_ACCESS_SEQUENTIAL);
     
-    VkShaderModule vertShaderModule = CreateShaderModule(device, vertShaderCode);
-    VkShaderModule fragShaderModule = CreateShaderModule(device, fragShaderCode);    
+    VkShaderModule vertShaderModule = CreateShaderModule(device, ViewResource(vertShaderCode));
+    VkShaderModule fragShaderModule = CreateShaderModule(device, ViewResource(fragShaderCode));    
+    
+    // NOTE: The driver copies the code, the mappings can go right away
+    CloseResource(&vertShaderCode);
+    CloseResource(&fragShaderCode);
     
     VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
     vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
@@ -658,8 +728,8 @@ CreateGraphicsPipeline(VkDevice device, VkExtent2D swapChainExtent, VkRenderPass
     VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
     
-    VkVertexInputBindingDescription bindingDescription = GetVertexBindingDescription();
-    Array<VkVertexInputAttributeDescription, 3> attributeDescriptions = GetVertexAttributeDescriptions();
+    VkVertexInputBindingDescription bindingDescription = GetVertexBindingDescription(vertexFormat);
+    Array<VkVertexInputAttributeDescription, 3> attributeDescriptions = GetVertexAttributeDescriptions(vertexFormat);
     
     vertexInputInfo.vertexBindingDescriptionCount = 1;
     vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
@@ -1059,56 +1129,6 @@ CreateCommandBuffers(VkDevice device, VkCommandPool commandPool)
     return commandBuffers;    
 }
 
-internal VkCommandBuffer BeginSingleTimeCommands(VkDevice device, VkCommandPool commandPool)
-{
-    
-    VkCommandBufferAllocateInfo allocInfo = {};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-    
-    VkCommandBuffer commandBuffer;
-    
-    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
-    {
-        SM_ASSERT(false, "failed to allocate command buffers!");
-    }
-    
-    VkCommandBufferBeginInfo beginInfo = {};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-    
-    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
-    {
-        SM_ASSERT(false, "failed to begine recording command buffer!");
-    }
-    
-    return commandBuffer;    
-}
-
-internal void EndSingleTimeCommands(VkDevice device, VkCommandBuffer commandBuffer, VkQueue graphicsQueue, VkCommandPool commandPool)
-{
-    
-    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
-    {
-        SM_ASSERT(false, "failed to record command buffer!");
-    }
-    
-    VkSubmitInfo submitInfo = {};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-    
-    if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
-    {
-        SM_ASSERT(false, "failed to submit draw command buffer!");
-    }
-    vkQueueWaitIdle(graphicsQueue);
-    
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-}
-
 internal SyncObjects
 CreateSyncObjects(VkDevice device, uint32 swapChainImageCount)
 {
@@ -1157,11 +1177,11 @@ internal void CleanupSwapChain(VulkanContext & context)
 {
     vkDestroyImageView(context.m_device, context.m_colorImageView, nullptr);
     vkDestroyImage(context.m_device, context.m_colorImage, nullptr);
-    vkFreeMemory(context.m_device, context.m_colorImageMemory, nullptr);
+    FreeDeviceMemory(&context.m_deviceMemory, &context.m_colorImageAllocation);
     
     vkDestroyImageView(context.m_device, context.m_depthImageView, nullptr);
     vkDestroyImage(context.m_device, context.m_depthImage, nullptr);
-    vkFreeMemory(context.m_device, context.m_depthImageMemory, nullptr);
+    FreeDeviceMemory(&context.m_deviceMemory, &context.m_depthImageAllocation);
     
     for (uint32 i = 0; i < context.m_imGuiFramebuffers.size(); i++)
     {
@@ -1174,38 +1194,21 @@ vkDestroyFramebuffer(context.m_device, context.m_imGuiFramebuffers[i], nullptr);
         vkDestroyImageView(context.m_device, context.m_swapChainImageViews[i], nullptr);
          vkDestroyImageView(context.m_device, context.m_sceneImageViews[i], nullptr);
          vkDestroyImage(context.m_device, context.m_sceneImages[i], nullptr);
-         vkFreeMemory(context.m_device, context.m_sceneImageMemories[i], nullptr);
+         FreeDeviceMemory(&context.m_deviceMemory, &context.m_sceneImageAllocations[i]);
     }
 
     vkDestroySwapchainKHR(context.m_device, context.m_swapChain, nullptr);
     
 }
 
-internal uint32 FindMemoryType(VkPhysicalDevice physicalDevice, uint32 typeFilter, VkMemoryPropertyFlags properties)
-{
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-    
-    for (uint32 i = 0; i < memProperties.memoryTypeCount; i++)
-    {
-        if ((typeFilter & (1 << i)) &&
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-        {
-            return i;
-        }
-    }
-    
-    SM_ASSERT(false, "failed to find suitable memory type!");
-    
-    return 0;
-}
-
 internal BufferCreateResult
 CreateBuffer(VkDevice device,
-             VkPhysicalDevice physicalDevice,
+             DeviceMemoryAllocator * allocator,
              VkDeviceSize size,
              VkBufferUsageFlags usage,
-             VkMemoryPropertyFlags properties)
+             VkMemoryPropertyFlags properties,
+             uint32 queueFamilyCount = 0,
+             const uint32 * queueFamilies = nullptr)
 {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1213,6 +1216,14 @@ CreateBuffer(VkDevice device,
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     
+    // NOTE: Buffers used by several queue families without handing them over
+    if (queueFamilyCount > 1)
+    {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = queueFamilyCount;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
+    
     VkBuffer buffer = {};
     if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS)
     {
@@ -1222,237 +1233,634 @@ CreateBuffer(VkDevice device,
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
     
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memRequirements.size;
-    allocateInfo.memoryTypeIndex = FindMemoryType(physicalDevice,
-                                                  memRequirements.memoryTypeBits, properties);
-    
-    VkDeviceMemory bufferMemory;
-    if (vkAllocateMemory(device, &allocateInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+    DeviceAllocation allocation = {};
+    if (!AllocateDeviceMemory(allocator, memRequirements, properties, DEVICE_MEMORY_LINEAR, false, &allocation))
     {
         SM_ASSERT(false, "failed to allocate vertex buffer memory!");
     }
     
-    vkBindBufferMemory(device, buffer, bufferMemory, 0);
+    vkBindBufferMemory(device, buffer, allocation.m_memory, allocation.m_offset);
     
-    BufferCreateResult result = { buffer, bufferMemory };
+    BufferCreateResult result = { buffer, allocation };
     
     return result;
 }
 
-internal void CopyBuffer(VkDevice device,
-                         VkCommandPool commandPool,
-                         VkQueue graphicsQueue,
+internal void CopyBuffer(VkCommandBuffer commandBuffer,
                          VkBuffer srcBuffer,
+                         VkDeviceSize srcOffset,
                          VkBuffer dstBuffer,
+                         VkDeviceSize dstOffset,
                          VkDeviceSize size)
 {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
-    
     VkBufferCopy copyRegion = {};
-    copyRegion.srcOffset = 0; // Optional
-    copyRegion.dstOffset = 0; // Optional
+    copyRegion.srcOffset = srcOffset;
+    copyRegion.dstOffset = dstOffset;
     copyRegion.size = size;
     
     // IMPORTANT
     // srcBuffer must have been created with VK_BUFFER_USAGE_TRANSFER_SRC_BIT usage flag
     // dstBuffer must have been created with VK_BUFFER_USAGE_TRANSFER_DST_BIT usage flag
     vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-    
-    EndSingleTimeCommands(device, commandBuffer, graphicsQueue, commandPool);
 }
 
-internal void CopyBufferToImage(VkDevice device,
-                                VkCommandPool commandPool,
-                                VkQueue graphicsQueue,
+// NOTE: One region per mip level, all of them land in a single vkCmdCopyBufferToImage. The level offsets are
+//       relative to bufferOffset
+internal void CopyBufferToImage(VkCommandBuffer commandBuffer,
                                 VkBuffer buffer,
+                                VkDeviceSize bufferOffset,
                                 VkImage image,
-                                uint32 width,
-                                uint32 height)
+                                TextureCacheLevel * levels,
+                                uint32 levelCount)
 {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
-    
-    VkBufferImageCopy region = {};
-    region.bufferOffset = 0;
-    region.bufferRowLength = 0;
-    region.bufferImageHeight = 0;
-    
-    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount = 1;
-    
-    region.imageOffset = { 0, 0, 0 };
-    region.imageExtent = { width, height, 1 };
-    
-    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    VkBufferImageCopy regions[TEXTURE_CACHE_MAX_MIPS] = {};
+    for (uint32 level = 0; level < levelCount; level++)
+    {
+        VkBufferImageCopy & region = regions[level];
+        region.bufferOffset = bufferOffset + levels[level].m_offset;
+        region.bufferRowLength = 0;
+        region.bufferImageHeight = 0;
+        
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = level;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        
+        region.imageOffset = { 0, 0, 0 };
+        region.imageExtent = { levels[level].m_width, levels[level].m_height, 1 };
+    }
     
-    EndSingleTimeCommands(device, commandBuffer, graphicsQueue, commandPool);
+    vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, levelCount, regions);
 }
 
-internal ImageCreateResult CreateImage(VkDevice device,
-                                       VkPhysicalDevice physicalDevice,
-                                       uint32 width,
-                                       uint32 height,
-                                       uint32 mipLevels,
-                                       VkSampleCountFlagBits numSamples,
-                                       VkFormat format,
-                                       VkImageTiling tiling,
-                                       VkImageUsageFlags usage,
-                                       VkMemoryPropertyFlags properties)
+//====================================================
+//      NOTE: Staging Ring
+//====================================================
+
+internal void InitStagingRing(VkDevice device, DeviceMemoryAllocator * allocator, VkDeviceSize size, StagingRing * ring)
 {
-    
-    VkImageCreateInfo imageInfo = {};
-    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
-    imageInfo.imageType = VK_IMAGE_TYPE_2D;
-    imageInfo.extent.width = width;
-    imageInfo.extent.height = height;
-    imageInfo.extent.depth = 1;
-    imageInfo.mipLevels = mipLevels;
-    imageInfo.arrayLayers = 1;
-    imageInfo.format = format;
-    imageInfo.tiling = tiling;
-    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    imageInfo.usage = usage; 
-    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-    imageInfo.samples = numSamples;
-    imageInfo.flags = 0; // Optional
-    
-    VkImage image = {};
-    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    *ring = {};
+    ring->m_buffer = CreateBuffer(device,
+                                  allocator,
+                                  size,
+                                  VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                  VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    ring->m_mapped = (uint8 *)ring->m_buffer.m_allocation.m_mapped;
+    ring->m_size   = size;
+}
+
+internal void DestroyStagingBuffer(VkDevice device, DeviceMemoryAllocator * allocator, BufferCreateResult & buffer)
+{
+    vkDestroyBuffer(device, buffer.m_buffer, nullptr);
+    FreeDeviceMemory(allocator, &buffer.m_allocation);
+}
+
+// NOTE: Gives back the regions of every batch up to completed, oldest first
+internal void ReclaimStagingMemory(VkDevice device, DeviceMemoryAllocator * allocator, StagingRing * ring, UploadTicket completed)
+{
+    while (!ring->m_inFlight.empty() && ring->m_inFlight.front().m_ticket <= completed)
     {
-        SM_ASSERT(false, "failed to create image!");
+        StagingRegion & region = ring->m_inFlight.front();
+        for (BufferCreateResult & buffer : region.m_oversizeBuffers)
+        {
+            DestroyStagingBuffer(device, allocator, buffer);
+        }
+        
+        ring->m_tail = region.m_end;
+        ring->m_inFlight.pop_front();
     }
+}
+
+// NOTE: size bytes to write an upload into. False if the ring has no room for them until older batches complete
+internal bool AcquireStagingMemory(VkDevice device, DeviceMemoryAllocator * allocator, StagingRing * ring, VkDeviceSize size, StagingAllocation * result)
+{
+    *result = {};
+    result->m_size = size;
     
-    VkMemoryRequirements memRequirements = {};
-    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    if (size > ring->m_size)
+    {
+        SM_TRACE("upload of %.2f MB does not fit the staging ring, staging it on its own", size / (1024.0 * 1024.0));
+        
+        BufferCreateResult buffer = CreateBuffer(device,
+                                                 allocator,
+                                                 size,
+                                                 VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+                                                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        ring->m_oversizeBuffers.push_back(buffer);
+        
+        result->m_buffer = buffer.m_buffer;
+        result->m_data   = (uint8 *)buffer.m_allocation.m_mapped;
+        return true;
+    }
     
-    VkMemoryAllocateInfo allocateInfo = {};
-    allocateInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocateInfo.allocationSize = memRequirements.size;
-    allocateInfo.memoryTypeIndex = FindMemoryType(physicalDevice,
-                                                  memRequirements.memoryTypeBits, properties);
+    // NOTE: Nothing pending, start over from the beginning of the ring
+    if (ring->m_tail == ring->m_head && ring->m_inFlight.empty())
+    {
+        ring->m_head = ring->m_retired = ring->m_tail = (ring->m_head + ring->m_size - 1) / ring->m_size * ring->m_size;
+    }
     
-    VkDeviceMemory imageMemory;
-    if (vkAllocateMemory(device, &allocateInfo, nullptr, &imageMemory) != VK_SUCCESS)
+    // NOTE: A range never wraps around the end of the buffer, the rest of the lap is skipped instead
+    uint64 offset = (ring->m_head + STAGING_RING_ALIGNMENT - 1) & ~(uint64)(STAGING_RING_ALIGNMENT - 1);
+    if (offset % ring->m_size + size > ring->m_size)
     {
-        SM_ASSERT(false, "failed to allocate vertex buffer memory!");
+        offset = (offset / ring->m_size + 1) * ring->m_size;
     }
     
-    vkBindImageMemory(device, image, imageMemory, 0);
+    if (offset + size - ring->m_tail > ring->m_size)
+    {
+        return false;
+    }
     
-    ImageCreateResult result = { image, imageMemory };
+    ring->m_head = offset + size;
     
-    return result;
+    result->m_buffer = ring->m_buffer.m_buffer;
+    result->m_offset = offset % ring->m_size;
+    result->m_data   = ring->m_mapped + result->m_offset;
+    return true;
 }
 
+// NOTE: Everything acquired since the previous retire is read by the batch of ticket
+internal void RetireStagingMemory(StagingRing * ring, UploadTicket ticket)
+{
+    StagingRegion region = {};
+    region.m_end    = ring->m_head;
+    region.m_ticket = ticket;
+    region.m_oversizeBuffers.swap(ring->m_oversizeBuffers);
+    ring->m_inFlight.push_back(std::move(region));
+    ring->m_retired = ring->m_head;
+}
 
-internal void TransitionImageLayout(VkDevice device,
-                                    VkCommandPool commandPool,
-                                    VkQueue graphicsQueue,
-                                    VkImage  image,
-                                    uint32 mipLevels,
-                                    VkImageLayout oldLayout,
-                                    VkImageLayout newLayout)
+internal void ShutdownStagingRing(VkDevice device, DeviceMemoryAllocator * allocator, StagingRing * ring)
 {
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
-    
-    VkImageMemoryBarrier barrier = {};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    
-    barrier.oldLayout = oldLayout;
-    barrier.newLayout = newLayout;
-    // NOTE: If you are using the barrier to transfer queue family ownership,
-    //       then these two fields should be the indices of the queue families.
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.image = image;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = mipLevels;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
+    SM_ASSERT(ring->m_inFlight.empty() && ring->m_retired == ring->m_head && ring->m_oversizeBuffers.empty(),
+              "staging memory is still in use!");
     
-    VkPipelineStageFlags srcStage = {};
-    VkPipelineStageFlags dstStage = {};
+    DestroyStagingBuffer(device, allocator, ring->m_buffer);
+    *ring = {};
+}
+
+//====================================================
+//      NOTE: Upload Batches
+//====================================================
+
+internal void InitUploadQueue(UploadQueue * uploads, VkDevice device, DeviceMemoryAllocator * allocator, QueueFamilyIndices indices,
+                              VkQueue graphicsQueue, VkCommandPool graphicsCommandPool)
+{
+    *uploads = {};
+    uploads->m_device              = device;
+    uploads->m_allocator           = allocator;
+    uploads->m_graphicsQueue       = graphicsQueue;
+    uploads->m_graphicsCommandPool = graphicsCommandPool;
+    uploads->m_graphicsFamily      = indices.m_graphicsFamily.value();
+    uploads->m_nextTicket          = 1;
     
-    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-    {
-        barrier.srcAccessMask = 0;
-        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        
-        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    uploads->m_dedicatedTransfer = USE_TRANSFER_QUEUE && indices.m_transferFamily.has_value();
+    if (uploads->m_dedicatedTransfer)
     {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        uploads->m_transferFamily = indices.m_transferFamily.value();
+        vkGetDeviceQueue(device, uploads->m_transferFamily, 0, &uploads->m_transferQueue);
         
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-    }
-    else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-    {
-        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
-        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        VkCommandPoolCreateInfo poolInfo = {};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        poolInfo.queueFamilyIndex = uploads->m_transferFamily;
         
-        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        if (vkCreateCommandPool(device, &poolInfo, nullptr, &uploads->m_transferCommandPool) != VK_SUCCESS)
+        {
+            SM_ASSERT(false, "failed to create transfer command pool");
+        }
     }
     else
     {
-        SM_ASSERT(false, "unsupported layout transition!");
+        uploads->m_transferFamily      = uploads->m_graphicsFamily;
+        uploads->m_transferQueue       = graphicsQueue;
+        uploads->m_transferCommandPool = graphicsCommandPool;
     }
     
-    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+    SM_TRACE("uploads run on %s (queue family %u)", uploads->m_dedicatedTransfer ? "a transfer queue" : "the graphics queue",
+             uploads->m_transferFamily);
     
-    EndSingleTimeCommands(device, commandBuffer, graphicsQueue, commandPool);
+    InitStagingRing(device, allocator, STAGING_RING_SIZE, &uploads->m_staging);
 }
 
-internal void GenerateMipMaps(VkDevice device,
-                              VkPhysicalDevice physicalDevice, 
-                              VkCommandPool commandPool,
-                              VkQueue graphicsQueue, 
-                              VkImage image,
-                              VkFormat imageFormat, 
-                              int32 texWidth,
-                              int32 texHeight,
-                              uint32 mipLevels)
+internal VkCommandBuffer AllocateUploadCommandBuffer(VkDevice device, VkCommandPool commandPool)
 {
-    // NOTE: Check if image format supports linear blitting
-    VkFormatProperties formatProperties;
-    vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
-    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+    VkCommandBufferAllocateInfo allocInfo = {};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = commandPool;
+    allocInfo.commandBufferCount = 1;
+    
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
     {
-        SM_ASSERT(false, "texture image format does not support linear bliting!");
-        
-        /*
- NOTE: 
-There are two alternatives in this case. You could implement a function that searches common texture image formats for one that does support linear blitting, or you could implement the mipmap generation in software with a library like stb_image_resize. Each mip level can then be loaded into the image in the same way that you loaded the original image.
-It should be noted that it is uncommon in practice to generate the mipmap levels at runtime anyway. Usually they are pregenerated and stored in the texture file alongside the base level to improve loading speed.
-    */
+        SM_ASSERT(false, "failed to allocate upload command buffer!");
     }
     
-    VkCommandBuffer commandBuffer = BeginSingleTimeCommands(device, commandPool);
+    return commandBuffer;
+}
+
+internal void BeginUploadCommandBuffer(VkCommandBuffer commandBuffer)
+{
+    VkCommandBufferBeginInfo beginInfo = {};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
     
-    VkImageMemoryBarrier barrier{};
-    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-    barrier.image = image;
-    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    barrier.subresourceRange.baseArrayLayer = 0;
-    barrier.subresourceRange.layerCount = 1;
-    barrier.subresourceRange.levelCount = 1;
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
+    {
+        SM_ASSERT(false, "failed to begin recording upload command buffer!");
+    }
+}
+
+// NOTE: The command buffer of the open batch for copies, on the transfer queue. Begins a new batch, on recycled
+//       command buffers when there are some, if nothing is recorded yet
+internal VkCommandBuffer GetUploadCommands(UploadQueue * uploads)
+{
+    UploadBatch & batch = uploads->m_open;
+    if (batch.m_commandBuffer)
+    {
+        return batch.m_commandBuffer;
+    }
     
-    int32 mipWidth = texWidth;
-    int32 mipHeight = texHeight;
-    for (uint32 i = 1; i < mipLevels; i++)
+    if (!uploads->m_free.empty())
     {
-        barrier.subresourceRange.baseMipLevel = i - 1;
-        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        batch = uploads->m_free.back();
+        uploads->m_free.pop_back();
+        vkResetCommandBuffer(batch.m_commandBuffer, 0);
+        if (batch.m_graphicsCommandBuffer)
+        {
+            vkResetCommandBuffer(batch.m_graphicsCommandBuffer, 0);
+        }
+    }
+    else
+    {
+        batch.m_commandBuffer = AllocateUploadCommandBuffer(uploads->m_device, uploads->m_transferCommandPool);
+        
+        VkFenceCreateInfo fenceInfo = {};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        if (vkCreateFence(uploads->m_device, &fenceInfo, nullptr, &batch.m_fence) != VK_SUCCESS)
+        {
+            SM_ASSERT(false, "failed to create upload fence!");
+        }
+        
+        if (uploads->m_dedicatedTransfer)
+        {
+            batch.m_graphicsCommandBuffer = AllocateUploadCommandBuffer(uploads->m_device, uploads->m_graphicsCommandPool);
+            
+            VkSemaphoreCreateInfo semaphoreInfo = {};
+            semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            if (vkCreateSemaphore(uploads->m_device, &semaphoreInfo, nullptr, &batch.m_semaphore) != VK_SUCCESS)
+            {
+                SM_ASSERT(false, "failed to create upload semaphore!");
+            }
+        }
+    }
+    batch.m_ticket = uploads->m_nextTicket++;
+    
+    BeginUploadCommandBuffer(batch.m_commandBuffer);
+    if (batch.m_graphicsCommandBuffer)
+    {
+        BeginUploadCommandBuffer(batch.m_graphicsCommandBuffer);
+    }
+    
+    return batch.m_commandBuffer;
+}
+
+// NOTE: The command buffer of the open batch for work only the graphics queue can do, like blits. It runs after the
+//       copies of the batch, images reach it through ReleaseImageToGraphics
+internal VkCommandBuffer GetUploadGraphicsCommands(UploadQueue * uploads)
+{
+    VkCommandBuffer commandBuffer = GetUploadCommands(uploads);
+    return uploads->m_dedicatedTransfer ? uploads->m_open.m_graphicsCommandBuffer : commandBuffer;
+}
+
+// NOTE: Submits everything recorded since the previous submit, one vkQueueSubmit per queue involved. Returns the
+//       ticket of the batch, or of the last one submitted when nothing was recorded
+internal UploadTicket SubmitUploads(UploadQueue * uploads)
+{
+    UploadBatch & batch = uploads->m_open;
+    if (!batch.m_commandBuffer)
+    {
+        return uploads->m_nextTicket - 1;
+    }
+    
+    if (!uploads->m_dedicatedTransfer)
+    {
+        // NOTE: Makes the buffer copies visible to every draw submitted after the batch, images are transitioned by
+        //       whoever uploads them
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(batch.m_commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+    }
+    
+    if (vkEndCommandBuffer(batch.m_commandBuffer) != VK_SUCCESS)
+    {
+        SM_ASSERT(false, "failed to record upload command buffer!");
+    }
+    
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &batch.m_commandBuffer;
+    
+    if (uploads->m_dedicatedTransfer)
+    {
+        submitInfo.signalSemaphoreCount = 1;
+        submitInfo.pSignalSemaphores = &batch.m_semaphore;
+        
+        if (vkQueueSubmit(uploads->m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+        {
+            SM_ASSERT(false, "failed to submit upload command buffer!");
+        }
+        
+        // NOTE: The semaphore only orders the copies before this submission. The barrier chains after its wait, so every
+        //       draw submitted later sees the buffer copies too, even when the batch has no image to acquire
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+        vkCmdPipelineBarrier(batch.m_graphicsCommandBuffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        
+        if (vkEndCommandBuffer(batch.m_graphicsCommandBuffer) != VK_SUCCESS)
+        {
+            SM_ASSERT(false, "failed to record upload command buffer!");
+        }
+        
+        // NOTE: The acquire barriers and the memory barrier wait for the copies, the frames submitted after them wait
+        //       for the barriers
+        VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        submitInfo = {};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.waitSemaphoreCount = 1;
+        submitInfo.pWaitSemaphores = &batch.m_semaphore;
+        submitInfo.pWaitDstStageMask = &waitStage;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.m_graphicsCommandBuffer;
+    }
+    
+    if (vkQueueSubmit(uploads->m_graphicsQueue, 1, &submitInfo, batch.m_fence) != VK_SUCCESS)
+    {
+        SM_ASSERT(false, "failed to submit upload command buffer!");
+    }
+    
+    RetireStagingMemory(&uploads->m_staging, batch.m_ticket);
+    
+    UploadTicket ticket = batch.m_ticket;
+    uploads->m_inFlight.push_back(batch);
+    batch = {};
+    return ticket;
+}
+
+// NOTE: Recycles the batches that completed and gives back their staging memory, never blocks
+internal void PollUploads(UploadQueue * uploads)
+{
+    while (!uploads->m_inFlight.empty() && vkGetFenceStatus(uploads->m_device, uploads->m_inFlight.front().m_fence) == VK_SUCCESS)
+    {
+        UploadBatch batch = uploads->m_inFlight.front();
+        uploads->m_inFlight.pop_front();
+        
+        vkResetFences(uploads->m_device, 1, &batch.m_fence);
+        uploads->m_completed = batch.m_ticket;
+        uploads->m_free.push_back(batch);
+    }
+    
+    ReclaimStagingMemory(uploads->m_device, uploads->m_allocator, &uploads->m_staging, uploads->m_completed);
+}
+
+internal bool IsUploadComplete(UploadQueue * uploads, UploadTicket ticket)
+{
+    PollUploads(uploads);
+    return ticket <= uploads->m_completed;
+}
+
+// NOTE: Submits the open batch first if ticket is still being recorded
+internal void WaitForUpload(UploadQueue * uploads, UploadTicket ticket)
+{
+    SM_ASSERT(ticket < uploads->m_nextTicket, "waiting on upload %llu that was never recorded!", (unsigned long long)ticket);
+    
+    if (uploads->m_open.m_commandBuffer && ticket >= uploads->m_open.m_ticket)
+    {
+        SubmitUploads(uploads);
+    }
+    
+    while (uploads->m_completed < ticket && !uploads->m_inFlight.empty())
+    {
+        vkWaitForFences(uploads->m_device, 1, &uploads->m_inFlight.front().m_fence, VK_TRUE, UINT64_MAX);
+        PollUploads(uploads);
+    }
+}
+
+// NOTE: Staging memory for size bytes of an upload, which belongs to the open batch. A full ring submits the open
+//       batch or waits on the oldest one, so record the copy out of a range before acquiring the next one
+internal StagingAllocation AcquireUploadMemory(UploadQueue * uploads, VkDeviceSize size)
+{
+    StagingAllocation result = {};
+    StagingRing * ring = &uploads->m_staging;
+    while (!AcquireStagingMemory(uploads->m_device, uploads->m_allocator, ring, size, &result))
+    {
+        if (ring->m_inFlight.empty())
+        {
+            SubmitUploads(uploads);
+        }
+        else
+        {
+            WaitForUpload(uploads, ring->m_inFlight.front().m_ticket);
+        }
+    }
+    
+    GetUploadCommands(uploads);
+    return result;
+}
+
+internal void ShutdownUploadQueue(UploadQueue * uploads)
+{
+    WaitForUpload(uploads, SubmitUploads(uploads));
+    
+    for (UploadBatch & batch : uploads->m_free)
+    {
+        vkFreeCommandBuffers(uploads->m_device, uploads->m_transferCommandPool, 1, &batch.m_commandBuffer);
+        if (batch.m_graphicsCommandBuffer)
+        {
+            vkFreeCommandBuffers(uploads->m_device, uploads->m_graphicsCommandPool, 1, &batch.m_graphicsCommandBuffer);
+            vkDestroySemaphore(uploads->m_device, batch.m_semaphore, nullptr);
+        }
+        vkDestroyFence(uploads->m_device, batch.m_fence, nullptr);
+    }
+    
+    if (uploads->m_dedicatedTransfer)
+    {
+        vkDestroyCommandPool(uploads->m_device, uploads->m_transferCommandPool, nullptr);
+    }
+    
+    ShutdownStagingRing(uploads->m_device, uploads->m_allocator, &uploads->m_staging);
+    *uploads = {};
+}
+
+// NOTE: Submits the open upload batch too, so nothing recorded so far still refers to what the caller destroys next
+internal void WaitForGraphicsQueue(VulkanContext & context)
+{
+    SubmitUploads(&context.m_uploads);
+    vkQueueWaitIdle(context.m_graphicsQueue);
+    PollUploads(&context.m_uploads);
+}
+
+internal ImageCreateResult CreateImage(VkDevice device,
+                                       DeviceMemoryAllocator * allocator,
+                                       uint32 width,
+                                       uint32 height,
+                                       uint32 mipLevels,
+                                       VkSampleCountFlagBits numSamples,
+                                       VkFormat format,
+                                       VkImageTiling tiling,
+                                       VkImageUsageFlags usage,
+                                       VkMemoryPropertyFlags properties)
+{
+    
+    VkImageCreateInfo imageInfo = {};
+    imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+    imageInfo.imageType = VK_IMAGE_TYPE_2D;
+    imageInfo.extent.width = width;
+    imageInfo.extent.height = height;
+    imageInfo.extent.depth = 1;
+    imageInfo.mipLevels = mipLevels;
+    imageInfo.arrayLayers = 1;
+    imageInfo.format = format;
+    imageInfo.tiling = tiling;
+    imageInfo.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    imageInfo.usage = usage; 
+    imageInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+    imageInfo.samples = numSamples;
+    imageInfo.flags = 0; // Optional
+    
+    VkImage image = {};
+    if (vkCreateImage(device, &imageInfo, nullptr, &image) != VK_SUCCESS)
+    {
+        SM_ASSERT(false, "failed to create image!");
+    }
+    
+    VkMemoryRequirements memRequirements = {};
+    vkGetImageMemoryRequirements(device, image, &memRequirements);
+    
+    // NOTE: Render targets are recreated with the swapchain, large textures would take most of a block
+    bool renderTarget = (usage & (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT)) != 0;
+    bool dedicated = renderTarget || memRequirements.size >= DEVICE_MEMORY_DEDICATED_SIZE;
+    DeviceMemoryKind kind = tiling == VK_IMAGE_TILING_OPTIMAL ? DEVICE_MEMORY_OPTIMAL : DEVICE_MEMORY_LINEAR;
+    
+    DeviceAllocation allocation = {};
+    if (!AllocateDeviceMemory(allocator, memRequirements, properties, kind, dedicated, &allocation))
+    {
+        SM_ASSERT(false, "failed to allocate image memory!");
+    }
+    
+    vkBindImageMemory(device, image, allocation.m_memory, allocation.m_offset);
+    
+    ImageCreateResult result = {};
+    result.m_image      = image;
+    result.m_allocation = allocation;
+    
+    return result;
+}
+
+
+internal void TransitionImageLayout(VkCommandBuffer commandBuffer,
+                                    VkImage  image,
+                                    uint32 mipLevels,
+                                    VkImageLayout oldLayout,
+                                    VkImageLayout newLayout)
+{
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    
+    barrier.oldLayout = oldLayout;
+    barrier.newLayout = newLayout;
+    // NOTE: If you are using the barrier to transfer queue family ownership,
+    //       then these two fields should be the indices of the queue families.
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    
+    VkPipelineStageFlags srcStage = {};
+    VkPipelineStageFlags dstStage = {};
+    
+    if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+    {
+        barrier.srcAccessMask = 0;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        
+        srcStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    }
+    else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED && newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
+    {
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+        
+        srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+        dstStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    }
+    else
+    {
+        SM_ASSERT(false, "unsupported layout transition!");
+    }
+    
+    vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+}
+
+internal void GenerateMipMaps(VkPhysicalDevice physicalDevice, 
+                              VkCommandBuffer commandBuffer,
+                              VkImage image,
+                              VkFormat imageFormat, 
+                              int32 texWidth,
+                              int32 texHeight,
+                              uint32 mipLevels)
+{
+    // NOTE: Check if image format supports linear blitting
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, imageFormat, &formatProperties);
+    if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
+    {
+        SM_ASSERT(false, "texture image format does not support linear bliting!");
+        
+        /*
+ NOTE: 
+There are two alternatives in this case. You could implement a function that searches common texture image formats for one that does support linear blitting, or you could implement the mipmap generation in software with a library like stb_image_resize. Each mip level can then be loaded into the image in the same way that you loaded the original image.
+It should be noted that it is uncommon in practice to generate the mipmap levels at runtime anyway. Usually they are pregenerated and stored in the texture file alongside the base level to improve loading speed.
+    */
+    }
+    
+    VkImageMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.image = image;
+    barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    barrier.subresourceRange.levelCount = 1;
+    
+    int32 mipWidth = texWidth;
+    int32 mipHeight = texHeight;
+    for (uint32 i = 1; i < mipLevels; i++)
+    {
+        barrier.subresourceRange.baseMipLevel = i - 1;
+        barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
         barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
         barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
         barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
@@ -1502,20 +1910,60 @@ It should be noted that it is uncommon in practice to generate the mipmap levels
     vkCmdPipelineBarrier(commandBuffer,
                          VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 
                          0, 0, nullptr, 0, nullptr,1, &barrier);
+}
+
+// NOTE: Hands an image the batch copied into over to the graphics queue, moving it from
+//       VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL to newLayout on the way. Without a dedicated transfer queue it is a plain
+//       layout transition
+internal void ReleaseImageToGraphics(UploadQueue * uploads, VkImage image, uint32 mipLevels, VkImageLayout newLayout)
+{
+    if (!uploads->m_dedicatedTransfer)
+    {
+        if (newLayout != VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
+        {
+            TransitionImageLayout(GetUploadCommands(uploads), image, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, newLayout);
+        }
+        return;
+    }
+    
+    // NOTE: Images staying in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL get their mips blitted next
+    bool shaderRead = newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    
+    VkImageMemoryBarrier barrier = {};
+    barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+    barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barrier.newLayout = newLayout;
+    barrier.srcQueueFamilyIndex = uploads->m_transferFamily;
+    barrier.dstQueueFamilyIndex = uploads->m_graphicsFamily;
+    barrier.image = image;
+    barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    barrier.subresourceRange.baseMipLevel = 0;
+    barrier.subresourceRange.levelCount = mipLevels;
+    barrier.subresourceRange.baseArrayLayer = 0;
+    barrier.subresourceRange.layerCount = 1;
+    
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = 0;
+    vkCmdPipelineBarrier(GetUploadCommands(uploads), VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
     
-    EndSingleTimeCommands(device, commandBuffer, graphicsQueue, commandPool);
+    barrier.srcAccessMask = 0;
+    barrier.dstAccessMask = shaderRead ? VK_ACCESS_SHADER_READ_BIT : VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(GetUploadGraphicsCommands(uploads), VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                         shaderRead ? VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT : VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 
 internal ImageResources CreateSceneImage(VkDevice device, 
-                                         VkPhysicalDevice physicalDevice, 
+                                         DeviceMemoryAllocator * allocator, 
                                          VkCommandPool commandPool,
                                          VkQueue graphicsQueue,
                                          VkFormat swapChainImageFormat, 
                                          VkExtent2D swapChainExtent)
 {
     ImageCreateResult imageResult = CreateImage(device,
-                                                physicalDevice,
+                                                allocator,
                                                 swapChainExtent.width,
                                                 swapChainExtent.height,
                                                 1, VK_SAMPLE_COUNT_1_BIT,
@@ -1530,68 +1978,225 @@ internal ImageResources CreateSceneImage(VkDevice device,
 }
 
 
+// NOTE: Every texture is sampled as color, so grey is sRGB just like RGBA
+internal VkFormat GetTextureFormat(uint32 channels)
+{
+    return channels == 1 ? VK_FORMAT_R8_SRGB : VK_FORMAT_R8G8B8A8_SRGB;
+}
+
+internal VkFormat GetCompressedTextureFormat(TextureEncoding encoding)
+{
+    switch (encoding)
+    {
+        case TEXTURE_ENCODING_BC1: return VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        case TEXTURE_ENCODING_BC7: return VK_FORMAT_BC7_SRGB_BLOCK;
+        default: return VK_FORMAT_UNDEFINED;
+    }
+}
+
+// NOTE: VK_FORMAT_UNDEFINED when the device can not sample the encoding, the texels then have to be decoded on the CPU
+internal VkFormat FindCompressedTextureFormat(VkPhysicalDevice physicalDevice, bool textureCompressionBC, TextureEncoding encoding)
+{
+    if (!textureCompressionBC)
+    {
+        return VK_FORMAT_UNDEFINED;
+    }
+    
+    VkFormat candidates[] = { GetCompressedTextureFormat(encoding) };
+    return TryFindSupportedFormat(physicalDevice, candidates, ArrayCount(candidates), VK_IMAGE_TILING_OPTIMAL,
+                                  VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT);
+}
+
+// NOTE: Sampling needs linear filtering, and generating mips at runtime additionally needs both blit directions
+internal bool IsTextureFormatSupported(VkPhysicalDevice physicalDevice, VkFormat format, bool generateMips)
+{
+    VkFormatProperties formatProperties;
+    vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &formatProperties);
+    
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    if (generateMips)
+    {
+        required |= VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT;
+    }
+    
+    return (formatProperties.optimalTilingFeatures & required) == required;
+}
+
+// NOTE: Fallback when the device can not filter R8_SRGB, grey -> rgb like stbi does
+internal void ExpandToRgba8(const uint8 * src, uint64 texelCount, uint8 * dst)
+{
+    for (uint64 i = 0; i < texelCount; i++)
+    {
+        uint8 grey = src[i];
+        dst[i * 4 + 0] = grey;
+        dst[i * 4 + 1] = grey;
+        dst[i * 4 + 2] = grey;
+        dst[i * 4 + 3] = 255;
+    }
+}
+
+// NOTE: Compressed textures fall back to raw texels without BC support, and R8 to RGBA8 when the device can not
+//       filter it
+internal TextureImageFormat ChooseTextureImageFormat(VkPhysicalDevice physicalDevice, bool textureCompressionBC, const TextureData & texture)
+{
+    TextureImageFormat result = {};
+    result.m_channels = texture.m_channels;
+    result.m_encoding = texture.m_encoding;
+    
+    if (result.m_encoding != TEXTURE_ENCODING_RAW)
+    {
+        result.m_format = FindCompressedTextureFormat(physicalDevice, textureCompressionBC, result.m_encoding);
+        if (result.m_format != VK_FORMAT_UNDEFINED)
+        {
+            return result;
+        }
+        result.m_encoding = TEXTURE_ENCODING_RAW;
+    }
+    
+    bool generateMips = texture.m_mipLevels < GetMipLevelCount(texture.m_width, texture.m_height);
+    result.m_format = GetTextureFormat(result.m_channels);
+    if (result.m_channels != 4 && !IsTextureFormatSupported(physicalDevice, result.m_format, generateMips))
+    {
+        result.m_channels = 4;
+        result.m_format = VK_FORMAT_R8G8B8A8_SRGB;
+    }
+    return result;
+}
+
+// NOTE: Uploads the chain from firstMip down, the levels above it are skipped entirely. Textures without a cooked
+//       chain have their mips generated and always come in whole
 internal ImageCreateResult
-CreateTextureImage(VkDevice device, VkPhysicalDevice physicalDevice, VkCommandPool commandPool, VkQueue graphicsQueue, const char * texturePath)
-{
-    // Standard parameters:
-    //    int *x                 -- outputs image width in pixels
-    //    int *y                 -- outputs image height in pixels
-    //    int *channels_in_file  -- outputs # of image components in image file
-    //    int desired_channels   -- if non-zero, # of image components requested in result
-    int x,y, channels_in_file;
-    unsigned char * imageData = stbi_load(texturePath, &x, &y, &channels_in_file, STBI_rgb_alpha);
-    SM_ASSERT(imageData, "failed to load texture image!");
-    uint32 mipLevels = (uint32)(std::floor(std::log2(max(x, y)))) + 1;
-    
-    VkDeviceSize imageSize = x * y * 4;
-    
-    BufferCreateResult stagingBufferResult = CreateBuffer(device,
-                                                          physicalDevice,
-                                                          imageSize,
-                                                          VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
-    
-    void * data;
-    vkMapMemory(device, stagingBufferResult.m_bufferMemory, 0, imageSize, 0, &data);
-    memcpy(data, imageData, (uint32)imageSize);
-    vkUnmapMemory(device, stagingBufferResult.m_bufferMemory);
-    stbi_image_free(imageData);
+CreateTextureImage(VkDevice device, VkPhysicalDevice physicalDevice, DeviceMemoryAllocator * allocator, UploadQueue * uploads, const TextureData & texture, bool textureCompressionBC, uint32 firstMip)
+{
+    uint32 fullMipLevels = GetMipLevelCount(texture.m_width, texture.m_height);
+    SM_ASSERT(texture.m_mipLevels <= fullMipLevels, "texture has more mip levels than its size allows!");
+    
+    bool generateMips = texture.m_mipLevels < fullMipLevels;
+    SM_ASSERT(!generateMips || firstMip == 0, "textures without a mip chain can not skip top levels!");
+    SM_ASSERT(firstMip < fullMipLevels, "first mip %u is past the end of the chain!", firstMip);
+    
+    uint32 x = std::max(texture.m_width >> firstMip, 1u);
+    uint32 y = std::max(texture.m_height >> firstMip, 1u);
+    uint32 mipLevels = fullMipLevels - firstMip;
+    
+    const uint8 * pixels = texture.m_pixels;
+    TextureEncoding encoding = texture.m_encoding;
+    TextureImageFormat imageFormat = ChooseTextureImageFormat(physicalDevice, textureCompressionBC, texture);
+    VkFormat format = imageFormat.m_format;
+    
+    bool decode = encoding != imageFormat.m_encoding;
+    if (decode)
+    {
+        SM_ASSERT(!generateMips, "block compressed textures need their whole mip chain!");
+        SM_WARN("block compressed format %d is not supported, decoding to raw texels", GetCompressedTextureFormat(encoding));
+    }
+    
+    uint32 channels = imageFormat.m_channels;
+    if (channels != texture.m_channels)
+    {
+        SM_WARN("texture format %d is not supported for sampling, expanding to RGBA8", GetTextureFormat(texture.m_channels));
+    }
+    
+    TextureCacheLevel levels[TEXTURE_CACHE_MAX_MIPS] = {};
+    uint32 uploadLevels = texture.m_mipLevels - firstMip;
+    VkDeviceSize imageSize = GetMipChainLayout(x, y, uploadLevels, channels, imageFormat.m_encoding, levels);
+    
+    StagingAllocation staging = AcquireUploadMemory(uploads, imageSize);
+    
+    // NOTE: Decoded texels go straight into the staging memory, unless they still have to be expanded
+    std::vector<uint8> decompressed;
+    if (decode)
+    {
+        TextureCacheLevel compressedLevels[TEXTURE_CACHE_MAX_MIPS] = {};
+        GetMipChainLayout(texture.m_width, texture.m_height, texture.m_mipLevels, texture.m_channels, encoding, compressedLevels);
+        
+        TextureCacheLevel rawLevels[TEXTURE_CACHE_MAX_MIPS] = {};
+        uint8 * raw = staging.m_data;
+        if (channels != texture.m_channels)
+        {
+            decompressed.resize(GetMipChainLayout(x, y, uploadLevels, texture.m_channels, TEXTURE_ENCODING_RAW, rawLevels));
+            raw = decompressed.data();
+        }
+        else
+        {
+            memcpy(rawLevels, levels, sizeof(levels));
+        }
+        
+        for (uint32 level = 0; level < uploadLevels; level++)
+        {
+            DecompressMipLevel(pixels + compressedLevels[firstMip + level].m_offset, rawLevels[level].m_width, rawLevels[level].m_height,
+                               encoding, raw + rawLevels[level].m_offset);
+        }
+        
+        pixels = raw;
+        encoding = TEXTURE_ENCODING_RAW;
+    }
+    else
+    {
+        // NOTE: The levels from firstMip down are the tail of the packed chain, so they are one contiguous range
+        TextureCacheLevel sourceLevels[TEXTURE_CACHE_MAX_MIPS] = {};
+        GetMipChainLayout(texture.m_width, texture.m_height, texture.m_mipLevels, texture.m_channels, encoding, sourceLevels);
+        pixels += sourceLevels[firstMip].m_offset;
+    }
+    
+    if (channels != texture.m_channels)
+    {
+        ExpandToRgba8(pixels, imageSize / 4, staging.m_data);
+    }
+    else if (!decode)
+    {
+        memcpy(staging.m_data, pixels, (size_t)imageSize);
+    }
     
     ImageCreateResult textureImageResult = CreateImage(device,
-                                                       physicalDevice,
-                                                       (uint32)x,
-                                                       (uint32)y,
+                                                       allocator,
+                                                       x,
+                                                       y,
                                                        mipLevels,
                                                        VK_SAMPLE_COUNT_1_BIT,
-                                                       VK_FORMAT_R8G8B8A8_SRGB,
+                                                       format,
                                                        VK_IMAGE_TILING_OPTIMAL,
                                                        VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
     
-    TransitionImageLayout(device,
-                          commandPool, 
-                          graphicsQueue,
+    VkCommandBuffer commandBuffer = GetUploadCommands(uploads);
+    
+    TransitionImageLayout(commandBuffer,
                           textureImageResult.m_image,
                           mipLevels, 
                           VK_IMAGE_LAYOUT_UNDEFINED, 
                           VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
     
-    CopyBufferToImage(device, commandPool, graphicsQueue, stagingBufferResult.m_buffer, textureImageResult.m_image, (uint32)x, (uint32)y);
+    CopyBufferToImage(commandBuffer, staging.m_buffer, staging.m_offset, textureImageResult.m_image, levels, uploadLevels);
     
-    // NOTE: transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps
-    GenerateMipMaps(device, physicalDevice, commandPool, graphicsQueue, textureImageResult.m_image, VK_FORMAT_R8G8B8A8_SRGB,  x, y, mipLevels);
-    
-    vkDestroyBuffer(device, stagingBufferResult.m_buffer, nullptr);
-    vkFreeMemory(device, stagingBufferResult.m_bufferMemory, nullptr);
+    if (!generateMips)
+    {
+        // NOTE: Cooked textures carry their whole mip chain, nothing left to blit
+        ReleaseImageToGraphics(uploads, textureImageResult.m_image, mipLevels, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    else
+    {
+        // NOTE: Fallback for textures without a cache, transitioned to VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL while generating mipmaps.
+        //       Transfer queues can not blit
+        ReleaseImageToGraphics(uploads, textureImageResult.m_image, mipLevels, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        GenerateMipMaps(physicalDevice, GetUploadGraphicsCommands(uploads), textureImageResult.m_image, format, (int32)x, (int32)y, mipLevels);
+    }
     
     textureImageResult.m_mipLevels = mipLevels;
+    textureImageResult.m_format    = format;
+    textureImageResult.m_channels  = channels;
+    textureImageResult.m_encoding  = encoding;
+    
+    // NOTE: Texel bytes of the resident chain, for the texture memory report and the budget
+    TextureCacheLevel residentChain[TEXTURE_CACHE_MAX_MIPS] = {};
+    textureImageResult.m_texelBytes = GetMipChainLayout(x, y, mipLevels, channels, encoding, residentChain);
     
     return textureImageResult;
     
 }
 
 internal ImageResources CreateColorResources(VkDevice device, 
-                                             VkPhysicalDevice physicalDevice, 
+                                             DeviceMemoryAllocator * allocator, 
                                              VkFormat swapChainImageFormat, 
                                              VkExtent2D swapChainExtent,
                                              VkSampleCountFlagBits msaaSamples)
@@ -1599,7 +2204,7 @@ internal ImageResources CreateColorResources(VkDevice device,
     VkFormat colorFormat = swapChainImageFormat;
     
     ImageCreateResult imageResult = CreateImage(device,
-                                                physicalDevice,
+                                                allocator,
                                                 swapChainExtent.width,
                                                 swapChainExtent.height,
                                                 1,
@@ -1658,11 +2263,11 @@ internal VkSampler CreateTextureSampler(VkDevice device, VkPhysicalDevice physic
     return sampler;
 }
 
-internal ImageResources CreateDepthResources(VkDevice device, VkPhysicalDevice physicalDevice, VkExtent2D extent, VkSampleCountFlagBits msaaSamples)
+internal ImageResources CreateDepthResources(VkDevice device, VkPhysicalDevice physicalDevice, DeviceMemoryAllocator * allocator, VkExtent2D extent, VkSampleCountFlagBits msaaSamples)
 {
     VkFormat depthFormat = FindDepthFormat(physicalDevice);
     
-    ImageCreateResult depthImageResult = CreateImage(device, physicalDevice, extent.width, extent.height, 1, 
+    ImageCreateResult depthImageResult = CreateImage(device, allocator, extent.width, extent.height, 1, 
                                                      msaaSamples, 
                                                      depthFormat,
                                                      VK_IMAGE_TILING_OPTIMAL,
@@ -1678,76 +2283,138 @@ internal ImageResources CreateDepthResources(VkDevice device, VkPhysicalDevice p
     return resources;
 }
 
-internal BufferCreateResult
-CreateAndBindVertexBuffer(VkDevice device,
-                          VkCommandPool commandPool,
-                          VkQueue graphicsQueue,
-                          VkPhysicalDevice physicalDevice,
-                          std::vector<Vertex> & vertices)
+//====================================================
+//      NOTE: Geometry Buffers
+//====================================================
+
+internal void CreateGeometryBuffer(VulkanContext & context, VkDeviceSize size, VkBufferUsageFlags usage, GeometryBuffer * geometry)
 {
+    // NOTE: Written by the transfer queue, read by the graphics queue
+    UploadQueue & uploads = context.m_uploads;
+    uint32 queueFamilies[] = { uploads.m_graphicsFamily, uploads.m_transferFamily };
+    uint32 queueFamilyCount = uploads.m_dedicatedTransfer ? ArrayCount(queueFamilies) : 1;
     
-    VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-    BufferCreateResult staginBufferResult = CreateBuffer(device,
-                                                         physicalDevice,
-                                                         bufferSize,
-                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    BufferCreateResult result = CreateBuffer(context.m_device,
+                                             &context.m_deviceMemory,
+                                             size,
+                                             VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | usage,
+                                             VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                                             queueFamilyCount,
+                                             queueFamilies);
     
-    void * data;
-    // NOTE: memory must have been created with a memory type that reports VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
-    vkMapMemory(device, staginBufferResult.m_bufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, vertices.data(), (uint32)bufferSize);
-    vkUnmapMemory(device, staginBufferResult.m_bufferMemory);
+    *geometry = {};
+    geometry->m_buffer     = result.m_buffer;
+    geometry->m_allocation = result.m_allocation;
+    geometry->m_usage      = usage;
+    geometry->m_size       = size;
+}
+
+internal void DestroyGeometryBuffer(VulkanContext & context, GeometryBuffer * geometry)
+{
+    vkDestroyBuffer(context.m_device, geometry->m_buffer, nullptr);
+    FreeDeviceMemory(&context.m_deviceMemory, &geometry->m_allocation);
+    *geometry = {};
+}
+
+// NOTE: Copies everything handed out so far into a buffer of at least minSize. Offsets stay the same, so nothing
+//       but the VkBuffer changes for the models already in it
+internal void GrowGeometryBuffer(VulkanContext & context, GeometryBuffer * geometry, VkDeviceSize minSize)
+{
+    VkDeviceSize size = geometry->m_size;
+    while (size < minSize)
+    {
+        size *= 2;
+    }
     
-    BufferCreateResult vertexBufferResult = CreateBuffer(device,
-                                                         physicalDevice,
-                                                         bufferSize,
-                                                         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-                                                         VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    SM_TRACE("growing geometry buffer from %.2f MB to %.2f MB", (real32)geometry->m_size / MB(1), (real32)size / MB(1));
     
-    CopyBuffer(device, commandPool, graphicsQueue, staginBufferResult.m_buffer, vertexBufferResult.m_buffer, bufferSize);
+    GeometryBuffer grown = {};
+    CreateGeometryBuffer(context, size, geometry->m_usage, &grown);
+    grown.m_used = geometry->m_used;
     
-    vkDestroyBuffer(device, staginBufferResult.m_buffer, nullptr);
-    vkFreeMemory(device, staginBufferResult.m_bufferMemory, nullptr);
+    if (geometry->m_used)
+    {
+        VkCommandBuffer commandBuffer = GetUploadCommands(&context.m_uploads);
+        
+        // NOTE: Copies into the old buffer may still be in flight on the same queue
+        VkMemoryBarrier barrier = {};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                             1, &barrier, 0, nullptr, 0, nullptr);
+        
+        CopyBuffer(commandBuffer, geometry->m_buffer, 0, grown.m_buffer, 0, geometry->m_used);
+    }
     
-    return vertexBufferResult;
+    // NOTE: Frames in flight still draw from the old buffer
+    WaitForGraphicsQueue(context);
+    DestroyGeometryBuffer(context, geometry);
+    *geometry = grown;
 }
 
-internal BufferCreateResult
-CreateAndBindIndexBuffer(VkDevice device,
-                         VkCommandPool commandPool,
-                         VkQueue graphicsQueue,
-                         VkPhysicalDevice physicalDevice,
-                         std::vector<uint32> & indices)
+// NOTE: Hands out size bytes at a multiple of alignment, which does not have to be a power of two
+internal VkDeviceSize AllocateGeometry(VulkanContext & context, GeometryBuffer * geometry, VkDeviceSize size, VkDeviceSize alignment)
 {
-    VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-    BufferCreateResult staginBufferResult = CreateBuffer(device,
-                                                         physicalDevice,
-                                                         bufferSize,
-                                                         VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-                                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    VkDeviceSize offset = (geometry->m_used + alignment - 1) / alignment * alignment;
+    if (offset + size > geometry->m_size)
+    {
+        GrowGeometryBuffer(context, geometry, offset + size);
+    }
     
-    void * data;
-    vkMapMemory(device, staginBufferResult.m_bufferMemory, 0, bufferSize, 0, &data);
-    memcpy(data, indices.data(), (uint32)bufferSize);
-    vkUnmapMemory(device, staginBufferResult.m_bufferMemory);
+    geometry->m_used = offset + size;
+    return offset;
+}
+
+// NOTE: Allocates first, growing may submit the open batch and a staging range has to be copied out of in the
+//       batch it was acquired for
+internal VkDeviceSize UploadGeometry(VulkanContext & context, GeometryBuffer * geometry, const void * data, VkDeviceSize size, VkDeviceSize alignment)
+{
+    VkDeviceSize offset = AllocateGeometry(context, geometry, size, alignment);
+    if (size == 0)
+    {
+        return offset;
+    }
     
-    BufferCreateResult indexBufferResult = CreateBuffer(device,
-                                                        physicalDevice,
-                                                        bufferSize,
-                                                        VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-                                                        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    StagingAllocation staging = AcquireUploadMemory(&context.m_uploads, size);
+    memcpy(staging.m_data, data, (size_t)size);
     
-    CopyBuffer(device, commandPool, graphicsQueue, staginBufferResult.m_buffer, indexBufferResult.m_buffer, bufferSize);
+    CopyBuffer(GetUploadCommands(&context.m_uploads), staging.m_buffer, staging.m_offset, geometry->m_buffer, offset, size);
     
-    vkDestroyBuffer(device, staginBufferResult.m_buffer, nullptr);
-    vkFreeMemory(device, staginBufferResult.m_bufferMemory, nullptr);
+    return offset;
+}
+
+// NOTE: Into the geometry index buffer of indexType, uint16 indices are narrowed straight into the staging memory,
+//       the caller made sure every index fits. Returns the first index
+internal uint32 UploadGeometryIndices(VulkanContext & context, VkIndexType indexType, const std::vector<uint32> & indices)
+{
+    if (indexType == VK_INDEX_TYPE_UINT32)
+    {
+        VkDeviceSize offset = UploadGeometry(context, &context.m_geometryIndices32, indices.data(),
+                                             sizeof(uint32) * indices.size(), sizeof(uint32));
+        return (uint32)(offset / sizeof(uint32));
+    }
+    
+    GeometryBuffer * geometry = &context.m_geometryIndices16;
+    VkDeviceSize size = sizeof(uint16) * indices.size();
+    VkDeviceSize offset = AllocateGeometry(context, geometry, size, sizeof(uint16));
+    if (size > 0)
+    {
+        StagingAllocation staging = AcquireUploadMemory(&context.m_uploads, size);
+        uint16 * dest = (uint16 *)staging.m_data;
+        for (size_t i = 0; i < indices.size(); i++)
+        {
+            dest[i] = (uint16)indices[i];
+        }
+        
+        CopyBuffer(GetUploadCommands(&context.m_uploads), staging.m_buffer, staging.m_offset, geometry->m_buffer, offset, size);
+    }
     
-    return indexBufferResult;
+    return (uint32)(offset / sizeof(uint16));
 }
 
 internal UniformBufferCreateResult
-CreateUniformBuffers(VkDevice device, VkPhysicalDevice physicalDevice)
+CreateUniformBuffers(VkDevice device, DeviceMemoryAllocator * allocator)
 {
     UniformBufferCreateResult result = {};
     
@@ -1756,17 +2423,14 @@ CreateUniformBuffers(VkDevice device, VkPhysicalDevice physicalDevice)
     for (uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         BufferCreateResult bufferResult = CreateBuffer(device,
-                                                       physicalDevice,
+                                                       allocator,
                                                        bufferSize,
                                                        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
                                                        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
         
         result.m_uniformBuffers.Add(bufferResult.m_buffer);
-        result.m_uniformBuffersMemory.Add(bufferResult.m_bufferMemory);
-        
-        void * data;
-        vkMapMemory(device, bufferResult.m_bufferMemory, 0, bufferSize, 0, &data);
-        result.m_uniformBuffersMapped.Add(data);
+        result.m_uniformBufferAllocations.Add(bufferResult.m_allocation);
+        result.m_uniformBuffersMapped.Add(bufferResult.m_allocation.m_mapped);
     }
     
     return result;
@@ -2066,20 +2730,20 @@ internal void RecreateSwapChain(Application * app, GLFWwindow* window, VulkanCon
     {
         uint32 imageCount = (uint32)context.m_swapChainImages.size();
         context.m_sceneImages.resize(imageCount);
-        context.m_sceneImageMemories.resize(imageCount);
+        context.m_sceneImageAllocations.resize(imageCount);
         context.m_sceneImageViews.resize(imageCount);
         
         for (uint32 i = 0; i < imageCount; i++)
         {
             ImageResources sceneImageResources = CreateSceneImage(context.m_device,
-                                                                  context.m_physicalDevice,
+                                                                  &context.m_deviceMemory,
                                                                   context.m_commandPool,
                                                                   context.m_graphicsQueue,
                                                                   context.m_swapChainImageFormat,
                                                                   context.m_swapChainExtent);
             
             context.m_sceneImages[i] = sceneImageResources.m_imageResult.m_image;
-            context.m_sceneImageMemories[i] = sceneImageResources.m_imageResult.m_imageMemory;
+            context.m_sceneImageAllocations[i] = sceneImageResources.m_imageResult.m_allocation;
             context.m_sceneImageViews[i] = sceneImageResources.m_imageView;
             
         }
@@ -2091,24 +2755,25 @@ internal void RecreateSwapChain(Application * app, GLFWwindow* window, VulkanCon
     
     {
         ImageResources resources = CreateColorResources(context.m_device, 
-                                                        context.m_physicalDevice, 
+                                                        &context.m_deviceMemory, 
                                                         context.m_swapChainImageFormat,
                                                         context.m_swapChainExtent,
                                                         context.m_msaaSamples);
         
         context.m_colorImage = resources.m_imageResult.m_image;
-        context.m_colorImageMemory = resources.m_imageResult.m_imageMemory;
+        context.m_colorImageAllocation = resources.m_imageResult.m_allocation;
         context.m_colorImageView = resources.m_imageView;
     }
     
     {
         ImageResources result = CreateDepthResources(context.m_device,
                                                      context.m_physicalDevice, 
+                                                     &context.m_deviceMemory,
                                                      context.m_swapChainExtent, 
                                                      context.m_msaaSamples);
         
         context.m_depthImage       = result.m_imageResult.m_image;
-        context.m_depthImageMemory = result.m_imageResult.m_imageMemory;
+        context.m_depthImageAllocation = result.m_imageResult.m_allocation;
         context.m_depthImageView   = result.m_imageView;
     }
     
@@ -2150,19 +2815,28 @@ internal void UpdateUniformBuffer(VulkanContext & context, RenderData * renderDa
     memcpy(context.m_uniformBuffersMapped[context.m_currentFrame], &ubo, sizeof(ubo));
 }
 
-
+internal TextureHandle GetDrawRangeTexture(const ModelDrawRange & range, const Transform & transform)
+{
+    return range.m_texture == INVALID_ASSET_HANDLE ? transform.m_texture : range.m_texture;
+}
 
 internal
 void RecordCommandBuffer(VkCommandBuffer & commandBuffer, 
                          VkRenderPass & renderPass,
                          VkFramebuffer & frameBuffer,
                          VkExtent2D & extent,
-                         VkPipeline & graphicsPipeline,
-                         VkPipelineLayout & pipelineLayout,
+                         VkPipeline * graphicsPipelines,
+                         VkPipelineLayout * pipelineLayouts,
+                         VkBuffer vertexBuffer,
+                         VkBuffer indexBuffer16,
+                         VkBuffer indexBuffer32,
                          std::vector<ModelContext> & modelContexts,
                          std::vector<TextureContext> & textureContexts,
+                         ModelContext & placeholderModel,
+                         TextureContext & placeholderTexture,
                          RenderData * renderData,
-                         uint32 currentFrame)
+                         uint32 currentFrame,
+                         uint32 frameNumber)
 {
     
     VkCommandBufferBeginInfo beginInfo = {};
@@ -2191,7 +2865,6 @@ void RecordCommandBuffer(VkCommandBuffer & commandBuffer,
     renderPassInfo.pClearValues = clearValues;
 
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
     
     VkViewport viewport = {};
     viewport.x = 0;
@@ -2207,49 +2880,87 @@ void RecordCommandBuffer(VkCommandBuffer & commandBuffer,
     scissor.extent = extent;
     vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
     
-    for (uint32 i = 0; i < renderData->m_transforms.count; i++)
-    {
-        Transform & transform = renderData->m_transforms[i];
-        ModelContext & modelContext = modelContexts[i];
-        TextureContext & textureContext = textureContexts[i];
-        
-    VkBuffer vertexBuffers[] = { modelContext.m_vertexBuffer };
+    // NOTE: Every model lives in the same vertex buffer, both vertex formats included
+    VkBuffer vertexBuffers[] = { vertexBuffer };
     VkDeviceSize offsets[] = { 0 };
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
     
-    vkCmdBindIndexBuffer(commandBuffer, modelContext.m_indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-    
-    vkCmdBindDescriptorSets(commandBuffer,
-                            VK_PIPELINE_BIND_POINT_GRAPHICS,
-                            pipelineLayout,
-                            0,
-                            1,
-                            &textureContext.m_descriptorSets[currentFrame],
-                            0,
-                            nullptr);
-    
-    FragPushConstants fragConsts = {};
-    fragConsts.m_viewDistence = renderData->m_fog.m_viewDistence;
-    fragConsts.m_steepness = renderData->m_fog.m_steepness;
-    fragConsts.m_fogColor = renderData->m_fog.m_fogColor;
+    // NOTE: One pass per index type, so each index buffer is bound at most once a frame
+    VkIndexType indexTypes[] = { VK_INDEX_TYPE_UINT16, VK_INDEX_TYPE_UINT32 };
+    VkBuffer indexBuffers[] = { indexBuffer16, indexBuffer32 };
     
-    vkCmdPushConstants(commandBuffer,
-                       pipelineLayout, 
-                       VK_SHADER_STAGE_FRAGMENT_BIT, 
-                       sizeof(VertPushConstants), sizeof(fragConsts), 
-                       &fragConsts);
-    
-    for (glm::vec3 meshPosition : transform.m_meshPositions)
+    VertexFormat boundFormat = VERTEX_FORMAT_COUNT;
+    for (uint32 pass = 0; pass < ArrayCount(indexTypes); pass++)
     {
-        VertPushConstants meshConstants = {};
-        meshConstants.m_model = glm::translate(glm::mat4(1.0), meshPosition);
-        vkCmdPushConstants(commandBuffer,
-                           pipelineLayout, 
-                           VK_SHADER_STAGE_VERTEX_BIT, 
-                           0, sizeof(meshConstants), 
-                           &meshConstants);
-        vkCmdDrawIndexed(commandBuffer, (uint32)transform.m_model.m_indices.size(), 1, 0, 0, 0);
-    }
+        bool indicesBound = false;
+        for (uint32 i = 0; i < renderData->m_transforms.count; i++)
+        {
+            Transform & transform = renderData->m_transforms[i];
+            
+            // NOTE: Assets still streaming in draw with the placeholder until their upload lands
+            AssetRegistry & assets = renderData->m_assets;
+            ModelContext & modelContext = IsAssetResident(&assets.m_models, transform.m_model) ? modelContexts[transform.m_model] : placeholderModel;
+            if (modelContext.m_indexType != indexTypes[pass])
+            {
+                continue;
+            }
+            
+            if (!indicesBound)
+            {
+                vkCmdBindIndexBuffer(commandBuffer, indexBuffers[pass], 0, indexTypes[pass]);
+                indicesBound = true;
+            }
+            
+            // NOTE: The pipeline only changes between models of different vertex formats
+            VkPipelineLayout pipelineLayout = pipelineLayouts[modelContext.m_vertexFormat];
+            if (boundFormat != modelContext.m_vertexFormat)
+            {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[modelContext.m_vertexFormat]);
+                boundFormat = modelContext.m_vertexFormat;
+            }
+            
+            FragPushConstants fragConsts = {};
+            fragConsts.m_viewDistence = renderData->m_fog.m_viewDistence;
+            fragConsts.m_steepness = renderData->m_fog.m_steepness;
+            fragConsts.m_fogColor = renderData->m_fog.m_fogColor;
+            
+            vkCmdPushConstants(commandBuffer,
+                               pipelineLayout, 
+                               VK_SHADER_STAGE_FRAGMENT_BIT, 
+                               sizeof(VertPushConstants), sizeof(fragConsts), 
+                               &fragConsts);
+            
+            // NOTE: Range by range, so every material texture is bound once per transform
+            for (const ModelDrawRange & range : modelContext.m_drawRanges)
+            {
+                TextureHandle textureHandle = GetDrawRangeTexture(range, transform);
+                TextureContext & textureContext = IsAssetResident(&assets.m_textures, textureHandle) ? textureContexts[textureHandle] : placeholderTexture;
+                
+                // NOTE: For the texture residency LRU, the placeholder's stamp is never looked at
+                textureContext.m_lastUsedFrame = frameNumber;
+                
+                vkCmdBindDescriptorSets(commandBuffer,
+                                        VK_PIPELINE_BIND_POINT_GRAPHICS,
+                                        pipelineLayout,
+                                        0,
+                                        1,
+                                        &textureContext.m_descriptorSets[currentFrame],
+                                        0,
+                                        nullptr);
+                
+                for (glm::vec3 meshPosition : transform.m_meshPositions)
+                {
+                    VertPushConstants meshConstants = {};
+                    meshConstants.m_model = glm::translate(glm::mat4(1.0), meshPosition) * modelContext.m_dequantize;
+                    vkCmdPushConstants(commandBuffer,
+                                       pipelineLayout, 
+                                       VK_SHADER_STAGE_VERTEX_BIT, 
+                                       0, sizeof(meshConstants), 
+                                       &meshConstants);
+                    vkCmdDrawIndexed(commandBuffer, range.m_indexCount, 1, range.m_firstIndex, modelContext.m_vertexOffset, 0);
+                }
+            }
+        }
     }
     
     vkCmdEndRenderPass(commandBuffer);
@@ -2309,22 +3020,32 @@ internal void RecreateGrahpicsPipeline(VulkanContext & context)
 {
     vkDeviceWaitIdle(context.m_device);
     
-    vkDestroyPipeline(context.m_device, context.m_sceneGraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(context.m_device, context.m_scenePipelineLayout, nullptr);
-    
-    CreateGraphicsPipelineResult result =
-        CreateGraphicsPipeline(context.m_device, context.m_swapChainExtent, context.m_sceneRenderPass, context.m_sceneDescriptorSetLayout, context.m_msaaSamples);
-    
-    context.m_scenePipelineLayout  = result.m_pipelineLayout;
-    context.m_sceneGraphicsPipeline = result.m_graphicsPipeline;
+    for (uint32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
+    {
+        vkDestroyPipeline(context.m_device, context.m_sceneGraphicsPipelines[format], nullptr);
+        vkDestroyPipelineLayout(context.m_device, context.m_scenePipelineLayouts[format], nullptr);
+        
+        CreateGraphicsPipelineResult result =
+            CreateGraphicsPipeline(context.m_device, context.m_swapChainExtent, context.m_sceneRenderPass, context.m_sceneDescriptorSetLayout, context.m_msaaSamples, (VertexFormat)format);
+        
+        context.m_scenePipelineLayouts[format]   = result.m_pipelineLayout;
+        context.m_sceneGraphicsPipelines[format] = result.m_graphicsPipeline;
+    }
     
 }
 
+internal void FreeRetiredTextures(VulkanContext & context, bool all);
+
 internal void DrawFrame(Application * app, RenderData * renderData)
 {
 
     VulkanContext & context = app->m_renderContext;
     vkWaitForFences(context.m_device, 1, &context.m_inFlightFences[context.m_currentFrame], VK_TRUE, UINT64_MAX);
+    
+    // NOTE: Recycles the upload batches that finished along with their staging memory, then the textures they
+    //       and the finished frames were the last to use
+    PollUploads(&context.m_uploads);
+    FreeRetiredTextures(context, false);
 
     if (renderData->m_screenHeight <= 0.001f || renderData->m_screenWidth <= 0.001f)
     {
@@ -2332,9 +3053,12 @@ internal void DrawFrame(Application * app, RenderData * renderData)
     }
     
     {
-        int64 timestampVS = GetTimestamp(VS_PATH);
-        int64 timestampFS = GetTimestamp(FS_PATH);
-        int64 currentTimeStamp = max(timestampVS, timestampFS);
+        // NOTE: Archived shaders keep their packed timestamp, so hot reload only picks up loose files
+        int64 currentTimeStamp = GetResourceTimestamp(FS_PATH);
+        for (uint32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
+        {
+            currentTimeStamp = max(currentTimeStamp, GetResourceTimestamp(VS_PATHS[format]));
+        }
         if (KeyIsDown(app->m_input, GLFW_KEY_R) && currentTimeStamp > app->m_renderContext.m_shaderTimestamp)
         {
             RecreateGrahpicsPipeline(app->m_renderContext);
@@ -2375,12 +3099,18 @@ internal void DrawFrame(Application * app, RenderData * renderData)
                         context.m_sceneRenderPass,
                         context.m_sceneFramebuffers[imageIndex],
                         context.m_swapChainExtent,
-                        context.m_sceneGraphicsPipeline, 
-                        context.m_scenePipelineLayout,
+                        context.m_sceneGraphicsPipelines, 
+                        context.m_scenePipelineLayouts,
+                        context.m_geometryVertices.m_buffer,
+                        context.m_geometryIndices16.m_buffer,
+                        context.m_geometryIndices32.m_buffer,
                         context.m_modelContexts,
                         context.m_textureContexts,
+                        context.m_placeholderModel,
+                        context.m_placeholderTexture,
                         renderData,
-                        context.m_currentFrame);
+                        context.m_currentFrame,
+                        context.m_textureResidency.m_frameNumber);
 
     UpdateUniformBuffer(context, renderData);
     
@@ -2404,6 +3134,9 @@ internal void DrawFrame(Application * app, RenderData * renderData)
     submitInfo.signalSemaphoreCount = ArrayCount(signalSemaphores);
     submitInfo.pSignalSemaphores = signalSemaphores;
     
+    // NOTE: Everything uploaded since the last frame goes out in one batch ahead of the frame that draws it
+    SubmitUploads(&context.m_uploads);
+    
     if (vkQueueSubmit(context.m_graphicsQueue, 1, &submitInfo, context.m_inFlightFences[context.m_currentFrame]) != VK_SUCCESS)
     {
         SM_ASSERT(false, "failed to submit draw command buffer!");
@@ -2434,8 +3167,642 @@ internal void DrawFrame(Application * app, RenderData * renderData)
     
     
     context.m_currentFrame = (context.m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    context.m_textureResidency.m_frameNumber++;
+}
+
+internal ModelContext CreateModelContext(VulkanContext & context, Model & model)
+{
+    ModelContext modelContext = {};
+    {
+        void * vertices = model.m_vertices.data();
+        VkDeviceSize vertexBufferSize = sizeof(Vertex) * model.m_vertices.size();
+        VkDeviceSize vertexStride = sizeof(Vertex);
+        
+        if (model.m_vertexFormat == VERTEX_FORMAT_PACKED)
+        {
+            vertices = model.m_packedVertices.data();
+            vertexBufferSize = sizeof(PackedVertex) * model.m_packedVertices.size();
+            vertexStride = sizeof(PackedVertex);
+            
+            modelContext.m_dequantize = glm::scale(glm::translate(glm::mat4(1.0f), model.m_aabbMin), model.m_aabbMax - model.m_aabbMin);
+        }
+        modelContext.m_vertexFormat = model.m_vertexFormat;
+        
+        glm::vec3 aabbMin = model.m_aabbMin;
+        glm::vec3 aabbMax = model.m_aabbMax;
+        if (model.m_vertexFormat == VERTEX_FORMAT_FLOAT && !model.m_vertices.empty())
+        {
+            aabbMin = aabbMax = model.m_vertices[0].m_pos;
+            for (const Vertex & vertex : model.m_vertices)
+            {
+                aabbMin = glm::min(aabbMin, vertex.m_pos);
+                aabbMax = glm::max(aabbMax, vertex.m_pos);
+            }
+        }
+        modelContext.m_boundsCenter = (aabbMin + aabbMax) * 0.5f;
+        modelContext.m_boundsRadius = glm::length(aabbMax - aabbMin) * 0.5f;
+        
+        // NOTE: Aligned to the stride, vertexOffset counts whole vertices
+        VkDeviceSize vertexOffset = UploadGeometry(context, &context.m_geometryVertices, vertices, vertexBufferSize, vertexStride);
+        modelContext.m_vertexOffset = (int32)(vertexOffset / vertexStride);
+        
+        // NOTE: Without primitive restart every value of a uint16 index is a valid vertex, vertexOffset is added after
+        uint32 vertexCount = (uint32)(vertexBufferSize / vertexStride);
+        modelContext.m_indexType = vertexCount <= 65536 ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+    }
+    
+    {
+        modelContext.m_firstIndex = UploadGeometryIndices(context, modelContext.m_indexType, model.m_indices);
+        modelContext.m_indexCount = (uint32)model.m_indices.size();
+        
+        for (const ModelMaterial & material : model.m_materials)
+        {
+            ModelDrawRange range = {};
+            range.m_firstIndex = modelContext.m_firstIndex + material.m_firstIndex;
+            range.m_indexCount = material.m_indexCount;
+            modelContext.m_drawRanges.push_back(range);
+        }
+        if (modelContext.m_drawRanges.empty())
+        {
+            ModelDrawRange range = {};
+            range.m_firstIndex = modelContext.m_firstIndex;
+            range.m_indexCount = modelContext.m_indexCount;
+            modelContext.m_drawRanges.push_back(range);
+        }
+    }
+    
+    return modelContext;
+}
+
+// NOTE: Needs the sampler, uniform buffers and scene descriptor pool to exist already
+internal TextureContext CreateTextureContext(VulkanContext & context, const TextureData & textureData, uint32 firstMip)
+{
+    ImageCreateResult result = CreateTextureImage(context.m_device, 
+                                                  context.m_physicalDevice, 
+                                                  &context.m_deviceMemory,
+                                                  &context.m_uploads,
+                                                  textureData,
+                                                  context.m_textureCompressionBC,
+                                                  firstMip);
+    
+    TextureContext texture = {};
+    texture.m_textureImage       = result.m_image;
+    texture.m_textureImageAllocation = result.m_allocation;
+    texture.m_mipLevels          = result.m_mipLevels;
+    texture.m_format             = result.m_format;
+    texture.m_texelBytes         = result.m_texelBytes;
+    texture.m_width              = textureData.m_width;
+    texture.m_height             = textureData.m_height;
+    texture.m_firstMip           = firstMip;
+    texture.m_channels           = result.m_channels;
+    texture.m_encoding           = result.m_encoding;
+    texture.m_lastUsedFrame      = context.m_textureResidency.m_frameNumber;
+    texture.m_wantedMip          = firstMip;
+    texture.m_textureImageView   = CreateTextureImageView(context.m_device, texture.m_textureImage, texture.m_format, texture.m_mipLevels);
+    texture.m_descriptorSets     = CreateDescriptorSets(context.m_device,
+                                                        context.m_uniformBuffers,
+                                                        context.m_sceneDescriptorPool,
+                                                        context.m_sceneDescriptorSetLayout,
+                                                        texture.m_textureImageView,
+                                                        context.m_textureSampler);
+    return texture;
+}
+
+// NOTE: Its vertices and indices are released with the geometry buffers
+internal void DestroyModelContext(VulkanContext & context, ModelContext & modelContext)
+{
+    modelContext = {};
+}
+
+internal void DestroyTextureContext(VulkanContext & context, TextureContext & textureContext)
+{
+    if (textureContext.m_descriptorSets.count)
+    {
+        vkFreeDescriptorSets(context.m_device, context.m_sceneDescriptorPool, textureContext.m_descriptorSets.count, textureContext.m_descriptorSets.elements);
+    }
+    vkDestroyImageView(context.m_device, textureContext.m_textureImageView, nullptr);
+    vkDestroyImage(context.m_device, textureContext.m_textureImage, nullptr);
+    FreeDeviceMemory(&context.m_deviceMemory, &textureContext.m_textureImageAllocation);
+    textureContext = {};
+}
+
+// NOTE: Called from the main loop once a streamed model finished parsing on a worker
+internal void UploadModel(VulkanContext & context, ModelHandle handle, Model & model)
+{
+    if (context.m_modelContexts.size() <= handle)
+    {
+        context.m_modelContexts.resize(handle + 1);
+    }
+    context.m_modelContexts[handle] = CreateModelContext(context, model);
+}
+
+//====================================================
+//      NOTE: Texture Residency
+//====================================================
+
+// NOTE: Texel bytes of the chain from firstMip down, in the layout the texture's image uses
+internal uint64 GetTextureChainBytes(const TextureContext & texture, uint32 firstMip, uint32 channels, TextureEncoding encoding)
+{
+    TextureCacheLevel levels[TEXTURE_CACHE_MAX_MIPS] = {};
+    uint32 mipLevels = GetMipLevelCount(texture.m_width, texture.m_height);
+    return GetMipChainLayout(std::max(texture.m_width >> firstMip, 1u), std::max(texture.m_height >> firstMip, 1u),
+                             mipLevels - firstMip, channels, encoding, levels);
+}
+
+internal uint64 GetTextureChainBytes(const TextureContext & texture, uint32 firstMip)
+{
+    return GetTextureChainBytes(texture, firstMip, texture.m_channels, texture.m_encoding);
+}
+
+// NOTE: m_rgba8Bytes is what the same resident levels would have cost expanded to RGBA8, the way every texture
+//       used to be loaded
+internal void AddTextureMemory(TextureMemoryStats & stats, const TextureContext & texture)
+{
+    stats.m_texelBytes += texture.m_texelBytes;
+    stats.m_rgba8Bytes += GetTextureChainBytes(texture, texture.m_firstMip, 4, TEXTURE_ENCODING_RAW);
+}
+
+internal void RemoveTextureMemory(TextureMemoryStats & stats, const TextureContext & texture)
+{
+    stats.m_texelBytes -= texture.m_texelBytes;
+    stats.m_rgba8Bytes -= GetTextureChainBytes(texture, texture.m_firstMip, 4, TEXTURE_ENCODING_RAW);
+}
+
+internal bool CanDropTextureMip(const TextureContext & texture, uint32 firstMip)
+{
+    return std::max(texture.m_width >> (firstMip + 1), texture.m_height >> (firstMip + 1)) >= TEXTURE_RESIDENT_MIN_SIZE;
+}
+
+// NOTE: Textures drawn by the last recorded frame are in use, everything else is up for eviction
+internal bool IsTextureIdle(const TextureResidency & residency, const TextureContext & texture)
+{
+    return texture.m_lastUsedFrame + 1 < residency.m_frameNumber;
+}
+
+// NOTE: Destroys the retired textures no frame in flight draws and no pending upload copies out of anymore, all of
+//       them with all set. Called once the frame fence is waited on, frames before it minus MAX_FRAMES_IN_FLIGHT are done
+internal void FreeRetiredTextures(VulkanContext & context, bool all)
+{
+    uint32 frameNumber = context.m_textureResidency.m_frameNumber;
+    std::vector<RetiredTexture> & retired = context.m_retiredTextures;
+    for (uint32 i = 0; i < retired.size();)
+    {
+        bool framesDone = retired[i].m_frameNumber + MAX_FRAMES_IN_FLIGHT <= frameNumber + 1;
+        bool uploadsDone = retired[i].m_ticket <= context.m_uploads.m_completed;
+        if (all || (framesDone && uploadsDone))
+        {
+            DestroyTextureContext(context, retired[i].m_texture);
+            retired[i] = retired.back();
+            retired.pop_back();
+        }
+        else
+        {
+            i++;
+        }
+    }
+}
+
+// NOTE: Takes the image of texture away from it and destroys it once nothing in flight uses it anymore, so the
+//       caller can put a new one in its place right away. Clears texture
+internal void RetireTextureContext(VulkanContext & context, TextureContext & texture)
+{
+    if (context.m_retiredTextures.size() >= RETIRED_TEXTURE_LIMIT)
+    {
+        // NOTE: Out of reserved descriptor sets
+        SM_TRACE("more than %u textures retired at once, waiting for the GPU", RETIRED_TEXTURE_LIMIT);
+        WaitForGraphicsQueue(context);
+        FreeRetiredTextures(context, true);
+    }
+    
+    RetiredTexture retired = {};
+    retired.m_texture     = texture;
+    retired.m_frameNumber = context.m_textureResidency.m_frameNumber;
+    retired.m_ticket      = context.m_uploads.m_nextTicket - 1;
+    context.m_retiredTextures.push_back(retired);
+    
+    texture = {};
+}
+
+// NOTE: Copies the levels from firstMip down into a smaller image on the GPU, no CPU side data needed. Frames
+//       submitted before the copy still sample the old image, the barrier out of VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+//       waits for them
+internal void DropTextureMips(VulkanContext & context, TextureContext & texture, uint32 firstMip)
+{
+    SM_ASSERT(firstMip > texture.m_firstMip, "dropping mips has to drop at least one level!");
+    
+    uint32 dropped   = firstMip - texture.m_firstMip;
+    uint32 mipLevels = texture.m_mipLevels - dropped;
+    uint32 width     = std::max(texture.m_width >> firstMip, 1u);
+    uint32 height    = std::max(texture.m_height >> firstMip, 1u);
+    
+    ImageCreateResult result = CreateImage(context.m_device,
+                                           &context.m_deviceMemory,
+                                           width,
+                                           height,
+                                           mipLevels,
+                                           VK_SAMPLE_COUNT_1_BIT,
+                                           texture.m_format,
+                                           VK_IMAGE_TILING_OPTIMAL,
+                                           VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+                                           VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
+    
+    // NOTE: The texture belongs to the graphics queue, so the copy stays on it
+    VkCommandBuffer commandBuffer = GetUploadGraphicsCommands(&context.m_uploads);
+    
+    VkImageMemoryBarrier barriers[2] = {};
+    for (uint32 i = 0; i < ArrayCount(barriers); i++)
+    {
+        barriers[i].sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barriers[i].srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+        barriers[i].subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        barriers[i].subresourceRange.baseArrayLayer = 0;
+        barriers[i].subresourceRange.layerCount = 1;
+    }
+    
+    barriers[0].image = texture.m_textureImage;
+    barriers[0].oldLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[0].newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+    barriers[0].srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    barriers[0].dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barriers[0].subresourceRange.baseMipLevel = dropped;
+    barriers[0].subresourceRange.levelCount = mipLevels;
+    
+    barriers[1].image = result.m_image;
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].srcAccessMask = 0;
+    barriers[1].dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].subresourceRange.baseMipLevel = 0;
+    barriers[1].subresourceRange.levelCount = mipLevels;
+    
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+                         0, nullptr, 0, nullptr, ArrayCount(barriers), barriers);
+    
+    // NOTE: Whole levels, so block compressed extents that are not a multiple of the block size are still valid
+    VkImageCopy regions[TEXTURE_CACHE_MAX_MIPS] = {};
+    for (uint32 level = 0; level < mipLevels; level++)
+    {
+        VkImageCopy & region = regions[level];
+        region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, dropped + level, 0, 1 };
+        region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, level, 0, 1 };
+        region.extent = { std::max(width >> level, 1u), std::max(height >> level, 1u), 1 };
+    }
+    
+    vkCmdCopyImage(commandBuffer,
+                   texture.m_textureImage, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+                   result.m_image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                   mipLevels, regions);
+    
+    barriers[1].oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+    barriers[1].newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+    barriers[1].srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barriers[1].dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+                         0, nullptr, 0, nullptr, 1, &barriers[1]);
+    
+    RemoveTextureMemory(context.m_textureMemory, texture);
+    
+    TextureContext reduced = texture;
+    RetireTextureContext(context, texture);
+    
+    reduced.m_textureImage       = result.m_image;
+    reduced.m_textureImageAllocation = result.m_allocation;
+    reduced.m_mipLevels          = mipLevels;
+    reduced.m_firstMip           = firstMip;
+    reduced.m_texelBytes         = GetTextureChainBytes(reduced, firstMip);
+    reduced.m_textureImageView   = CreateTextureImageView(context.m_device, reduced.m_textureImage, reduced.m_format, reduced.m_mipLevels);
+    reduced.m_descriptorSets     = CreateDescriptorSets(context.m_device,
+                                                        context.m_uniformBuffers,
+                                                        context.m_sceneDescriptorPool,
+                                                        context.m_sceneDescriptorSetLayout,
+                                                        reduced.m_textureImageView,
+                                                        context.m_textureSampler);
+    texture = reduced;
+    
+    AddTextureMemory(context.m_textureMemory, texture);
+}
+
+// NOTE: Drops the image, the next acquire or restore of the texture streams it in again like a first load
+internal void EvictTexture(VulkanContext & context, AssetTable * textures, TextureHandle handle)
+{
+    TextureContext & texture = context.m_textureContexts[handle];
+    RemoveTextureMemory(context.m_textureMemory, texture);
+    RetireTextureContext(context, texture);
+    MarkAssetUnloaded(textures, handle);
+}
+
+/*
+  NOTE: Frees device memory until bytes more fit in the budget, skipping the texture at skip.
+  Drawn textures holding finer mips than their size on screen needs give those up first. Then idle textures give up their top mips first, least recently drawn first, down to TEXTURE_RESIDENT_MIN_SIZE, and
+  only then their whole image. With degradeDrawn textures still being drawn drop top mips too, largest first, as
+  a last resort. Returns whether bytes fit now
+ */
+internal bool MakeTextureRoom(VulkanContext & context, AssetTable * textures, TextureHandle skip, uint64 bytes, bool degradeDrawn)
+{
+    TextureResidency & residency = context.m_textureResidency;
+    TextureMemoryStats & memory = context.m_textureMemory;
+    if (memory.m_texelBytes + bytes <= residency.m_budget)
+    {
+        return true;
+    }
+    
+    std::vector<TextureHandle> idle;
+    std::vector<TextureHandle> drawn;
+    for (TextureHandle handle = 0; handle < context.m_textureContexts.size(); handle++)
+    {
+        TextureContext & texture = context.m_textureContexts[handle];
+        if (handle != skip && texture.m_textureImage)
+        {
+            (IsTextureIdle(residency, texture) ? idle : drawn).push_back(handle);
+        }
+    }
+    
+    std::vector<TextureContext> & contexts = context.m_textureContexts;
+    std::sort(idle.begin(), idle.end(), [&contexts](TextureHandle a, TextureHandle b)
+              {
+                  return contexts[a].m_lastUsedFrame < contexts[b].m_lastUsedFrame;
+              });
+    std::sort(drawn.begin(), drawn.end(), [&contexts](TextureHandle a, TextureHandle b)
+              {
+                  return contexts[a].m_texelBytes > contexts[b].m_texelBytes;
+              });
+    
+    auto dropMips = [&](TextureHandle handle, uint32 lastMip)
+    {
+        TextureContext & texture = contexts[handle];
+        uint32 firstMip = texture.m_firstMip;
+        while (memory.m_texelBytes - texture.m_texelBytes + GetTextureChainBytes(texture, firstMip) + bytes > residency.m_budget &&
+               firstMip < lastMip && CanDropTextureMip(texture, firstMip))
+        {
+            firstMip++;
+        }
+        
+        if (firstMip > texture.m_firstMip)
+        {
+            DropTextureMips(context, texture, firstMip);
+        }
+        return memory.m_texelBytes + bytes <= residency.m_budget;
+    };
+    
+    for (TextureHandle handle : drawn)
+    {
+        if (dropMips(handle, contexts[handle].m_wantedMip))
+        {
+            return true;
+        }
+    }
+    
+    for (TextureHandle handle : idle)
+    {
+        if (dropMips(handle, TEXTURE_CACHE_MAX_MIPS))
+        {
+            return true;
+        }
+    }
+    
+    for (TextureHandle handle : idle)
+    {
+        EvictTexture(context, textures, handle);
+        SM_TRACE("evicted texture %s", GetAssetPath(textures, handle));
+        if (memory.m_texelBytes + bytes <= residency.m_budget)
+        {
+            return true;
+        }
+    }
+    
+    if (degradeDrawn)
+    {
+        for (TextureHandle handle : drawn)
+        {
+            if (dropMips(handle, TEXTURE_CACHE_MAX_MIPS))
+            {
+                return true;
+            }
+        }
+    }
+    
+    return false;
+}
+
+// NOTE: Called once per frame, picks up a budget lowered at runtime and uploads that had to go over it
+internal void EnforceTextureBudget(VulkanContext & context, AssetTable * textures)
+{
+    MakeTextureRoom(context, textures, INVALID_ASSET_HANDLE, 0, true);
+}
+
+// NOTE: True when a drawn texture is missing mips its size on screen asks for and at least one more of them fits,
+//       counting what evicting idle textures would free
+internal bool CanRestoreTextureMip(VulkanContext & context, TextureHandle handle)
+{
+    TextureContext & texture = context.m_textureContexts[handle];
+    if (texture.m_firstMip <= texture.m_wantedMip || texture.m_restorePending)
+    {
+        return false;
+    }
+    
+    uint64 idleBytes = 0;
+    for (TextureHandle other = 0; other < context.m_textureContexts.size(); other++)
+    {
+        TextureContext & otherTexture = context.m_textureContexts[other];
+        if (other != handle && otherTexture.m_textureImage && IsTextureIdle(context.m_textureResidency, otherTexture))
+        {
+            idleBytes += otherTexture.m_texelBytes;
+        }
+    }
+    
+    uint64 growth = GetTextureChainBytes(texture, texture.m_firstMip - 1) - texture.m_texelBytes;
+    return context.m_textureMemory.m_texelBytes + growth <= context.m_textureResidency.m_budget + idleBytes;
+}
+
+// NOTE: Coarsest level whose largest side still has a texel for every pixel the texture covers on screen
+internal uint32 GetScreenSizeMip(const TextureContext & texture, real32 screenSize)
+{
+    uint32 mipLevels = GetMipLevelCount(texture.m_width, texture.m_height);
+    uint32 largestSide = std::max(texture.m_width, texture.m_height);
+    
+    uint32 mip = 0;
+    while (mip + 1 < mipLevels && (real32)(largestSide >> (mip + 1)) >= screenSize)
+    {
+        mip++;
+    }
+    return mip;
+}
+
+/*
+  NOTE: Projects the bounding sphere of every instance of every transform and keeps, per texture, the finest mip
+  its largest instance needs. Assumes every texture is mapped once across the whole model, material ranges included.
+  Instances behind the camera need nothing, textures nothing draws end up wanting only their last level
+ */
+internal void UpdateTextureStreaming(VulkanContext & context, RenderData * renderData)
+{
+    for (TextureContext & texture : context.m_textureContexts)
+    {
+        if (texture.m_textureImage)
+        {
+            texture.m_wantedMip = STREAM_TEXTURE_MIPS ? GetMipLevelCount(texture.m_width, texture.m_height) - 1 : 0;
+        }
+    }
+    
+    if (!STREAM_TEXTURE_MIPS || renderData->m_screenHeight <= 0.001f)
+    {
+        return;
+    }
+    
+    // NOTE: Pixels one world unit covers at distance one, perspectiveFov takes the vertical fov
+    Camera & camera = renderData->m_camera;
+    real32 pixelsPerUnit = renderData->m_screenHeight / (2.0f * tanf(glm::radians(camera.m_fov) * 0.5f));
+    
+    AssetRegistry & assets = renderData->m_assets;
+    for (uint32 i = 0; i < renderData->m_transforms.count; i++)
+    {
+        Transform & transform = renderData->m_transforms[i];
+        ModelContext & model = IsAssetResident(&assets.m_models, transform.m_model) ? context.m_modelContexts[transform.m_model] : context.m_placeholderModel;
+        
+        real32 screenSize = 0.0f;
+        for (glm::vec3 meshPosition : transform.m_meshPositions)
+        {
+            glm::vec3 toCenter = meshPosition + model.m_boundsCenter - camera.m_pos;
+            if (glm::dot(toCenter, camera.m_forwardDirection) < -model.m_boundsRadius)
+            {
+                continue;
+            }
+            
+            real32 distance = glm::length(toCenter);
+            if (distance <= model.m_boundsRadius)
+            {
+                // NOTE: The camera is inside the instance
+                screenSize = FLT_MAX;
+                break;
+            }
+            screenSize = std::max(screenSize, 2.0f * model.m_boundsRadius * pixelsPerUnit / distance);
+        }
+        
+        for (const ModelDrawRange & range : model.m_drawRanges)
+        {
+            TextureHandle textureHandle = GetDrawRangeTexture(range, transform);
+            if (IsAssetResident(&assets.m_textures, textureHandle))
+            {
+                TextureContext & texture = context.m_textureContexts[textureHandle];
+                texture.m_wantedMip = std::min(texture.m_wantedMip, GetScreenSizeMip(texture, screenSize));
+            }
+        }
+    }
+}
+
+// NOTE: Largest level within TEXTURE_STREAMING_INITIAL_SIZE, what a streamed texture first shows up with
+internal uint32 GetInitialTextureMip(const TextureContext & texture)
+{
+    uint32 mip = 0;
+    while (std::max(texture.m_width >> mip, texture.m_height >> mip) > TEXTURE_STREAMING_INITIAL_SIZE)
+    {
+        mip++;
+    }
+    return mip;
+}
+
+/*
+  NOTE: Top level of textureData to upload from. First loads start at their initial small mips, restores at what
+  their size on screen asks for. Makes room for that if it can, otherwise skips further levels down to
+  TEXTURE_RESIDENT_MIN_SIZE, past that the texture goes over budget rather than not showing at all.
+  The resident image of the same texture, if any, is about to be replaced and counts as free
+ */
+internal uint32 ChooseTextureFirstMip(VulkanContext & context, AssetTable * textures, TextureHandle handle, const TextureData & textureData)
+{
+    TextureContext & current = context.m_textureContexts[handle];
+    TextureImageFormat imageFormat = ChooseTextureImageFormat(context.m_physicalDevice, context.m_textureCompressionBC, textureData);
+    
+    TextureContext planned = {};
+    planned.m_width  = textureData.m_width;
+    planned.m_height = textureData.m_height;
+    
+    // NOTE: Without a cooked chain there is nothing to skip to
+    bool cookedChain = textureData.m_mipLevels == GetMipLevelCount(textureData.m_width, textureData.m_height);
+    
+    uint32 wantedMip = 0;
+    if (STREAM_TEXTURE_MIPS && cookedChain)
+    {
+        wantedMip = current.m_textureImage ? current.m_wantedMip : GetInitialTextureMip(planned);
+    }
+    
+    uint64 wantedBytes = GetTextureChainBytes(planned, wantedMip, imageFormat.m_channels, imageFormat.m_encoding);
+    uint64 freed = current.m_textureImage ? current.m_texelBytes : 0;
+    bool fits = MakeTextureRoom(context, textures, handle, wantedBytes > freed ? wantedBytes - freed : 0, false);
+    
+    // NOTE: A restore that does not fit keeps what is resident
+    if (!cookedChain)
+    {
+        return (fits || !current.m_textureImage) ? 0 : current.m_firstMip;
+    }
+    
+    uint32 firstMip = wantedMip;
+    uint64 available = context.m_textureResidency.m_budget + freed;
+    while (context.m_textureMemory.m_texelBytes + GetTextureChainBytes(planned, firstMip, imageFormat.m_channels, imageFormat.m_encoding) > available &&
+           CanDropTextureMip(planned, firstMip))
+    {
+        firstMip++;
+    }
+    return firstMip;
+}
+
+// NOTE: Called from the main loop once a streamed texture finished decoding on a worker, for first loads as well
+//       as restores of top mips that got evicted or are now needed on screen
+internal void UploadTexture(VulkanContext & context, AssetTable * textures, TextureHandle handle, const TextureData & textureData)
+{
+    if (context.m_textureContexts.size() <= handle)
+    {
+        context.m_textureContexts.resize(handle + 1);
+    }
+    
+    uint32 firstMip = ChooseTextureFirstMip(context, textures, handle, textureData);
+    
+    TextureContext & texture = context.m_textureContexts[handle];
+    if (texture.m_textureImage)
+    {
+        if (firstMip >= texture.m_firstMip)
+        {
+            // NOTE: The budget filled up since the restore was queued
+            texture.m_restorePending = false;
+            return;
+        }
+        
+        // NOTE: Still drawn by the frames in flight
+        RemoveTextureMemory(context.m_textureMemory, texture);
+        RetireTextureContext(context, texture);
+    }
+    
+    texture = CreateTextureContext(context, textureData, firstMip);
+    AddTextureMemory(context.m_textureMemory, texture);
 }
 
+// NOTE: A unit cube and a single grey texel, drawn for every transform whose assets are still streaming
+internal void CreatePlaceholderAssets(VulkanContext & context)
+{
+    Model cube = {};
+    for (uint32 i = 0; i < 8; i++)
+    {
+        Vertex vertex = {};
+        vertex.m_pos   = glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+        vertex.m_color = glm::vec3(1.0f);
+        cube.m_vertices.push_back(vertex);
+    }
+    
+    cube.m_indices = 
+    {
+        0, 2, 1,  1, 2, 3, // -z
+        4, 5, 6,  5, 7, 6, // +z
+        0, 1, 4,  1, 5, 4, // -y
+        2, 6, 3,  3, 6, 7, // +y
+        0, 4, 2,  2, 4, 6, // -x
+        1, 3, 5,  3, 7, 5, // +x
+    };
+    context.m_placeholderModel = CreateModelContext(context, cube);
+    
+    uint8 greyTexel[4] = { 128, 128, 128, 255 };
+    TextureData texel = { greyTexel, 1, 1 };
+    context.m_placeholderTexture = CreateTextureContext(context, texel, 0);
+}
 
 internal void InitVulkan(Application * app)
 {
@@ -2446,9 +3813,16 @@ internal void InitVulkan(Application * app)
     context.m_physicalDevice = PickPhysicalDevice(context.m_instance, context.m_surface);
     context.m_msaaSamples    = GetMaxUsableSampleCount(context.m_physicalDevice);
     context.m_device         = CreateLogicalDevice(context.m_physicalDevice, context.m_surface);
+    context.m_textureCompressionBC = IsTextureCompressionBCSupported(context.m_physicalDevice);
     context.m_graphicsQueue  = CreateGraphicsQueue(context.m_device, context.m_physicalDevice, context.m_surface);
     context.m_presentQueue   = CreatePresentQueue(context.m_device, context.m_physicalDevice, context.m_surface);
     context.m_commandPool    = CreateCommandPool(context.m_device, context.m_physicalDevice, context.m_surface);
+    InitDeviceMemoryAllocator(&context.m_deviceMemory, context.m_physicalDevice, context.m_device);
+    InitUploadQueue(&context.m_uploads, context.m_device, &context.m_deviceMemory, FindQueueFamilies(context.m_physicalDevice, context.m_surface),
+                    context.m_graphicsQueue, context.m_commandPool);
+    CreateGeometryBuffer(context, GEOMETRY_VERTEX_BUFFER_SIZE, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, &context.m_geometryVertices);
+    CreateGeometryBuffer(context, GEOMETRY_INDEX16_BUFFER_SIZE, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &context.m_geometryIndices16);
+    CreateGeometryBuffer(context, GEOMETRY_INDEX32_BUFFER_SIZE, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, &context.m_geometryIndices32);
     
     // NOTE: swapchain, images, format, extent creation
     {
@@ -2466,20 +3840,20 @@ internal void InitVulkan(Application * app)
     {
     uint32 imageCount = (uint32)context.m_swapChainImages.size();
     context.m_sceneImages.resize(imageCount);
-        context.m_sceneImageMemories.resize(imageCount);
+        context.m_sceneImageAllocations.resize(imageCount);
         context.m_sceneImageViews.resize(imageCount);
     
     for (uint32 i = 0; i < imageCount; i++)
     {
         ImageResources sceneImageResources = CreateSceneImage(context.m_device,
-                                                              context.m_physicalDevice,
+                                                              &context.m_deviceMemory,
                                                               context.m_commandPool,
                                                               context.m_graphicsQueue,
                                                               context.m_swapChainImageFormat,
                                                               context.m_swapChainExtent);
         
         context.m_sceneImages[i] = sceneImageResources.m_imageResult.m_image;
-        context.m_sceneImageMemories[i] = sceneImageResources.m_imageResult.m_imageMemory;
+        context.m_sceneImageAllocations[i] = sceneImageResources.m_imageResult.m_allocation;
         context.m_sceneImageViews[i] = sceneImageResources.m_imageView;
         
     }
@@ -2492,75 +3866,39 @@ internal void InitVulkan(Application * app)
     
     context.m_imGuiRenderPass = CreateImGuiRenderPass(context.m_device, context.m_physicalDevice, context.m_swapChainImageFormat);
     
+    for (uint32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
     {
         CreateGraphicsPipelineResult result =
-            CreateGraphicsPipeline(context.m_device, context.m_swapChainExtent, context.m_sceneRenderPass, context.m_sceneDescriptorSetLayout, context.m_msaaSamples);
+            CreateGraphicsPipeline(context.m_device, context.m_swapChainExtent, context.m_sceneRenderPass, context.m_sceneDescriptorSetLayout, context.m_msaaSamples, (VertexFormat)format);
         
-        context.m_scenePipelineLayout  = result.m_pipelineLayout;
-        context.m_sceneGraphicsPipeline = result.m_graphicsPipeline;
+        context.m_scenePipelineLayouts[format]   = result.m_pipelineLayout;
+        context.m_sceneGraphicsPipelines[format] = result.m_graphicsPipeline;
     }
     
-    context.m_textureContexts.resize(app->m_renderData.m_transforms.count);
-    context.m_modelContexts.resize(app->m_renderData.m_transforms.count);
-    
-        for (uint32 i = 0; i < app->m_renderData.m_transforms.count; i++)
-        {
-            uint32 max_size = (uint32)context.m_textureContexts.max_size();
-            Transform & tr = app->m_renderData.m_transforms[i];
-            
-            ImageCreateResult result = CreateTextureImage(context.m_device, 
-                                                          context.m_physicalDevice, 
-                                                          context.m_commandPool, 
-                                                          context.m_graphicsQueue, 
-                                                          tr.m_textureID);
-            
-            TextureContext texture = {};
-            texture.m_textureImage       = result.m_image;
-            texture.m_textureImageMemory = result.m_imageMemory;
-            texture.m_mipLevels          = result.m_mipLevels;
-            texture.m_textureImageView = CreateTextureImageView(context.m_device, texture.m_textureImage, texture.m_mipLevels);
-            context.m_textureContexts[i] = texture;
-            
-        ModelContext modelContext = {};
-            {
-                BufferCreateResult result = CreateAndBindVertexBuffer(context.m_device, context.m_commandPool, context.m_graphicsQueue, context.m_physicalDevice, tr.m_model.m_vertices);
-                modelContext.m_vertexBuffer        = result.m_buffer;
-                modelContext.m_vertexBufferMemory  = result.m_bufferMemory;
-            }
-            
-            {
-                BufferCreateResult result = CreateAndBindIndexBuffer(context.m_device, context.m_commandPool, context.m_graphicsQueue, context.m_physicalDevice, tr.m_model.m_indices);
-                modelContext.m_indexBuffer         = result.m_buffer;
-                modelContext.m_indexBufferMemory   = result.m_bufferMemory;
-        }
-        
-        context.m_modelContexts[i] = modelContext;
-        
-        }
-    
     context.m_textureSampler   = CreateTextureSampler(context.m_device, context.m_physicalDevice);
     
     
     {
         ImageResources result = CreateDepthResources(context.m_device,
                                                      context.m_physicalDevice, 
+                                                     &context.m_deviceMemory,
                                                      context.m_swapChainExtent, 
                                                      context.m_msaaSamples);
         
         context.m_depthImage       = result.m_imageResult.m_image;
-        context.m_depthImageMemory = result.m_imageResult.m_imageMemory;
+        context.m_depthImageAllocation = result.m_imageResult.m_allocation;
         context.m_depthImageView   = result.m_imageView;
     }
     
     {
         ImageResources resources = CreateColorResources(context.m_device, 
-                                                        context.m_physicalDevice, 
+                                                        &context.m_deviceMemory, 
                                                         context.m_swapChainImageFormat,
                                                         context.m_swapChainExtent,
                                                         context.m_msaaSamples);
         
         context.m_colorImage = resources.m_imageResult.m_image;
-        context.m_colorImageMemory = resources.m_imageResult.m_imageMemory;
+        context.m_colorImageAllocation = resources.m_imageResult.m_allocation;
         context.m_colorImageView = resources.m_imageView;
     }
     
@@ -2587,30 +3925,22 @@ context.m_sceneFramebuffers = CreateFramebuffers(context.m_device,
     
     
     {
-        UniformBufferCreateResult result = CreateUniformBuffers(context.m_device, context.m_physicalDevice);
+        UniformBufferCreateResult result = CreateUniformBuffers(context.m_device, &context.m_deviceMemory);
         context.m_uniformBuffers       = result.m_uniformBuffers;
-        context.m_uniformBuffersMemory = result.m_uniformBuffersMemory;
+        context.m_uniformBufferAllocations = result.m_uniformBufferAllocations;
         context.m_uniformBuffersMapped = result.m_uniformBuffersMapped;
     }
     
+    // NOTE: Every texture registered so far plus the placeholder, textures stream in after this. Material textures
+    //       are only registered once their model is uploaded
     context.m_sceneDescriptorPool = CreateDescriptorPool(context.m_device,
-                                                         (uint32)app->m_renderData.m_transforms.count,
+                                                         (uint32)app->m_renderData.m_assets.m_textures.m_entries.size() + 1 + LATE_TEXTURE_DESCRIPTOR_COUNT + RETIRED_TEXTURE_LIMIT,
                                                          (uint32)context.m_sceneImageViews.size());
     
     context.m_imGuiDescriptorPool = CreateDescriptorPool(context.m_device, 1,
                                                          (uint32)context.m_sceneImageViews.size());
                                                          
-    for (uint32 i = 0; i < app->m_renderData.m_transforms.count; i++)
-    {
-        Transform & tr = app->m_renderData.m_transforms[i];
-        TextureContext & textureContext = context.m_textureContexts[i];
-        textureContext.m_descriptorSets = CreateDescriptorSets(context.m_device,
-                                                               context.m_uniformBuffers,
-                                                               context.m_sceneDescriptorPool,
-                                                               context.m_sceneDescriptorSetLayout,
-                                                               textureContext.m_textureImageView,
-                                                               context.m_textureSampler);
-    }
+    CreatePlaceholderAssets(context);
     
     context.m_sceneCommandBuffers = CreateCommandBuffers(context.m_device, context.m_commandPool);
     
@@ -2623,15 +3953,18 @@ context.m_sceneFramebuffers = CreateFramebuffers(context.m_device,
         context.m_inFlightFences           = syncObjs.m_inFlightFences;
     }
     
-    int64 timestampVS = GetTimestamp(VS_PATH);
-    int64 timestampFS = GetTimestamp(FS_PATH);
-    context.m_shaderTimestamp = max(timestampVS, timestampFS);
+    context.m_shaderTimestamp = GetResourceTimestamp(FS_PATH);
+    for (uint32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
+    {
+        context.m_shaderTimestamp = max(context.m_shaderTimestamp, GetResourceTimestamp(VS_PATHS[format]));
+    }
 }
 
 
 internal void CleanUpVulkan(VulkanContext & context)
 {
     
+    ShutdownUploadQueue(&context.m_uploads);
     CleanupSwapChain(context);
     
     vkDestroyRenderPass(context.m_device, context.m_imGuiRenderPass, nullptr);
@@ -2640,14 +3973,14 @@ internal void CleanUpVulkan(VulkanContext & context)
     vkDestroySampler(context.m_device, context.m_textureSampler, nullptr);
     for (uint32 i = 0; i < context.m_textureContexts.size(); i++)
     {
-        vkDestroyImageView(context.m_device, context.m_textureContexts[i].m_textureImageView, nullptr);
-        vkDestroyImage(context.m_device, context.m_textureContexts[i].m_textureImage, nullptr);
-        vkFreeMemory(context.m_device, context.m_textureContexts[i].m_textureImageMemory, nullptr);
+        DestroyTextureContext(context, context.m_textureContexts[i]);
     }
+    DestroyTextureContext(context, context.m_placeholderTexture);
+    FreeRetiredTextures(context, true);
     for (uint32 i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
         vkDestroyBuffer(context.m_device, context.m_uniformBuffers[i], nullptr);
-        vkFreeMemory(context.m_device, context.m_uniformBuffersMemory[i], nullptr);
+        FreeDeviceMemory(&context.m_deviceMemory, &context.m_uniformBufferAllocations[i]);
     }
     
     vkDestroyDescriptorPool(context.m_device, context.m_sceneDescriptorPool, nullptr);
@@ -2655,11 +3988,12 @@ internal void CleanUpVulkan(VulkanContext & context)
     
     for (uint32 i = 0; i < context.m_modelContexts.size(); i++)
     {
-        vkDestroyBuffer(context.m_device, context.m_modelContexts[i].m_vertexBuffer, nullptr);
-        vkFreeMemory(context.m_device, context.m_modelContexts[i].m_vertexBufferMemory, nullptr);
-        vkDestroyBuffer(context.m_device, context.m_modelContexts[i].m_indexBuffer, nullptr);
-        vkFreeMemory(context.m_device, context.m_modelContexts[i].m_indexBufferMemory, nullptr);
+        DestroyModelContext(context, context.m_modelContexts[i]);
     }
+    DestroyModelContext(context, context.m_placeholderModel);
+    DestroyGeometryBuffer(context, &context.m_geometryVertices);
+    DestroyGeometryBuffer(context, &context.m_geometryIndices16);
+    DestroyGeometryBuffer(context, &context.m_geometryIndices32);
     
     for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
     {
@@ -2675,10 +4009,14 @@ internal void CleanUpVulkan(VulkanContext & context)
     }
     
     vkDestroyCommandPool(context.m_device, context.m_commandPool, nullptr);
-    vkDestroyPipeline(context.m_device, context.m_sceneGraphicsPipeline, nullptr);
-    vkDestroyPipelineLayout(context.m_device, context.m_scenePipelineLayout, nullptr);
+    for (uint32 format = 0; format < VERTEX_FORMAT_COUNT; format++)
+    {
+        vkDestroyPipeline(context.m_device, context.m_sceneGraphicsPipelines[format], nullptr);
+        vkDestroyPipelineLayout(context.m_device, context.m_scenePipelineLayouts[format], nullptr);
+    }
     vkDestroyRenderPass(context.m_device, context.m_sceneRenderPass, nullptr);
     
+    ShutdownDeviceMemoryAllocator(&context.m_deviceMemory);
     vkDestroyDevice(context.m_device, nullptr);
     if (enableValidationLayers)
     {
@@ -14,6 +14,8 @@
 #include <glm/gtx/hash.hpp>
 
 #include "engine_lib.h"
+#include "render_interface.h"
+#include "device_memory.h"
 //====================================================
 //      NOTE: Vulkan Constexpr
 //====================================================
@@ -30,9 +32,54 @@ constexpr char * deviceExtensions[] =
 
 constexpr int32 MAX_FRAMES_IN_FLIGHT = 2;
 
-constexpr char * VS_PATH = "src/Shaders/bytecode/triangle_vert.spv";
+// NOTE: One vertex shader per VertexFormat, they all share the fragment shader
+constexpr char * VS_PATHS[VERTEX_FORMAT_COUNT] =
+{
+    "src/Shaders/bytecode/triangle_vert.spv",
+    "src/Shaders/bytecode/triangle_packed_vert.spv",
+};
 constexpr char * FS_PATH = "src/Shaders/bytecode/triangle_frag.spv";
 
+// NOTE: Streamed textures share this much device memory. Over it the least recently drawn ones give up their top
+//       mips, then their whole image. Adjustable at runtime from the properties window
+constexpr uint64 TEXTURE_MEMORY_BUDGET = MB(256);
+
+// NOTE: Dropping top mips stops once the largest side would go below this, past that only evicting the whole
+//       texture frees more
+constexpr uint32 TEXTURE_RESIDENT_MIN_SIZE = 64;
+
+// NOTE: Cooked textures come in with only their small mips and stream in finer ones as their transforms grow on
+//       screen. Off uploads every texture with its whole chain as long as the budget allows
+constexpr bool STREAM_TEXTURE_MIPS = true;
+
+// NOTE: Largest side of the top level a streamed texture first shows up with
+constexpr uint32 TEXTURE_STREAMING_INITIAL_SIZE = 64;
+
+// NOTE: Scene descriptor sets for textures first registered after init, like the diffuse maps of material ranges
+constexpr uint32 LATE_TEXTURE_DESCRIPTOR_COUNT = 64;
+
+// NOTE: Textures replaced or evicted by the residency manager wait, at most this many at once, for the frames and
+//       uploads still using them. Their descriptor sets are reserved on top of the ones above, retiring more
+//       drains the GPU instead
+constexpr uint32 RETIRED_TEXTURE_LIMIT = 32;
+
+// NOTE: Every upload is written into one persistently mapped ring of this size and copied out of it. Uploads larger
+//       than the whole ring get a staging buffer of their own
+constexpr VkDeviceSize STAGING_RING_SIZE = MB(64);
+
+// NOTE: Covers vkCmdCopyBufferToImage, whose buffer offsets must be multiples of four and of the texel block size
+constexpr VkDeviceSize STAGING_RING_ALIGNMENT = 16;
+
+// NOTE: Uploads are copied on a transfer only queue family when the device has one and handed over to the graphics
+//       queue at the end of their batch. Off, or without one, they are recorded on the graphics queue
+constexpr bool USE_TRANSFER_QUEUE = true;
+
+// NOTE: Starting sizes of the buffers every model's vertices and indices are sub-allocated from. They double, with
+//       a stall, whenever a model does not fit. Most models narrow to uint16 indices
+constexpr VkDeviceSize GEOMETRY_VERTEX_BUFFER_SIZE   = MB(64);
+constexpr VkDeviceSize GEOMETRY_INDEX16_BUFFER_SIZE  = MB(16);
+constexpr VkDeviceSize GEOMETRY_INDEX32_BUFFER_SIZE  = MB(16);
+
 template<typename T> using InFlights = Array<T, MAX_FRAMES_IN_FLIGHT>;
 
 /*
@@ -82,23 +129,173 @@ struct FragPushConstants
     real32 m_steepness;
 };
 
+// NOTE: One draw per instance. Ranges without a material texture draw with the texture of the transform.
+//       m_firstIndex is into the geometry index buffer, the model's own offset is already added in
+struct ModelDrawRange
+{
+    uint32        m_firstIndex;
+    uint32        m_indexCount;
+    TextureHandle m_texture = INVALID_ASSET_HANDLE;
+};
+
+// NOTE: Vertices and indices live in the geometry buffers of the context, m_vertexOffset is in vertices of the
+//       model's format and is added to every index it draws
 struct ModelContext
 {
-    VkBuffer                   m_vertexBuffer;
-    VkDeviceMemory             m_vertexBufferMemory;
-    VkBuffer                   m_indexBuffer;
-    VkDeviceMemory             m_indexBufferMemory;
+    int32                      m_vertexOffset;
+    uint32                     m_firstIndex;
+    uint32                     m_indexCount;
+    VkIndexType                m_indexType = VK_INDEX_TYPE_UINT32; // NOTE: Picks the geometry index buffer as well
+    
+    // NOTE: Packed positions are unorm inside the model AABB, this maps them back to model space
+    VertexFormat               m_vertexFormat = VERTEX_FORMAT_FLOAT;
+    glm::mat4                  m_dequantize = glm::mat4(1.0f);
+    
+    // NOTE: Model space bounding sphere, sizes instances on screen for texture mip streaming
+    glm::vec3                  m_boundsCenter = {};
+    real32                     m_boundsRadius;
+    
+    // NOTE: A model without materials is a single range over its whole index buffer. The material textures are
+    //       filled in by whoever acquires them once the model is uploaded
+    std::vector<ModelDrawRange> m_drawRanges;
     };
 
+// NOTE: Resident levels of streamed textures only, the placeholder is not counted
+struct TextureMemoryStats
+{
+    uint64 m_texelBytes;
+    uint64 m_rgba8Bytes;
+};
+
+// NOTE: m_frameNumber counts recorded frames, textures remember the last one that drew them
+struct TextureResidency
+{
+    uint64 m_budget = TEXTURE_MEMORY_BUDGET;
+    uint32 m_frameNumber = 1;
+};
+
 struct TextureContext
 {
-    uint32 m_mipLevels;
+    uint32 m_mipLevels; // NOTE: Resident levels, the image holds the full chain from m_firstMip down
+    VkFormat       m_format;
+    uint64         m_texelBytes;
+    uint32          m_width;  // NOTE: Of the full texture, not of the resident top level
+    uint32          m_height;
+    uint32          m_firstMip;
+    uint32          m_channels;
+    TextureEncoding m_encoding;
+    uint32          m_lastUsedFrame;
+    uint32          m_wantedMip; // NOTE: Finest level its largest instance on screen needs, see UpdateTextureStreaming
+    bool            m_restorePending; // NOTE: A reload with more top mips is in flight
     VkImage        m_textureImage;
-    VkDeviceMemory m_textureImageMemory;
+    DeviceAllocation m_textureImageAllocation;
     VkImageView    m_textureImageView;
     InFlights<VkDescriptorSet> m_descriptorSets;
     };
 
+struct BufferCreateResult
+{
+    VkBuffer         m_buffer;
+    DeviceAllocation m_allocation;
+};
+
+// NOTE: Identifies an upload batch, they are numbered in submission order from 1. Ticket 0 is always complete
+typedef uint64 UploadTicket;
+
+// NOTE: Everything acquired from the ring for one batch, given back once the batch completes. m_end is a ring
+//       position, the ones of StagingRing only ever grow
+struct StagingRegion
+{
+    uint64                          m_end;
+    UploadTicket                    m_ticket;
+    std::vector<BufferCreateResult> m_oversizeBuffers;
+};
+
+/*
+  NOTE: Producers write straight into the mapped memory of an acquired range and record a copy out of it, there is
+  no allocation per upload. Ranges belong to the batch that copies out of them and are reused once it completes.
+ */
+struct StagingRing
+{
+    BufferCreateResult m_buffer;
+    uint8 *            m_mapped;
+    VkDeviceSize       m_size;
+    
+    uint64 m_head;    // NOTE: Next write, m_head % m_size into the buffer
+    uint64 m_retired; // NOTE: Everything before it belongs to a region in m_inFlight
+    uint64 m_tail;    // NOTE: Everything before it is free again
+    
+    std::deque<StagingRegion>       m_inFlight;
+    std::vector<BufferCreateResult> m_oversizeBuffers; // NOTE: Acquired for the open batch
+};
+
+// NOTE: m_offset is into m_buffer, m_data already points at it
+struct StagingAllocation
+{
+    VkBuffer     m_buffer;
+    VkDeviceSize m_offset;
+    VkDeviceSize m_size;
+    uint8 *      m_data;
+};
+
+// NOTE: m_graphicsCommandBuffer and m_semaphore are only used with a dedicated transfer queue. The graphics side
+//       waits on the transfer side, takes ownership of the images it uploaded and makes the buffer copies visible to
+//       the frames after it, m_fence signals once both are done
+struct UploadBatch
+{
+    VkCommandBuffer m_commandBuffer;
+    VkCommandBuffer m_graphicsCommandBuffer;
+    VkSemaphore     m_semaphore;
+    VkFence         m_fence;
+    UploadTicket    m_ticket;
+};
+
+/*
+  NOTE: Transfers and barriers of every upload are recorded into the open batch, which goes to the queue in one
+  submission when it is needed: before the next frame, when the staging ring fills up, or when someone waits on it.
+  Batches complete in submission order, m_completed is the last one known to be done.
+ */
+struct UploadQueue
+{
+    VkDevice                m_device;
+    DeviceMemoryAllocator * m_allocator;
+    
+    // NOTE: The transfer ones are the graphics ones when there is no dedicated transfer queue
+    bool          m_dedicatedTransfer;
+    VkQueue       m_transferQueue;
+    VkCommandPool m_transferCommandPool;
+    uint32        m_transferFamily;
+    VkQueue       m_graphicsQueue;
+    VkCommandPool m_graphicsCommandPool;
+    uint32        m_graphicsFamily;
+    
+    StagingRing              m_staging;
+    UploadBatch              m_open; // NOTE: m_commandBuffer is null until something is recorded
+    std::deque<UploadBatch>  m_inFlight;
+    std::vector<UploadBatch> m_free;
+    UploadTicket             m_nextTicket;
+    UploadTicket             m_completed;
+};
+
+// NOTE: Models are never unloaded, so ranges are handed out front to back and only come back with the whole buffer.
+//       Shared by the graphics and transfer families, uploads into a free range need no ownership transfer
+struct GeometryBuffer
+{
+    VkBuffer           m_buffer;
+    DeviceAllocation   m_allocation;
+    VkBufferUsageFlags m_usage;
+    VkDeviceSize       m_size;
+    VkDeviceSize       m_used;
+};
+
+// NOTE: Destroyed once every frame from m_frameNumber on was recorded without it and upload m_ticket completed
+struct RetiredTexture
+{
+    TextureContext m_texture;
+    uint32         m_frameNumber; // NOTE: First frame recorded without it
+    UploadTicket   m_ticket;      // NOTE: Last upload batch that may still copy out of it
+};
+
 struct VulkanContext
 {
     VkInstance                 m_instance;
@@ -111,6 +308,11 @@ struct VulkanContext
     VkFormat                   m_swapChainImageFormat;
     VkExtent2D                 m_swapChainExtent;
     VkCommandPool              m_commandPool;
+    DeviceMemoryAllocator      m_deviceMemory; // NOTE: Every buffer and image of the context is allocated from it
+    UploadQueue                m_uploads;
+    GeometryBuffer             m_geometryVertices;  // NOTE: Both vertex formats, each model aligned to its stride
+    GeometryBuffer             m_geometryIndices16;
+    GeometryBuffer             m_geometryIndices32;
     std::vector<VkImage>       m_swapChainImages;
     std::vector<VkImageView>   m_swapChainImageViews;
     
@@ -125,31 +327,37 @@ struct VulkanContext
     // NOTE: SceneLayer Context
     // TODO: change scene frame buffer to draw in viewport image views instead of swapchain image views 
     std::vector<VkImage>        m_sceneImages;
-    std::vector<VkDeviceMemory> m_sceneImageMemories;
+    std::vector<DeviceAllocation> m_sceneImageAllocations;
     std::vector<VkImageView>    m_sceneImageViews;
     std::vector<VkFramebuffer>  m_sceneFramebuffers;
     VkRenderPass                m_sceneRenderPass;
     VkDescriptorSetLayout       m_sceneDescriptorSetLayout;
-    VkPipelineLayout            m_scenePipelineLayout;
-    VkPipeline                  m_sceneGraphicsPipeline;
+    VkPipelineLayout            m_scenePipelineLayouts[VERTEX_FORMAT_COUNT];
+    VkPipeline                  m_sceneGraphicsPipelines[VERTEX_FORMAT_COUNT];
     VkDescriptorPool            m_sceneDescriptorPool;
     InFlights<VkCommandBuffer>  m_sceneCommandBuffers;
     std::vector<VkDescriptorSet> m_Dset;
     
     VkSampler      m_textureSampler;
-    std::vector<TextureContext> m_textureContexts;
-    std::vector<ModelContext>   m_modelContexts;
+    std::vector<TextureContext> m_textureContexts;   // NOTE: Indexed by TextureHandle
+    std::vector<ModelContext>   m_modelContexts;     // NOTE: Indexed by ModelHandle
+    ModelContext                m_placeholderModel;
+    TextureContext              m_placeholderTexture;
+    std::vector<RetiredTexture> m_retiredTextures;
+    TextureMemoryStats          m_textureMemory;
+    TextureResidency            m_textureResidency;
+    bool                        m_textureCompressionBC; // NOTE: Enabled on the device when supported
     
     VkImage        m_depthImage;
-    VkDeviceMemory m_depthImageMemory;
+    DeviceAllocation m_depthImageAllocation;
     VkImageView    m_depthImageView;
     
     VkImage        m_colorImage;
-    VkDeviceMemory m_colorImageMemory;
+    DeviceAllocation m_colorImageAllocation;
     VkImageView    m_colorImageView;
     
     InFlights<VkBuffer> m_uniformBuffers;
-    InFlights<VkDeviceMemory> m_uniformBuffersMemory;
+    InFlights<DeviceAllocation> m_uniformBufferAllocations;
     InFlights<void *> m_uniformBuffersMapped;
     
     // NOTE: Synchronization Object
@@ -177,6 +385,7 @@ struct QueueFamilyIndices
 {
     std::optional<uint32> m_graphicsFamily;
     std::optional<uint32> m_presentFamily;
+    std::optional<uint32> m_transferFamily; // NOTE: Without graphics, preferably without compute too
     
     bool IsComplete()
     {
@@ -212,17 +421,23 @@ struct SyncObjects
     Array<VkFence, MAX_FRAMES_IN_FLIGHT>     m_inFlightFences;
 };
 
-struct BufferCreateResult
+struct ImageCreateResult
 {
-    VkBuffer       m_buffer;
-    VkDeviceMemory m_bufferMemory;
+    VkImage          m_image;
+    DeviceAllocation m_allocation;
+    uint32         m_mipLevels;
+    VkFormat       m_format;
+    uint64         m_texelBytes;
+    uint32          m_channels;
+    TextureEncoding m_encoding;
 };
 
-struct ImageCreateResult
+// NOTE: What a texture image ends up as once the device fallbacks are applied
+struct TextureImageFormat
 {
-    VkImage        m_image;
-    VkDeviceMemory m_imageMemory;
-    uint32         m_mipLevels;
+    VkFormat        m_format;
+    uint32          m_channels;
+    TextureEncoding m_encoding;
 };
 
 struct ImageResources
@@ -234,7 +449,7 @@ struct ImageResources
 struct UniformBufferCreateResult
 {
     Array<VkBuffer,       MAX_FRAMES_IN_FLIGHT> m_uniformBuffers;
-    Array<VkDeviceMemory, MAX_FRAMES_IN_FLIGHT> m_uniformBuffersMemory;
+    Array<DeviceAllocation, MAX_FRAMES_IN_FLIGHT> m_uniformBufferAllocations;
     Array<void *,         MAX_FRAMES_IN_FLIGHT> m_uniformBuffersMapped;
 };
 